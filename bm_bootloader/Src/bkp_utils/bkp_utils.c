@@ -0,0 +1,62 @@
+#include "main.h"
+#include "bkp_utils.h"
+
+/*名称：bkp_utils_get_reg
+* 功能：获取后备寄存器的地址 DR1~DR10和DR11~DR42不连续
+* 参数：reg 寄存器序号
+* 返回：寄存器地址 NULL：序号错误
+*/
+static __IO uint32_t *bkp_utils_get_reg(uint8_t reg)
+{
+  if(reg == 0 || reg > BKP_UTILS_REG_CNT){
+     return NULL;
+  }
+  if(reg <= 10){
+     return &BKP->DR1 + (reg - 1);
+  }
+  
+  return &BKP->DR11 + (reg - 11);
+}
+
+/*名称：bkp_utils_init
+* 功能：打开PWR和BKP时钟 允许写后备寄存器
+* 参数：无
+* 返回：无
+*/
+void bkp_utils_init(void)
+{
+  __HAL_RCC_PWR_CLK_ENABLE();
+  __HAL_RCC_BKP_CLK_ENABLE();
+  HAL_PWR_EnableBkUpAccess();
+}
+
+/*名称：bkp_utils_read
+* 功能：读取后备寄存器
+* 参数：reg 寄存器序号 1~BKP_UTILS_REG_CNT
+* 返回：寄存器的值 序号错误时返回0
+*/
+uint16_t bkp_utils_read(uint8_t reg)
+{
+  __IO uint32_t *dr = bkp_utils_get_reg(reg);
+  
+  if(dr == NULL){
+     return 0;
+  }
+  
+  return (uint16_t)*dr;
+}
+
+/*名称：bkp_utils_write
+* 功能：写后备寄存器
+* 参数：reg   寄存器序号 1~BKP_UTILS_REG_CNT
+* 参数：value 寄存器的值
+* 返回：无
+*/
+void bkp_utils_write(uint8_t reg,uint16_t value)
+{
+  __IO uint32_t *dr = bkp_utils_get_reg(reg);
+  
+  if(dr != NULL){
+     *dr = value;
+  }
+}
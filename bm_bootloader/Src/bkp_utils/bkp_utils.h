@@ -0,0 +1,45 @@
+#ifndef  __BKP_UTILS_H__
+#define  __BKP_UTILS_H__
+#include "stm32f1xx_hal.h"
+
+/*后备寄存器 复位和跳转后保持 VBAT没有供电时掉电清零*/
+/*F103xE有42个16位寄存器 DR1~DR42*/
+#define  BKP_UTILS_REG_CNT                       42
+
+/******************************************************************************/
+/*    配置开始                                                                */
+/******************************************************************************/
+/*寄存器分配 序号从1开始*/
+#define  BKP_UTILS_REG_ENV_HINT                  1     /*当前env记录的位置*/
+#define  BKP_UTILS_REG_RESET_REASON              2     /*bootloader失败复位的原因 高8位：原因 低8位：启动阶段*/
+#define  BKP_UTILS_REG_RESET_CNT                 3     /*bootloader连续失败复位的次数 跳转到应用程序时清零*/
+#define  BKP_UTILS_REG_TRIAL_CNT                 4     /*新固件没有确认时已经试运行的次数*/
+/******************************************************************************/
+/*    配置结束                                                                */
+/******************************************************************************/
+
+
+/*名称：bkp_utils_init
+* 功能：打开PWR和BKP时钟 允许写后备寄存器
+* 参数：无
+* 返回：无
+*/
+void bkp_utils_init(void);
+
+/*名称：bkp_utils_read
+* 功能：读取后备寄存器
+* 参数：reg 寄存器序号 1~BKP_UTILS_REG_CNT
+* 返回：寄存器的值 序号错误时返回0
+*/
+uint16_t bkp_utils_read(uint8_t reg);
+
+/*名称：bkp_utils_write
+* 功能：写后备寄存器
+* 参数：reg   寄存器序号 1~BKP_UTILS_REG_CNT
+* 参数：value 寄存器的值
+* 返回：无
+*/
+void bkp_utils_write(uint8_t reg,uint16_t value);
+
+
+#endif
@@ -0,0 +1,130 @@
+#include "main.h"
+#include "stddef.h"
+#include "string.h"
+#include "crc32.h"
+#include "boot_timeline.h"
+#include "log.h"
+#define  LOG_MODULE_LEVEL    LOG_LEVEL_DEBUG
+#define  LOG_MODULE_NAME     "[timeline]"
+
+#define  BOOT_TIMELINE                   ((boot_timeline_t *)BOOT_TIMELINE_ADDR)
+
+/*阶段名称 与boot_timeline_phase_t一一对应*/
+static const char *boot_timeline_phase_name[BOOT_TIMELINE_PHASE_CNT] = {
+  "clock init",
+  "log init",
+  "env init",
+  "env read",
+  "wrp config",
+  "led init",
+  "update verify",
+  "update swap",
+  "update",
+  "image check",
+  "jump"
+};
+
+
+/*名称：boot_timeline_init
+* 功能：打开DWT周期计数器并从0开始计数 清除上次的记录 复位后最先调用
+* 参数：无
+* 返回：无
+*/
+void boot_timeline_init(void)
+{
+#if  BOOT_TIMELINE_ENABLE > 0
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  memset(BOOT_TIMELINE,0,sizeof(boot_timeline_t));
+#endif
+}
+
+/*名称：boot_timeline_mark
+* 功能：记录启动阶段结束的时间
+* 参数：phase 启动阶段
+* 返回：无
+*/
+void boot_timeline_mark(boot_timeline_phase_t phase)
+{
+#if  BOOT_TIMELINE_ENABLE > 0
+  if(phase < BOOT_TIMELINE_PHASE_CNT){
+     BOOT_TIMELINE->cycle[phase] = DWT->CYCCNT;
+  }
+#endif
+}
+
+/*名称：boot_timeline_finish
+* 功能：记录跳转时间 计算crc 输出到日志 跳转前调用
+* 参数：无
+* 返回：无
+*/
+void boot_timeline_finish(void)
+{
+#if  BOOT_TIMELINE_ENABLE > 0
+  uint32_t cycle;
+  uint32_t last_cycle = 0;
+  uint32_t clock_mhz;
+
+  boot_timeline_mark(BOOT_TIMELINE_PHASE_JUMP);
+
+  BOOT_TIMELINE->magic = BOOT_TIMELINE_MAGIC;
+  BOOT_TIMELINE->core_clock = SystemCoreClock;
+  BOOT_TIMELINE->crc = crc32_calculate(BOOT_TIMELINE,offsetof(boot_timeline_t,crc));
+
+  /*时钟初始化之前按HSI计数 这里统一按当前时钟换算 只作参考*/
+  clock_mhz = SystemCoreClock / 1000000;
+  if(clock_mhz == 0){
+     clock_mhz = 1;
+  }
+  for(uint8_t i = 0;i < BOOT_TIMELINE_PHASE_CNT;i ++){
+      cycle = BOOT_TIMELINE->cycle[i];
+      /*本次启动没有经过这个阶段*/
+      if(cycle == 0){
+         continue;
+      }
+      log_debug("%s cycle:%d +%dus total:%dus.\r\n",boot_timeline_phase_name[i],cycle,(cycle - last_cycle) / clock_mhz,cycle / clock_mhz);
+      last_cycle = cycle;
+  }
+#endif
+}
+
+/*名称：boot_timeline_get_phase
+* 功能：获取本次启动最后完成的阶段 失败复位时记录
+* 参数：无
+* 返回：启动阶段 BOOT_TIMELINE_PHASE_CNT：没有完成任何阶段
+*/
+boot_timeline_phase_t boot_timeline_get_phase(void)
+{
+  boot_timeline_phase_t phase = BOOT_TIMELINE_PHASE_CNT;
+#if  BOOT_TIMELINE_ENABLE > 0
+  uint32_t last_cycle = 0;
+
+  for(uint8_t i = 0;i < BOOT_TIMELINE_PHASE_CNT;i ++){
+      if(BOOT_TIMELINE->cycle[i] > last_cycle){
+         last_cycle = BOOT_TIMELINE->cycle[i];
+         phase = (boot_timeline_phase_t)i;
+      }
+  }
+#endif
+
+  return phase;
+}
+
+/*名称：boot_timeline_get
+* 功能：获取bootloader记录的启动时间线 应用程序调用
+* 参数：无
+* 返回：时间线指针 NULL：没有有效的记录
+*/
+const boot_timeline_t *boot_timeline_get(void)
+{
+  if(BOOT_TIMELINE->magic != BOOT_TIMELINE_MAGIC){
+     return NULL;
+  }
+  if(BOOT_TIMELINE->crc != crc32_calculate(BOOT_TIMELINE,offsetof(boot_timeline_t,crc))){
+     return NULL;
+  }
+
+  return BOOT_TIMELINE;
+}
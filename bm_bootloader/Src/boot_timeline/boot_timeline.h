@@ -0,0 +1,82 @@
+#ifndef  __BOOT_TIMELINE_H__
+#define  __BOOT_TIMELINE_H__
+#include "stm32f1xx_hal.h"
+
+/*启动时间线 用DWT周期计数器记录每个启动阶段结束的时间 跳转前输出到日志*/
+/*记录放在SRAM末尾不初始化的区域 应用程序读取后上报 应用程序的链接文件也要保留这个区域*/
+/*周期计数从复位后开始 时钟初始化之前按HSI计数 72MHz时约59秒溢出*/
+
+/******************************************************************************/
+/*    配置开始                                                                */
+/******************************************************************************/
+#define  BOOT_TIMELINE_ENABLE                    1
+#define  BOOT_TIMELINE_ADDR                      (0x2000FF00)/*SRAM末尾256字节是bootloader和应用程序共用的记录*/
+/******************************************************************************/
+/*    配置结束                                                                */
+/******************************************************************************/
+
+#define  BOOT_TIMELINE_MAGIC                     (0x454D4954U)/*"TIME"*/
+
+/*启动阶段 按一般的执行顺序排列*/
+typedef enum
+{
+BOOT_TIMELINE_PHASE_CLOCK_INIT = 0,   /*时钟初始化*/
+BOOT_TIMELINE_PHASE_LOG_INIT,         /*日志初始化*/
+BOOT_TIMELINE_PHASE_ENV_INIT,         /*查找env*/
+BOOT_TIMELINE_PHASE_ENV_READ,         /*读取env*/
+BOOT_TIMELINE_PHASE_WRP_CONFIG,       /*写保护检查*/
+BOOT_TIMELINE_PHASE_LED_INIT,         /*开机画面*/
+BOOT_TIMELINE_PHASE_UPDATE_VERIFY,    /*交换前校验更新的固件*/
+BOOT_TIMELINE_PHASE_UPDATE_SWAP,      /*逐页交换或者覆盖*/
+BOOT_TIMELINE_PHASE_UPDATE,           /*升级或者回滚完成*/
+BOOT_TIMELINE_PHASE_IMAGE_CHECK,      /*跳转前校验固件*/
+BOOT_TIMELINE_PHASE_JUMP,             /*跳转到应用程序*/
+BOOT_TIMELINE_PHASE_CNT
+}boot_timeline_phase_t;
+
+typedef struct
+{
+uint32_t magic;                          /*BOOT_TIMELINE_MAGIC*/
+uint32_t core_clock;                     /*跳转时的内核时钟 单位：Hz*/
+uint32_t cycle[BOOT_TIMELINE_PHASE_CNT]; /*阶段结束时的周期计数 0：本次启动没有经过这个阶段*/
+uint32_t crc;                            /*前面字段的crc32*/
+}boot_timeline_t;
+
+
+/*名称：boot_timeline_init
+* 功能：打开DWT周期计数器并从0开始计数 清除上次的记录 复位后最先调用
+* 参数：无
+* 返回：无
+*/
+void boot_timeline_init(void);
+
+/*名称：boot_timeline_mark
+* 功能：记录启动阶段结束的时间
+* 参数：phase 启动阶段
+* 返回：无
+*/
+void boot_timeline_mark(boot_timeline_phase_t phase);
+
+/*名称：boot_timeline_finish
+* 功能：记录跳转时间 计算crc 输出到日志 跳转前调用
+* 参数：无
+* 返回：无
+*/
+void boot_timeline_finish(void);
+
+/*名称：boot_timeline_get_phase
+* 功能：获取本次启动最后完成的阶段 失败复位时记录
+* 参数：无
+* 返回：启动阶段 BOOT_TIMELINE_PHASE_CNT：没有完成任何阶段
+*/
+boot_timeline_phase_t boot_timeline_get_phase(void);
+
+/*名称：boot_timeline_get
+* 功能：获取bootloader记录的启动时间线 应用程序调用
+* 参数：无
+* 返回：时间线指针 NULL：没有有效的记录
+*/
+const boot_timeline_t *boot_timeline_get(void);
+
+
+#endif
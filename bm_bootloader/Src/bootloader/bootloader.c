@@ -4,6 +4,7 @@
 #include "flash_utils.h"
 #include "bootloader_if.h"
 #include "bootloader.h"
+#include "boot_timeline.h"
 #include "log.h"
 #define  LOG_MODULE_LEVEL    LOG_LEVEL_DEBUG
 #define  LOG_MODULE_NAME     "[bootloader]"
@@ -12,21 +13,15 @@
 static bootloader_env_t env;
 
 
-/*名称：bootloader
-* 功能：bootloader
+/*名称：bootloader_splash
+* 功能：显示开机画面 显示芯片上电稳定需要等待
 * 参数：无
 * 返回：无
 */
-void bootloader(void)
+static void bootloader_splash(void)
 {
- int rc;
- /*等待显示芯片上电稳定*/;
- HAL_Delay(1000);
- 
- log_debug("\r\n*************************************************************\r\n"
-           "\r\n  BOOTLOADER VER:%s     build date:%s %s \r\n"
-           "\r\n*************************************************************\r\n"
-           ,BOOTLOADER_VERSION,__DATE__,__TIME__);
+ /*等待显示芯片上电稳定 看门狗可能已经打开*/
+ bootloader_delay(1000);
  
  led_display_init();
  
@@ -48,37 +43,94 @@ void bootloader(void)
  led_display_pressure(BOOTLOADER_INIT_DISPLAY_VALUE);
  led_display_capacity(BOOTLOADER_INIT_DISPLAY_VALUE);
  
-  /*刷新到芯片*/
+ /*刷新到芯片*/
  led_display_refresh();
- /*解除写保护*/
- if(bootloader_disable_wr_protection() != 0){
-    goto err_exit;   
-  }
-  
+ 
+ boot_timeline_mark(BOOT_TIMELINE_PHASE_LED_INIT);
+}
+
+/*名称：bootloader
+* 功能：bootloader
+* 参数：无
+* 返回：无
+*/
+void bootloader(void)
+{
+ int rc;
+ /*没有设置原因时是没有可以运行的固件*/
+ bootloader_reset_reason_t reason = BOOTLOADER_RESET_REASON_BOOT;
+ 
+ log_debug("\r\n*************************************************************\r\n"
+           "\r\n  BOOTLOADER VER:%s     build date:%s %s \r\n"
+           "\r\n*************************************************************\r\n"
+           ,BOOTLOADER_VERSION,__DATE__,__TIME__);
+ 
+#if  BOOTLOADER_FAST_BOOT_ENABLE == 0
+ bootloader_splash();
+#endif
+ 
  if(bootloader_init() != 0){
+    /*env区可能被写保护 按升级时的策略打开后复位*/
+    bootloader_config_wr_protection(NULL);
+    reason = BOOTLOADER_RESET_REASON_INIT;
     goto err_exit;   
   }
+ boot_timeline_mark(BOOT_TIMELINE_PHASE_ENV_INIT);
  
   /*读取当前env*/ 
   log_debug("bootloader read env.\r\n");
   rc = bootloader_get_env(&env); 
   /*执行失败 重启*/
   if(rc != 0){
+     reason = BOOTLOADER_RESET_REASON_ENV_READ;
      goto err_exit;        
   }
+  boot_timeline_mark(BOOT_TIMELINE_PHASE_ENV_READ);
+  
+  /*应用程序通过命令邮箱请求升级或者回滚 只修改env的副本 开始升级或者回滚时才写入flash*/
+  bootloader_handle_mailbox(&env);
+  
+  /*按启动标志设置写保护 和选项字节不同时才修改 修改后复位*/
+  if(bootloader_config_wr_protection(&env) != 0){
+     reason = BOOTLOADER_RESET_REASON_WRP;
+     goto err_exit;
+  }
+  boot_timeline_mark(BOOT_TIMELINE_PHASE_WRP_CONFIG);
   
   /*正常启动程序*/
   if(env.boot_flag == BOOTLOADER_FLAG_BOOT_NORMAL){
      log_debug("bootloader no update.boot normal.\r\n");
+#if  BOOTLOADER_FLASH_BENCH_ENABLE > 0
+     bootloader_flash_bench();
+#endif
      bootloader_boot_user_application(); 
    }
  
+#if  BOOTLOADER_TRIAL_BOOT_ENABLE > 0
+  /*新固件还没有确认 试运行次数没有用完时再次运行 由看门狗复位挂死的固件*/
+  if(env.boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE && bootloader_get_trial_boot_cnt() < BOOTLOADER_TRIAL_BOOT_CNT){
+     log_debug("bootloader update not confirmed.trial boot again.\r\n");
+     bootloader_boot_user_application();
+  }
+#endif
+ 
+#if  BOOTLOADER_FAST_BOOT_ENABLE > 0
+  /*升级和回滚比较耗时 显示开机画面*/
+  if(env.boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE || env.boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE){
+     bootloader_splash();
+  }
+#endif
+  
   /*需要更新程序*/
   if(env.boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE){
      log_debug("bootloader need update.\r\n");
+     bootloader_stat_reset();
      if(bootloader_update_user_app(&env) != 0){
+        reason = BOOTLOADER_RESET_REASON_UPDATE;
         goto err_exit;
      }
+     bootloader_stat_report("update");
+     boot_timeline_mark(BOOT_TIMELINE_PHASE_UPDATE);
      log_debug("done.\r\n");
      /*执行用户程序*/
      bootloader_boot_user_application(); 
@@ -90,6 +142,7 @@ void bootloader(void)
      env.boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
 
      if(bootloader_save_env(&env) != 0){
+        reason = BOOTLOADER_RESET_REASON_ENV_SAVE;
         goto err_exit; 
       }
      log_debug("done.\r\n");
@@ -100,9 +153,13 @@ void bootloader(void)
   /*升级失败恢复原程序*/
   if(env.boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE){
      log_debug("bootloader need recovery.\r\n");
+     bootloader_stat_reset();
      if(bootloader_recovery_user_app(&env) != 0){
+        reason = BOOTLOADER_RESET_REASON_RECOVERY;
         goto err_exit;
      }
+     bootloader_stat_report("recovery");
+     boot_timeline_mark(BOOT_TIMELINE_PHASE_UPDATE);
      log_debug("done.\r\n");
      /*执行用户程序*/
      bootloader_boot_user_application(); 
@@ -110,7 +167,7 @@ void bootloader(void)
   
  
 err_exit:
-  bootloader_reset();
+  bootloader_fail_reset(reason);
   while(1);
 }
 
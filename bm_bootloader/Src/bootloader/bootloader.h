@@ -4,6 +4,8 @@
 
 #define  BOOTLOADER_VERSION                         "v1.0.4"
 #define  BOOTLOADER_INIT_DISPLAY_VALUE              (0x0f * 10)
+#define  BOOTLOADER_FLASH_BENCH_ENABLE              0     /*正常启动前测试flash擦除和编程速度*/
+#define  BOOTLOADER_FAST_BOOT_ENABLE                1     /*只在升级和回滚时显示开机画面 正常启动不等待显示芯片上电 由应用程序等待*/
 
 void bootloader(void);
 
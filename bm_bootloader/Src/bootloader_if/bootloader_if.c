@@ -1,15 +1,117 @@
 #include "main.h"
 #include "stdbool.h"
+#include "stddef.h"
 #include "flash_utils.h"
 #include "bootloader_if.h"
+#include "crc32.h"
+#include "crc32_hw.h"
+#include "sha256.h"
+#include "ecdsa.h"
+#include "bkp_utils.h"
+#include "kv_store.h"
+#include "delta.h"
+#include "lz.h"
+#include "boot_timeline.h"
 #include "log.h"
 #define  LOG_MODULE_LEVEL    LOG_LEVEL_DEBUG
 #define  LOG_MODULE_NAME     "[bootloader_if]"
 
-#define  BANK_FULL_ENV_OFFSET         0x11111111
+#define  ENV_RECORD_BLANK             0xFFFFFFFF /*未写入的记录序号*/
+#define  ENV_RECORD_DATA_SIZE(size)   (((uint32_t)(size) + 3) & ~3U)
+#define  ENV_RECORD_SIZE(size)        (sizeof(bootloader_env_record_t) + ENV_RECORD_DATA_SIZE(size) + 4)/*记录头 数据 crc*/
+#define  ENV_RECORD_MAX_DATA_SIZE     (BOOTLOADER_FLASH_ENV_BANK1_SIZE - sizeof(bootloader_env_record_t) - 4)
+#define  ENV_RECORD_TYPE_FULL         0          /*完整的env*/
+#define  ENV_RECORD_TYPE_DELTA        1          /*只有变化的字段 叠加在同一bank前面的记录上*/
+#define  ENV_DELTA_MERGE_GAP          1          /*变化的字段之间不变的字数不超过这个值时合并 省去一个字段头*/
+#define  ENV_HINT_TAG                 0xA400     /*后备寄存器中env位置的标记 bit9是bank 低9位是偏移/4*/
+#define  ENV_HINT_TAG_MASK            0xFC00
 
 typedef void (*application_func_t)(void);
 
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
+/*按页序号执行的页操作*/
+typedef int (*bootloader_page_op_t)(uint32_t op,uint32_t origin_page,uint32_t update_page);
+#endif
+
+typedef enum
+{
+BOOTLOADER_PACKAGE_NONE = 0,
+BOOTLOADER_PACKAGE_DELTA,     /*补丁包*/
+BOOTLOADER_PACKAGE_LZ         /*压缩包*/
+}bootloader_package_t;
+
+/*env记录头 后面是数据和crc 数据只在bootloader_env_t末尾增加字段 旧记录按size读取*/
+/*每个bank的第一条记录是完整的env 后面一般是增量记录*/
+typedef struct
+{
+uint32_t sequence;  /*记录序号 越大越新*/
+uint8_t  version;   /*写入时的env版本*/
+uint8_t  type;      /*记录类型 ENV_RECORD_TYPE_FULL或ENV_RECORD_TYPE_DELTA*/
+uint16_t size;      /*数据大小*/
+}bootloader_env_record_t;
+
+/*增量记录中的字段头 后面是字段的新值 记录中可以有多个字段*/
+typedef struct
+{
+uint16_t offset;    /*字段在bootloader_env_t中的偏移*/
+uint16_t size;      /*字段大小*/
+}bootloader_env_delta_t;
+
+typedef struct
+{
+uint32_t addr;
+uint32_t size;
+}bootloader_env_bank_t;
+
+typedef struct
+{
+const char *name;
+uint32_t    offset;
+uint32_t    size;
+}bootloader_flash_region_t;
+
+/*统计输出时的flash分区*/
+static const bootloader_flash_region_t flash_region[] = {
+{"env bank1",BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET,BOOTLOADER_FLASH_ENV_BANK1_SIZE},
+{"env bank2",BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET,BOOTLOADER_FLASH_ENV_BANK2_SIZE},
+{"user app",BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_USER_APPLICATION_SIZE},
+{"update app",BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE},
+{"swap block",BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,BOOTLOADER_FLASH_SWAP_BLOCK_SIZE},
+{"journal",BOOTLOADER_FLASH_JOURNAL_ADDR_OFFSET,BOOTLOADER_FLASH_JOURNAL_SIZE},
+{"kv store",KV_STORE_ADDR - BOOTLOADER_FLASH_BASE_ADDR,KV_STORE_SIZE},
+};
+
+/*env两个bank轮流写入 一个bank写满后擦除另一个bank*/
+static const bootloader_env_bank_t env_bank[2] = {
+{BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET,BOOTLOADER_FLASH_ENV_BANK1_SIZE},
+{BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET,BOOTLOADER_FLASH_ENV_BANK2_SIZE},
+};
+
+/*失败复位原因的名称 与bootloader_reset_reason_t一一对应*/
+static const char *reset_reason_name[BOOTLOADER_RESET_REASON_CNT] = {
+"none",
+"init",
+"env read",
+"wrp",
+"update",
+"env save",
+"recovery",
+"boot",
+};
+
+/*当前env记录的位置 所有env的擦除和写入都会更新 0：没有缓存*/
+static uint8_t  cur_env_bank;
+static uint32_t cur_env_addr;
+static uint32_t next_env_addr;
+/*当前env 由bank中的记录叠加得到 保存时和它比较生成增量*/
+static bootloader_env_t cur_env;
+/*env记录写入缓存 一次写入flash*/
+static uint32_t env_record[ENV_RECORD_SIZE(sizeof(bootloader_env_t)) / 4];
+
+/*统计区间内env写入次数和开始时间*/
+static uint32_t env_write_cnt;
+static uint32_t stat_start_time;
+
 static bootloader_env_t default_env = {
 .boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL,
 .status = BOOTLOADER_ENV_STATUS_VALID,
@@ -19,33 +121,495 @@ static bootloader_env_t default_env = {
 
 static application_func_t application_func;
 
-/*名称：bootloader_boot_user_application
-* 功能：启动用户区APP
+#define  BOOTLOADER_BOOT_INFO            ((bootloader_boot_info_t *)BOOTLOADER_BOOT_INFO_ADDR)
+#define  BOOTLOADER_MAILBOX              ((bootloader_mailbox_t *)BOOTLOADER_MAILBOX_ADDR)
+
+/*本次复位的标志和上次失败复位的记录 读取后清除 跳转时传给应用程序*/
+static uint32_t reset_flags;
+static uint16_t last_reset_reason;
+static uint16_t last_reset_cnt;
+/*本次启动执行的邮箱命令和结果*/
+static uint32_t mailbox_cmd;
+static int32_t  mailbox_result;
+
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+/*验签公钥 ECDSA P-256 x||y 大端 产品需要替换为自己的公钥 由tools/bm_sign pubkey生成 私钥不能放在代码中*/
+static const uint8_t sign_public_key[ECDSA_P256_KEY_SIZE] = {
+0x5F,0xB5,0x11,0x14,0xEB,0x65,0xDF,0x72,0xD8,0x79,0xD8,0xEF,0xCF,0x8F,0x8D,0x2B,
+0xB5,0x9D,0x8D,0xDC,0xDD,0xBC,0xB9,0xC1,0xD1,0x24,0x0A,0xC4,0x7A,0x77,0x76,0x89,
+0x38,0x3F,0x62,0x23,0x0C,0x5F,0xE9,0x6A,0x30,0x95,0xF1,0x6C,0x6E,0xB5,0x35,0x46,
+0x4D,0xEE,0xDE,0x36,0xE4,0xD4,0x57,0x0F,0x67,0xE4,0xAA,0x81,0xCF,0xAA,0xF3,0x00
+};
+#endif
+
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
+/*补丁包和压缩包解包的输出缓存*/
+static uint8_t unpack_buffer[BOOTLOADER_FLASH_PAGE_SIZE];
+#else
+static uint32_t bootloader_select_slot(const bootloader_env_t *env,bootloader_fw_sha256_t *verified);
+#endif
+static int bootloader_check_image(uint32_t image_addr,uint32_t load_addr,uint32_t slot_size,bootloader_fw_sha256_t *verified);
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP || BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+static void bootloader_calculate_sha256(uint32_t addr,uint32_t size,uint8_t *digest);
+#endif
+
+/*名称：bootloader_reset_reason_name
+* 功能：获取失败复位原因的名称
+* 参数：reason 失败原因
+* 返回：名称
+*/
+static const char *bootloader_reset_reason_name(uint32_t reason)
+{
+  if(reason >= BOOTLOADER_RESET_REASON_CNT){
+     return "unknown";
+  }
+  
+  return reset_reason_name[reason];
+}
+
+/*名称：bootloader_check_reset_reason
+* 功能：输出本次复位的原因和上次bootloader失败复位的记录
 * 参数：无
 * 返回：无
 */
-void bootloader_boot_user_application()
+static void bootloader_check_reset_reason()
+{
+  reset_flags = RCC->CSR;
+  log_warning("reset flags:%s%s%s%s%s%s.\r\n",
+              __HAL_RCC_GET_FLAG(RCC_FLAG_PORRST) ? " por" : "",
+              __HAL_RCC_GET_FLAG(RCC_FLAG_PINRST) ? " pin" : "",
+              __HAL_RCC_GET_FLAG(RCC_FLAG_SFTRST) ? " soft" : "",
+              __HAL_RCC_GET_FLAG(RCC_FLAG_IWDGRST) ? " iwdg" : "",
+              __HAL_RCC_GET_FLAG(RCC_FLAG_WWDGRST) ? " wwdg" : "",
+              __HAL_RCC_GET_FLAG(RCC_FLAG_LPWRRST) ? " lpwr" : "");
+  __HAL_RCC_CLEAR_RESET_FLAGS();
+  
+  last_reset_reason = bkp_utils_read(BKP_UTILS_REG_RESET_REASON);
+  last_reset_cnt = bkp_utils_read(BKP_UTILS_REG_RESET_CNT);
+  if(last_reset_cnt > 0){
+     log_warning("last fail reset reason:%s phase:%d cnt:%d.\r\n",
+                 bootloader_reset_reason_name(last_reset_reason >> 8),last_reset_reason & 0xFF,last_reset_cnt);
+  }
+}
+
+/*名称：bootloader_feed_watchdog
+* 功能：喂独立看门狗 看门狗没有打开时不影响 在SRAM中执行 可以作为flash引擎的idle hook
+* 参数：无
+* 返回：无
+*/
+FLASH_ENGINE_RAMFUNC static void bootloader_feed_watchdog(void)
+{
+  IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+#if  BOOTLOADER_TRIAL_BOOT_ENABLE > 0
+/*名称：bootloader_start_trial_boot
+* 功能：新固件没有确认时增加试运行次数并打开独立看门狗 已经确认的固件清除试运行次数
+* 参数：无
+* 返回：无
+*/
+static void bootloader_start_trial_boot()
+{
+  IWDG_HandleTypeDef iwdg;
+  uint16_t trial_cnt;
+  
+  if(cur_env.boot_flag != BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE){
+     bkp_utils_write(BKP_UTILS_REG_TRIAL_CNT,0);
+     return;
+  }
+  trial_cnt = bkp_utils_read(BKP_UTILS_REG_TRIAL_CNT) + 1;
+  bkp_utils_write(BKP_UTILS_REG_TRIAL_CNT,trial_cnt);
+  log_warning("trial boot %d/%d.watchdog on.\r\n",trial_cnt,BOOTLOADER_TRIAL_BOOT_CNT);
+  
+  iwdg.Instance = IWDG;
+  iwdg.Init.Prescaler = BOOTLOADER_TRIAL_IWDG_PRESCALER;
+  iwdg.Init.Reload = BOOTLOADER_TRIAL_IWDG_RELOAD;
+  if(HAL_IWDG_Init(&iwdg) != HAL_OK){
+     log_error("watchdog init err.\r\n");
+  }
+}
+#endif
+
+/*名称：bootloader_flush_log
+* 功能：等待日志输出完毕 最多等待BOOTLOADER_LOG_FLUSH_TIMEOUT
+* RTT只有调试器连接时才会被读取 没有连接时不等待
+* 参数：无
+* 返回：无
+*/
+static void bootloader_flush_log()
+{
+  uint32_t start_time = HAL_GetTick();
+  
+#if  LOG_USE_RTT > 0
+  if((CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk) == 0){
+     return;
+  }
+#endif
+  while(log_pending() != 0 && HAL_GetTick() - start_time < BOOTLOADER_LOG_FLUSH_TIMEOUT);
+}
+
+/*名称：bootloader_check_vector
+* 功能：检查固件的中断向量表 栈指针必须在SRAM中并且在共用区域之前 复位入口必须在运行区中并且是thumb地址
+* 参数：slot_addr 运行区地址
+* 参数：slot_size 运行区大小
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_check_vector(uint32_t slot_addr,uint32_t slot_size)
+{
+  uint32_t msp,reset_handler;
+  
+  msp = *(uint32_t *)slot_addr;
+  reset_handler = *(uint32_t *)(slot_addr + 4);
+  if(msp <= BOOTLOADER_SRAM_BASE_ADDR || msp > BOOTLOADER_SRAM_SHARED_ADDR || (msp & 3) != 0 ||
+     reset_handler <= slot_addr || reset_handler >= slot_addr + slot_size || (reset_handler & 1) == 0){
+     log_error("image addr:0x%X vector msp:0x%X reset:0x%X err.\r\n",slot_addr,msp,reset_handler);
+     return -1;
+  }
+  
+  return 0;
+}
+
+/*名称：bootloader_save_boot_info
+* 功能：跳转前写入启动信息
+* 参数：slot_addr 运行的固件地址
+* 返回：无
+*/
+static void bootloader_save_boot_info(uint32_t slot_addr)
+{
+  const bootloader_image_header_t *header;
+  
+  header = (const bootloader_image_header_t *)(slot_addr + BOOTLOADER_IMAGE_HEADER_OFFSET);
+  BOOTLOADER_BOOT_INFO->magic = BOOTLOADER_BOOT_INFO_MAGIC;
+  BOOTLOADER_BOOT_INFO->size = sizeof(bootloader_boot_info_t);
+  BOOTLOADER_BOOT_INFO->core_clock = SystemCoreClock;
+  BOOTLOADER_BOOT_INFO->rcc_cr = RCC->CR;
+  BOOTLOADER_BOOT_INFO->rcc_cfgr = RCC->CFGR;
+  BOOTLOADER_BOOT_INFO->flash_acr = FLASH->ACR;
+  BOOTLOADER_BOOT_INFO->reset_flags = reset_flags;
+  BOOTLOADER_BOOT_INFO->reset_reason = last_reset_reason;
+  BOOTLOADER_BOOT_INFO->reset_cnt = last_reset_cnt;
+  BOOTLOADER_BOOT_INFO->boot_flag = cur_env.boot_flag;
+  BOOTLOADER_BOOT_INFO->trial_cnt = bootloader_get_trial_boot_cnt();
+  BOOTLOADER_BOOT_INFO->image_addr = slot_addr;
+  BOOTLOADER_BOOT_INFO->image_version = header->magic == BOOTLOADER_IMAGE_MAGIC ? header->version : 0;
+  BOOTLOADER_BOOT_INFO->boot_time = HAL_GetTick();
+  BOOTLOADER_BOOT_INFO->cmd = mailbox_cmd;
+  BOOTLOADER_BOOT_INFO->cmd_result = mailbox_result;
+  BOOTLOADER_BOOT_INFO->crc = crc32_calculate(BOOTLOADER_BOOT_INFO,offsetof(bootloader_boot_info_t,crc));
+  /*命令已经执行完成*/
+  BOOTLOADER_MAILBOX->magic = 0;
+}
+
+/*名称：bootloader_get_boot_info
+* 功能：获取bootloader跳转前写入的启动信息 应用程序调用
+* 参数：无
+* 返回：启动信息指针 NULL：没有有效的启动信息
+*/
+const bootloader_boot_info_t *bootloader_get_boot_info()
+{
+  if(BOOTLOADER_BOOT_INFO->magic != BOOTLOADER_BOOT_INFO_MAGIC || BOOTLOADER_BOOT_INFO->size != sizeof(bootloader_boot_info_t)){
+     return NULL;
+  }
+  if(BOOTLOADER_BOOT_INFO->crc != crc32_calculate(BOOTLOADER_BOOT_INFO,offsetof(bootloader_boot_info_t,crc))){
+     return NULL;
+  }
+  
+  return BOOTLOADER_BOOT_INFO;
+}
+
+/*名称：bootloader_handoff
+* 功能：外设和中断恢复到复位后的状态 中断向量表指向固件 然后跳转
+* 后备寄存器 看门狗和时钟配置保留
+* 参数：slot_addr 运行的固件地址
+* 返回：无
+*/
+static void bootloader_handoff(uint32_t slot_addr)
 {
   uint32_t user_application_msp;
-  uint32_t user_app_addr;
   
-  /*初始化栈指针*/
-  user_application_msp = *(uint32_t*)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET);
+#if  BOOTLOADER_HANDOFF_KEEP_CLOCK == 0
+  /*需要SysTick计时 在关闭中断前执行*/
+  HAL_RCC_DeInit();
+#endif
+  bootloader_save_boot_info(slot_addr);
   
-  /*获取用户APP地址和栈指针*/
-  user_app_addr = *(uint32_t*)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + 4);
-  application_func = (application_func_t)user_app_addr;
-  log_warning("boot user app --> addr:0x%X stack:0x%X....\r\n",application_func,user_application_msp);
-  /*等待日志输出完毕*/
-  HAL_Delay(500);
-  /*跳转*/
   __disable_irq();
+  /*停止SysTick*/
+  SysTick->CTRL = 0;
+  SysTick->LOAD = 0;
+  SysTick->VAL = 0;
+  
+  /*复位APB外设并关闭时钟 PWR和BKP保留*/
+  RCC->APB2RSTR = 0xFFFFFFFFU;
+  RCC->APB2RSTR = 0;
+  RCC->APB1RSTR = ~(RCC_APB1RSTR_PWRRST | RCC_APB1RSTR_BKPRST);
+  RCC->APB1RSTR = 0;
+  RCC->APB2ENR = 0;
+  RCC->APB1ENR &= RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN;
+  RCC->AHBENR = RCC_AHBENR_SRAMEN | RCC_AHBENR_FLITFEN;
+  
+  /*关闭所有中断并清除挂起*/
+  for(uint8_t i = 0;i < sizeof(NVIC->ICER) / sizeof(NVIC->ICER[0]);i ++){
+      NVIC->ICER[i] = 0xFFFFFFFFU;
+      NVIC->ICPR[i] = 0xFFFFFFFFU;
+  }
+  SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk | SCB_ICSR_PENDSVCLR_Msk;
+  
+  /*中断向量表指向固件*/
+  SCB->VTOR = slot_addr;
+  __DSB();
+  __ISB();
+  
+  user_application_msp = *(uint32_t *)slot_addr;
+  application_func = (application_func_t)*(uint32_t *)(slot_addr + 4);
+  /*跳转 中断都已关闭 恢复复位后的PRIMASK*/
   __set_MSP(user_application_msp);
-  application_func();  
+  __enable_irq();
+  application_func();
+}
+
+/*名称：bootloader_get_boot_slot
+* 功能：获取要运行的固件所在的区
+* 参数：slot_addr 区地址
+* 参数：slot_size 区大小
+* 参数：verified  验签标记 选择区时校验固件会更新
+* 返回：无
+*/
+static void bootloader_get_boot_slot(uint32_t *slot_addr,uint32_t *slot_size,bootloader_fw_sha256_t *verified)
+{
+  *slot_addr = BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET;
+  *slot_size = BOOTLOADER_FLASH_USER_APPLICATION_SIZE;
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_XIP
+  uint32_t addr;
+  
+  /*选择的区已经校验过 没有有效固件时按原来的方式运行用户区*/
+  addr = bootloader_select_slot(&cur_env,verified);
+  if(addr != 0){
+     *slot_addr = addr;
+     if(*slot_addr != BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET){
+        *slot_size = BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE;
+     }
+  }
+#else
+  (void)verified;
+#endif
+}
+
+/*名称：bootloader_self_test
+* 功能：邮箱命令自检 校验要运行的固件 交换区空闲时测试擦除和编程
+* 参数：env 参数指针
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_self_test(const bootloader_env_t *env)
+{
+  int rc = 0;
+  uint32_t slot_addr;
+  uint32_t slot_size;
+  bootloader_fw_sha256_t verified = cur_env.fw_origin.sha256;
+  
+  bootloader_get_boot_slot(&slot_addr,&slot_size,&verified);
+  if(bootloader_check_image(slot_addr,slot_addr,slot_size,&verified) != 0 || bootloader_check_vector(slot_addr,slot_size) != 0){
+     rc = -1;
+  }
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
+  /*交换区只在交换时使用*/
+  if(env->swap_ctrl.step == SWAP_STEP_INIT && bootloader_flash_bench() != 0){
+     rc = -1;
+  }
+#endif
+  log_warning("self test %s.\r\n",rc == 0 ? "ok" : "err");
+  
+  return rc;
+}
+
+/*名称：bootloader_post_command
+* 功能：写入命令邮箱 应用程序调用 然后调用bootloader_boot_bootloader
+* 参数：cmd       命令
+* 参数：fw_update BOOTLOADER_CMD_UPDATE时是更新区中下载的固件 其他命令为NULL
+* 返回：0：成功 其他：失败 不支持的命令返回失败
+*/
+int bootloader_post_command(bootloader_cmd_t cmd,const bootloader_fw_t *fw_update)
+{
+  if(cmd == BOOTLOADER_CMD_NONE || cmd >= BOOTLOADER_CMD_CNT || (cmd == BOOTLOADER_CMD_UPDATE && fw_update == NULL)){
+     return -1;
+  }
+  memset(BOOTLOADER_MAILBOX,0,sizeof(bootloader_mailbox_t));
+  BOOTLOADER_MAILBOX->magic = BOOTLOADER_MAILBOX_MAGIC;
+  BOOTLOADER_MAILBOX->cmd = cmd;
+  if(fw_update != NULL){
+     BOOTLOADER_MAILBOX->fw_update = *fw_update;
+  }
+  BOOTLOADER_MAILBOX->crc = crc32_calculate(BOOTLOADER_MAILBOX,offsetof(bootloader_mailbox_t,crc));
+  
+  return 0;
+}
+
+/*名称：bootloader_run_command
+* 功能：执行邮箱命令 升级和回滚只修改env的副本 重复执行结果相同
+* 参数：env 环境参数指针
+* 参数：cmd 命令
+* 返回：0：成功 其他：失败
+*/
+static int32_t bootloader_run_command(bootloader_env_t *env,uint32_t cmd)
+{
+  int32_t rc = -1;
+  
+  switch(cmd){
+    case BOOTLOADER_CMD_UPDATE:
+      /*已经在升级时是上次命令没有执行完 env中的状态已经写入*/
+      if(env->boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE){
+         rc = 0;
+      }else if(env->boot_flag == BOOTLOADER_FLAG_BOOT_NORMAL && env->swap_ctrl.step == SWAP_STEP_INIT){
+         env->fw_update = BOOTLOADER_MAILBOX->fw_update;
+         /*验签标记只能由bootloader写入*/
+         if(env->fw_update.sha256.tag == BOOTLOADER_FW_SHA256_VERIFIED_TAG){
+            env->fw_update.sha256.tag = 0;
+         }
+         env->boot_flag = BOOTLOADER_FLAG_BOOT_UPDATE;
+         rc = 0;
+      }
+      break;
+    case BOOTLOADER_CMD_ROLLBACK:
+      if(env->boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE || env->boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE_OK){
+         env->boot_flag = BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE;
+#if  BOOTLOADER_TRIAL_BOOT_ENABLE > 0
+         /*不再试运行*/
+         bkp_utils_write(BKP_UTILS_REG_TRIAL_CNT,BOOTLOADER_TRIAL_BOOT_CNT);
+#endif
+         rc = 0;
+      }
+      break;
+    case BOOTLOADER_CMD_SELF_TEST:
+      rc = bootloader_self_test(env);
+      break;
+    default:
+      break;
+  }
+  
+  return rc;
+}
+
+/*名称：bootloader_handle_mailbox
+* 功能：检查命令邮箱 按命令修改env的副本 结果记录在邮箱和启动信息中 已经执行过的命令不再执行
+* 参数：env 环境参数指针
+* 返回：无
+*/
+void bootloader_handle_mailbox(bootloader_env_t *env)
+{
+  if(BOOTLOADER_MAILBOX->magic != BOOTLOADER_MAILBOX_MAGIC){
+     return;
+  }
+  if(BOOTLOADER_MAILBOX->crc != crc32_calculate(BOOTLOADER_MAILBOX,offsetof(bootloader_mailbox_t,crc))){
+     log_error("mailbox crc err.\r\n");
+     BOOTLOADER_MAILBOX->magic = 0;
+     return;
+  }
+  mailbox_cmd = BOOTLOADER_MAILBOX->cmd;
+  
+  /*跳转前复位后再次进入 命令已经执行过 结果沿用上次的结果*/
+  if(BOOTLOADER_MAILBOX->done == BOOTLOADER_MAILBOX_DONE){
+     mailbox_result = BOOTLOADER_MAILBOX->result;
+     log_warning("mailbox cmd:%d done before.result:%d.\r\n",mailbox_cmd,mailbox_result);
+     /*env的副本在复位时丢失 升级和回滚重新修改 自检不再执行*/
+     if(mailbox_result == 0 && mailbox_cmd != BOOTLOADER_CMD_SELF_TEST){
+        bootloader_run_command(env,mailbox_cmd);
+     }
+     return;
+  }
+  
+  log_warning("mailbox cmd:%d flag:0x%X.\r\n",mailbox_cmd,env->boot_flag);
+  mailbox_result = bootloader_run_command(env,mailbox_cmd);
+  BOOTLOADER_MAILBOX->result = mailbox_result;
+  BOOTLOADER_MAILBOX->done = BOOTLOADER_MAILBOX_DONE;
+  if(mailbox_result != 0){
+     log_error("mailbox cmd:%d err.\r\n",mailbox_cmd);
+  }
+}
+
+/*名称：bootloader_boot_bootloader
+* 功能：应用程序启动bootloader 软件复位 命令邮箱保留
+* 参数：无
+* 返回：无
+*/
+void bootloader_boot_bootloader()
+{
+  NVIC_SystemReset();
+}
+
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+/*名称：bootloader_save_verified
+* 功能：运行的固件重新验签后把验签标记写入env 下次启动不再验签 写入失败只影响下次启动的时间
+* 参数：verified 验签标记
+* 返回：无
+*/
+static void bootloader_save_verified(const bootloader_fw_sha256_t *verified)
+{
+  bootloader_env_t env;
+  
+  if(memcmp(verified,&cur_env.fw_origin.sha256,sizeof(bootloader_fw_sha256_t)) == 0){
+     return;
+  }
+  env = cur_env;
+  env.fw_origin.sha256 = *verified;
+  if(bootloader_save_env(&env) != 0){
+     log_warning("save verified mark err.\r\n");
+  }
+}
+#endif
+
+/*名称：bootloader_boot_user_application
+* 功能：启动用户区APP 新固件没有确认时打开看门狗并增加试运行次数
+* 跳转前写入启动信息 复位外设 清除中断 中断向量表指向固件
+* 参数：无
+* 返回：固件校验失败时返回
+*/
+void bootloader_boot_user_application()
+{
+  uint32_t slot_addr;
+  uint32_t slot_size;
+  bootloader_fw_sha256_t verified = cur_env.fw_origin.sha256;
+  
+  bootloader_get_boot_slot(&slot_addr,&slot_size,&verified);
+  /*不运行校验失败的固件*/
+  if(bootloader_check_image(slot_addr,slot_addr,slot_size,&verified) != 0){
+     log_error("image addr:0x%X check err.do not boot.\r\n",slot_addr);
+     return;
+  }
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+  bootloader_save_verified(&verified);
+#endif
+  /*没有固件头的固件没有检查过中断向量表*/
+  if(bootloader_check_vector(slot_addr,slot_size) != 0){
+     return;
+  }
+  boot_timeline_mark(BOOT_TIMELINE_PHASE_IMAGE_CHECK);
+  log_warning("boot user app --> addr:0x%X stack:0x%X boot time:%dms....\r\n",*(uint32_t *)(slot_addr + 4),*(uint32_t *)slot_addr,HAL_GetTick());
+  boot_timeline_finish();
+  /*成功跳转 清除失败复位的记录*/
+  bkp_utils_write(BKP_UTILS_REG_RESET_REASON,BOOTLOADER_RESET_REASON_NONE);
+  bkp_utils_write(BKP_UTILS_REG_RESET_CNT,0);
+#if  BOOTLOADER_TRIAL_BOOT_ENABLE > 0
+  bootloader_start_trial_boot();
+#endif
+  bootloader_flush_log();
+  flash_utils_deinit();
+  crc32_hw_deinit();
+  /*跳转*/
+  bootloader_handoff(slot_addr);
   
   while(1);
 }
 
+/*名称：bootloader_get_trial_boot_cnt
+* 功能：获取新固件已经试运行的次数
+* 参数：无
+* 返回：次数
+*/
+uint32_t bootloader_get_trial_boot_cnt()
+{
+  return bkp_utils_read(BKP_UTILS_REG_TRIAL_CNT);
+}
+
 /*名称：bootloader_reset
 * 功能：应用程序复位
 * 参数：无
@@ -53,15 +617,60 @@ void bootloader_boot_user_application()
 */
 void bootloader_reset()
 {
-  uint32_t reset_later = BOOTLOADER_RESET_LATER_TIME;
-  while(reset_later > 0){
-    log_warning("system will reset %dS later.\r\n",reset_later); 
-    reset_later --;
-    HAL_Delay(1000);
-  }  
   NVIC_SystemReset();
 }
 
+/*名称：bootloader_fail_reset
+* 功能：bootloader失败复位 原因 启动阶段和连续失败次数记录在后备寄存器
+* 连续失败BOOTLOADER_RESET_RETRY_CNT次之内立即复位 之后等待1 2 4...秒 最长BOOTLOADER_RESET_BACKOFF_MAX_TIME
+* 参数：reason 失败原因
+* 返回：无
+*/
+void bootloader_fail_reset(bootloader_reset_reason_t reason)
+{
+  uint16_t reset_cnt;
+  uint32_t reset_later = 0;
+  
+  reset_cnt = bkp_utils_read(BKP_UTILS_REG_RESET_CNT);
+  if(reset_cnt < 0xFFFF){
+     reset_cnt ++;
+  }
+  bkp_utils_write(BKP_UTILS_REG_RESET_REASON,(uint16_t)(reason << 8 | boot_timeline_get_phase()));
+  bkp_utils_write(BKP_UTILS_REG_RESET_CNT,reset_cnt);
+  
+  /*一直失败时降低复位频率*/
+  if(reset_cnt > BOOTLOADER_RESET_RETRY_CNT){
+     reset_later = 1;
+     for(uint16_t i = BOOTLOADER_RESET_RETRY_CNT + 1;i < reset_cnt && reset_later < BOOTLOADER_RESET_BACKOFF_MAX_TIME;i ++){
+         reset_later *= 2;
+     }
+     if(reset_later > BOOTLOADER_RESET_BACKOFF_MAX_TIME){
+        reset_later = BOOTLOADER_RESET_BACKOFF_MAX_TIME;
+     }
+  }
+  log_error("fail reset reason:%s phase:%d cnt:%d.reset %dS later.\r\n",
+            bootloader_reset_reason_name(reason),boot_timeline_get_phase(),reset_cnt,reset_later);
+  bootloader_flush_log();
+  if(reset_later > 0){
+     bootloader_delay(reset_later * 1000);
+  }
+  NVIC_SystemReset();
+}
+
+/*名称：bootloader_delay
+* 功能：延时 等待时喂狗 选项字节打开的硬件看门狗超时只有约0.4S
+* 参数：ms 毫秒
+* 返回：无
+*/
+void bootloader_delay(uint32_t ms)
+{
+  uint32_t start_time = HAL_GetTick();
+  
+  while(HAL_GetTick() - start_time < ms){
+     bootloader_feed_watchdog();
+  }
+}
+
 /*名称：bootloader_disable_wr_protection
 * 功能：去除flash写保护
 * 参数：无
@@ -93,521 +702,1503 @@ int bootloader_enable_wr_protection()
      return -1;
   }
   
- return 0;
-}
-/*名称：bootloader_erase_bank1
-* 功能：擦除bank1空间
-* 参数：无
-* 返回：0：成功 其他：失败
-*/
-static int bootloader_erase_bank1()
-{
-  int rc;
-  /*擦除bank1参数区域*/
-  log_warning("erase bank1...\r\n");
-  rc = flash_utils_erase(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET,BOOTLOADER_FLASH_ENV_BANK1_SIZE);
-  if(rc != 0){
-     log_error("erase bank1 addr:0x%X err.\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET);  
-     return -1;
-   }    
-  log_warning("done.\r\n"); 
-   
- return 0; 
+ return 0;
+}
+/*名称：bootloader_get_wr_protection_policy
+* 功能：获取写保护策略要求保护的页组 bootloader始终保护 应用程序写入的区域不保护
+* 交换模式下只有升级和回滚时写入用户区 其他时候保护
+* 参数：env env指针 NULL：env还没有读取 按升级处理
+* 返回：页组掩码
+*/
+static uint32_t bootloader_get_wr_protection_policy(const bootloader_env_t *env)
+{
+  uint32_t mask = 0;
+  
+#if  BOOTLOADER_WR_PROTECTION_ENABLE > 0
+  mask = flash_utils_get_write_protection_mask(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_BOOTLOADER_ADDR_OFFSET,BOOTLOADER_FLASH_BOOTLOADER_SIZE);
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
+  if(env != NULL && (env->boot_flag == BOOTLOADER_FLAG_BOOT_NORMAL || env->boot_flag == BOOTLOADER_FLAG_BOOT_UPDATE_OK)){
+     mask |= flash_utils_get_write_protection_mask(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_USER_APPLICATION_SIZE);
+  }
+#endif
+  /*和需要写入的区域在同一页组时不能保护*/
+  mask &= ~flash_utils_get_write_protection_mask(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET,BOOTLOADER_FLASH_ENV_BANK1_SIZE + BOOTLOADER_FLASH_ENV_BANK2_SIZE);
+  mask &= ~flash_utils_get_write_protection_mask(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE);
+  mask &= ~flash_utils_get_write_protection_mask(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,BOOTLOADER_FLASH_SWAP_BLOCK_SIZE);
+  mask &= ~flash_utils_get_write_protection_mask(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_JOURNAL_ADDR_OFFSET,BOOTLOADER_FLASH_JOURNAL_SIZE);
+  mask &= ~flash_utils_get_write_protection_mask(KV_STORE_ADDR,KV_STORE_SIZE);
+#endif
+  
+  return mask;
+}
+
+/*名称：bootloader_config_wr_protection
+* 功能：按写保护策略设置选项字节 和选项字节相同时不擦写 修改后复位使其生效
+* 参数：env env指针 NULL：env还没有读取 打开升级时需要写入的区域
+* 返回：0：写保护已经是策略要求的状态 其他：失败 修改成功时复位不返回
+*/
+int bootloader_config_wr_protection(const bootloader_env_t *env)
+{
+  uint32_t mask,cur_mask;
+  
+  mask = bootloader_get_wr_protection_policy(env);
+  cur_mask = flash_utils_get_write_protection();
+  if(flash_utils_get_write_protection_option() == mask){
+     /*选项字节已经修改过但是没有生效 不再复位 避免一直复位*/
+     if(cur_mask != mask){
+        log_warning("wr protection 0x%X not loaded.\r\n",mask);
+     }
+     return 0;
+  }
+  
+  log_warning("wr protection 0x%X -> 0x%X...\r\n",cur_mask,mask);
+  if(flash_utils_set_write_protection(mask) != 0){
+     log_error("err.\r\n");
+     return -1;
+  }
+  /*重新加载选项字节 会复位*/
+  log_warning("reload option bytes.\r\n");
+  HAL_FLASH_OB_Launch();
+  
+  return 0;
+}
+
+/*名称：bootloader_get_env_record_crc
+* 功能：计算env记录的crc 包括记录头和数据
+* 参数：record 记录地址
+* 返回：crc结果
+*/
+static uint32_t bootloader_get_env_record_crc(const bootloader_env_record_t *record)
+{
+  return crc32_calculate(record,sizeof(bootloader_env_record_t) + ENV_RECORD_DATA_SIZE(record->size));
+}
+
+/*名称：bootloader_get_env_record_end
+* 功能：获取env记录之后的地址 用于顺序查找下一条记录
+* 参数：addr     记录地址
+* 参数：bank_end bank结束地址
+* 返回：下一条记录的地址 0：记录头已经损坏 无法继续查找
+*/
+static uint32_t bootloader_get_env_record_end(uint32_t addr,uint32_t bank_end)
+{
+  const bootloader_env_record_t *record = (const bootloader_env_record_t *)addr;
+  
+  if(record->size == 0 || record->size > ENV_RECORD_MAX_DATA_SIZE || addr + ENV_RECORD_SIZE(record->size) > bank_end){
+     return 0;
+  }
+  
+  return addr + ENV_RECORD_SIZE(record->size);
+}
+
+/*名称：bootloader_is_env_record_valid
+* 功能：判断env记录是否完整 写入中掉电的记录crc错误
+* 参数：addr     记录地址
+* 参数：bank_end bank结束地址
+* 返回：true：有效 false：无效
+*/
+static bool bootloader_is_env_record_valid(uint32_t addr,uint32_t bank_end)
+{
+  const bootloader_env_record_t *record = (const bootloader_env_record_t *)addr;
+  
+  if(record->sequence == ENV_RECORD_BLANK || bootloader_get_env_record_end(addr,bank_end) == 0){
+     return false;
+  }
+  
+  return *(const uint32_t *)(addr + ENV_RECORD_SIZE(record->size) - 4) == bootloader_get_env_record_crc(record);
+}
+
+/*名称：bootloader_apply_env_record
+* 功能：把env记录叠加到env上 完整记录覆盖默认env 增量记录只修改其中的字段
+* 参数：env    env指针
+* 参数：record 记录地址
+* 返回：无
+*/
+static void bootloader_apply_env_record(bootloader_env_t *env,const bootloader_env_record_t *record)
+{
+  const uint8_t *data = (const uint8_t *)(record + 1);
+  const bootloader_env_delta_t *delta;
+  uint32_t offset;
+  
+  if(record->type == ENV_RECORD_TYPE_FULL){
+     /*旧版本写入的记录没有后面增加的字段 使用默认值*/
+     *env = default_env;
+     memcpy(env,data,record->size < sizeof(bootloader_env_t) ? record->size : sizeof(bootloader_env_t));
+     return;
+  }
+  
+  for(offset = 0; offset + sizeof(bootloader_env_delta_t) <= record->size; offset += sizeof(bootloader_env_delta_t) + delta->size){
+     delta = (const bootloader_env_delta_t *)(data + offset);
+     if(offset + sizeof(bootloader_env_delta_t) + delta->size > record->size){
+        break;
+     }
+     /*新版本增加的字段忽略*/
+     if(delta->offset + delta->size <= sizeof(bootloader_env_t)){
+        memcpy((uint8_t *)env + delta->offset,delta + 1,delta->size);
+     }
+  }
+}
+
+/*名称：bootloader_load_env_bank
+* 功能：按写入顺序查找bank中的记录 叠加得到bank中最新的env
+* 参数：bank 查找的bank
+* 参数：env  env指针 NULL：只查找不叠加
+* 参数：next 新记录写入的地址 0：bank中记录头损坏 不能继续写入
+* 返回：最后一条有效记录的地址 0：没有有效的记录
+*/
+static uint32_t bootloader_load_env_bank(uint8_t bank,bootloader_env_t *env,uint32_t *next)
+{
+  uint32_t addr,end,last;
+  
+  addr = env_bank[bank].addr;
+  end = env_bank[bank].addr + env_bank[bank].size;
+  last = 0;
+  *next = 0;
+  if(env != NULL){
+     *env = default_env;
+  }
+  /*记录按写入顺序排列 遇到空白或者损坏的记录头结束 写入中掉电的记录跳过*/
+  while(addr + sizeof(bootloader_env_record_t) <= end){
+     if(((const bootloader_env_record_t *)addr)->sequence == ENV_RECORD_BLANK){
+        *next = addr;
+        break;
+     }
+     if(bootloader_is_env_record_valid(addr,end)){
+        last = addr;
+        if(env != NULL){
+           bootloader_apply_env_record(env,(const bootloader_env_record_t *)addr);
+        }
+     }
+     addr = bootloader_get_env_record_end(addr,end);
+     if(addr == 0){
+        break;
+     }
+  }
+  
+  return last;
+}
+
+/*名称：bootloader_set_cur_env
+* 功能：更新缓存的当前env记录 同时写入后备寄存器 下次启动时使用
+* 参数：bank 记录所在的bank
+* 参数：addr 记录地址 0：缓存无效
+* 参数：next 新记录写入的地址 0：bank中不能继续写入
+* 返回：无
+*/
+static void bootloader_set_cur_env(uint8_t bank,uint32_t addr,uint32_t next)
+{
+  cur_env_bank = bank;
+  cur_env_addr = addr;
+  next_env_addr = next;
+#if  BOOTLOADER_ENV_BKP_HINT_ENABLE > 0
+  bkp_utils_write(BKP_UTILS_REG_ENV_HINT,addr == 0 ? 0 : (uint16_t)(ENV_HINT_TAG | bank << 9 | (addr - env_bank[bank].addr) / 4));
+#endif
+}
+
+#if  BOOTLOADER_ENV_BKP_HINT_ENABLE > 0
+/*名称：bootloader_check_env_hint
+* 功能：检查后备寄存器中的提示 提示的记录是bank中最后一条有效记录 另一个bank中的记录更旧
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_check_env_hint()
+{
+  uint16_t hint;
+  uint8_t bank;
+  uint32_t addr,other,next;
+  
+  hint = bkp_utils_read(BKP_UTILS_REG_ENV_HINT);
+  if((hint & ENV_HINT_TAG_MASK) != ENV_HINT_TAG){
+     return -1;
+  }
+  bank = (hint >> 9) & 1;
+  addr = env_bank[bank].addr + (hint & 0x1FF) * 4;
+  if(addr >= env_bank[bank].addr + env_bank[bank].size || !bootloader_is_env_record_valid(addr,env_bank[bank].addr + env_bank[bank].size)){
+     return -1;
+  }
+  other = env_bank[bank ^ 1].addr;
+  if(((const bootloader_env_record_t *)other)->sequence != ENV_RECORD_BLANK &&
+     ((const bootloader_env_record_t *)other)->sequence > ((const bootloader_env_record_t *)addr)->sequence){
+     return -1;
+  }
+  if(bootloader_load_env_bank(bank,&cur_env,&next) != addr){
+     return -1;
+  }
+  
+  cur_env_bank = bank;
+  cur_env_addr = addr;
+  next_env_addr = next;
+  log_debug("find cur env addr:0x%X by hint.\r\n",cur_env_addr);
+  
+  return 0;
+}
+#endif
+
+/*名称：bootloader_search_cur_env
+* 功能：找到序号最大的有效env记录 叠加bank中的记录得到当前env
+* 优先使用缓存 其次使用后备寄存器中的提示 都没有时查找两个bank的全部记录
+* 参数：无
+* 返回：0 成功 其他：没有有效的记录
+*/
+static int bootloader_search_cur_env()
+{
+  uint8_t bank;
+  uint32_t last[2],next;
+  
+  if(cur_env_addr != 0){
+     return 0;
+  }
+#if  BOOTLOADER_ENV_BKP_HINT_ENABLE > 0
+  if(bootloader_check_env_hint() == 0){
+     return 0;
+  }
+#endif
+  
+  log_debug("search cur env addr.\r\n");
+  last[0] = bootloader_load_env_bank(0,NULL,&next);
+  last[1] = bootloader_load_env_bank(1,NULL,&next);
+  if(last[0] == 0 && last[1] == 0){
+     log_error("no valid env.\r\n");
+     return -1;
+  }
+  if(last[0] == 0){
+     bank = 1;
+  }else if(last[1] == 0){
+     bank = 0;
+  }else{
+     bank = ((const bootloader_env_record_t *)last[1])->sequence > ((const bootloader_env_record_t *)last[0])->sequence ? 1 : 0;
+  }
+  
+  bootloader_load_env_bank(bank,&cur_env,&next);
+  bootloader_set_cur_env(bank,last[bank],next);
+  log_debug("find cur env addr:0x%X seq:%d.\r\n",cur_env_addr,((const bootloader_env_record_t *)cur_env_addr)->sequence);
+  
+  return 0;
+}
+
+/*名称：bootloader_build_env_delta
+* 功能：比较当前env和新的env 变化的字段写入记录缓存
+* 参数：env 新的env指针
+* 返回：增量数据大小 0：没有变化 -1：增量不比完整记录小
+*/
+static int bootloader_build_env_delta(const bootloader_env_t *env)
+{
+  const uint32_t *old_word = (const uint32_t *)&cur_env;
+  const uint32_t *new_word = (const uint32_t *)env;
+  uint8_t *data = (uint8_t *)env_record + sizeof(bootloader_env_record_t);
+  bootloader_env_delta_t *delta;
+  uint32_t i,start,end,size;
+  
+  size = 0;
+  for(i = 0; i < sizeof(bootloader_env_t) / 4;){
+     if(old_word[i] == new_word[i]){
+        i ++;
+        continue;
+     }
+     /*中间不变的字不超过ENV_DELTA_MERGE_GAP时合并成一个字段*/
+     start = i;
+     end = i + 1;
+     for(i = end; i < sizeof(bootloader_env_t) / 4 && i <= end + ENV_DELTA_MERGE_GAP; i++){
+        if(old_word[i] != new_word[i]){
+           end = i + 1;
+        }
+     }
+     i = end;
+     if(size + sizeof(bootloader_env_delta_t) + (end - start) * 4 >= sizeof(bootloader_env_t)){
+        return -1;
+     }
+     delta = (bootloader_env_delta_t *)(data + size);
+     delta->offset = start * 4;
+     delta->size = (end - start) * 4;
+     memcpy(delta + 1,&new_word[start],delta->size);
+     size += sizeof(bootloader_env_delta_t) + delta->size;
+  }
+  
+  return size;
+}
+
+/*名称：bootloader_write_env_record
+* 功能：写入记录缓存中的env记录 记录头在前crc在最后 掉电后crc错误
+* 参数：bank     写入的bank
+* 参数：addr     记录地址
+* 参数：sequence 记录序号
+* 参数：type     记录类型
+* 参数：size     记录数据大小 数据已经在记录缓存中
+* 参数：env      记录叠加后的env 写入成功后作为当前env
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_write_env_record(uint8_t bank,uint32_t addr,uint32_t sequence,uint8_t type,uint32_t size,bootloader_env_t *env)
+{
+  int rc;
+  bootloader_env_record_t *header = (bootloader_env_record_t *)env_record;
+  uint32_t bank_end = env_bank[bank].addr + env_bank[bank].size;
+  
+  header->sequence = sequence;
+  header->version = BOOTLOADER_ENV_VERSION;
+  header->type = type;
+  header->size = size;
+  env_record[(ENV_RECORD_SIZE(size) - 4) / 4] = bootloader_get_env_record_crc(header);
+  
+  log_debug("write env addr:0x%X seq:%d size:%d...\r\n",addr,sequence,ENV_RECORD_SIZE(size));
+  rc = flash_utils_write(addr,env_record,ENV_RECORD_SIZE(size) / 4);
+  env_write_cnt ++;
+  if(rc != 0 || !bootloader_is_env_record_valid(addr,bank_end)){
+     log_error("write env addr:0x%X err.\r\n",addr);  
+     bootloader_set_cur_env(0,0,0);
+     return -1;
+  }
+  cur_env = *env;
+  addr += ENV_RECORD_SIZE(size);
+  bootloader_set_cur_env(bank,addr - ENV_RECORD_SIZE(size),addr + sizeof(bootloader_env_record_t) <= bank_end ? addr : 0);
+  log_debug("done.\r\n");   
+  
+  return 0;
+}
+
+/*名称：bootloader_switch_env_bank
+* 功能：擦除另一个bank后在开头写入完整的env 之前的增量记录合并 当前bank保留到下次切换
+* 参数：bank     写入的bank
+* 参数：sequence 记录序号
+* 参数：env      env指针
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_switch_env_bank(uint8_t bank,uint32_t sequence,bootloader_env_t *env)
+{
+  int rc;
+  
+  log_warning("switch to env bank%d...\r\n",bank + 1);
+  rc = flash_utils_erase(env_bank[bank].addr,env_bank[bank].size);
+  if(rc != 0){
+     log_error("erase env bank%d err.\r\n",bank + 1);  
+     return -1;
+  }
+  memcpy((uint8_t *)env_record + sizeof(bootloader_env_record_t),env,sizeof(bootloader_env_t));
+  
+  return bootloader_write_env_record(bank,env_bank[bank].addr,sequence,ENV_RECORD_TYPE_FULL,sizeof(bootloader_env_t),env);
+}
+
+/*名称：bootloader_get_legacy_env
+* 功能：读取旧格式的env 旧格式从bank1开头连续存放bootloader_env_t 以status判断有效
+* bank2开头有效时是最新的env
+* 参数：env  env指针
+* 参数：bank 找到的env所在的bank
+* 返回：0：成功 其他：没有旧格式的env
+*/
+static int bootloader_get_legacy_env(bootloader_env_t *env,uint8_t *bank)
+{
+  const bootloader_env_t *legacy;
+  uint32_t offset;
+  
+  legacy = (const bootloader_env_t *)env_bank[1].addr;
+  if(legacy->status == BOOTLOADER_ENV_STATUS_VALID){
+     *env = *legacy;
+     *bank = 1;
+     return 0;
+  }
+  legacy = NULL;
+  for(offset = 0; offset + sizeof(bootloader_env_t) <= env_bank[0].size; offset += sizeof(bootloader_env_t)){
+     if(((const bootloader_env_t *)(env_bank[0].addr + offset))->status != BOOTLOADER_ENV_STATUS_VALID){
+        break;
+     }
+     legacy = (const bootloader_env_t *)(env_bank[0].addr + offset);
+  }
+  if(legacy == NULL){
+     return -1;
+  }
+  *env = *legacy;
+  *bank = 0;
+  
+  return 0;
+}
+
+/*名称：bootloader_if_init
+* 功能：flash接口初始化
+* 返回：0：成功 其他：失败
+*/
+static void bootloader_if_init()
+{
+  flash_utils_init();
+  bkp_utils_init();
+  /*看门狗可能已经由应用程序或者选项字节打开 擦除编程等待时喂狗*/
+  flash_engine_set_idle_hook(bootloader_feed_watchdog);
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+  /*验签时同样喂狗*/
+  ecdsa_set_idle_hook(bootloader_feed_watchdog);
+#endif
+}
+/*名称：bootloader_init
+* 功能：bootloader初始化
+* 返回：0：成功 其他：失败
+*/
+int bootloader_init()
+{
+  bootloader_env_t env;
+  uint8_t bank;
+  
+  bootloader_if_init();
+  bootloader_check_reset_reason();
+  /*flash中的env可能已经被应用程序修改 重新查找 后备寄存器中的提示保留*/
+  cur_env_addr = 0;
+
+  log_debug("check env.\r\n");
+  if(bootloader_search_cur_env() == 0){
+     return 0;
+  }
+  
+  /*旧格式的env写入另一个bank 写入完成前旧的env不会被擦除*/
+  if(bootloader_get_legacy_env(&env,&bank) == 0){
+     log_debug("convert legacy env.\r\n");
+     return bootloader_switch_env_bank(bank ^ 1,1,&env);
+  }
+  
+  log_debug("firt boot.\r\n");
+  return bootloader_switch_env_bank(0,1,&default_env);
+}
+
+/*名称：bootloader_get_env
+* 功能：获取ENV参数
+* 参数：env 环境参数指针
+* 返回：0：成功 其他：失败
+*/
+int bootloader_get_env(bootloader_env_t *env)
+{
+  if(bootloader_search_cur_env() != 0){
+     return -1;
+  }
+  *env = cur_env;
+  
+  return 0;
+}
+
+
+/*名称：bootloader_save_env
+* 功能：保存当前env
+* 参数：env 环境参数指针
+* 返回：0：成功 其他：失败
+*/
+int bootloader_save_env(bootloader_env_t *env)
+{
+  int size;
+  uint32_t sequence;
+  uint8_t bank;
+  
+  if(bootloader_search_cur_env() != 0){
+     return -1;
+  }
+  sequence = ((const bootloader_env_record_t *)cur_env_addr)->sequence + 1;
+  bank = cur_env_bank;
+  
+  size = bootloader_build_env_delta(env);
+  if(size == 0){
+     log_debug("env not changed.\r\n");
+     return 0;
+  }
+  if(next_env_addr != 0 && size > 0 && next_env_addr + ENV_RECORD_SIZE(size) <= env_bank[bank].addr + env_bank[bank].size &&
+     bootloader_write_env_record(bank,next_env_addr,sequence,ENV_RECORD_TYPE_DELTA,size,env) == 0){
+     return 0;
+  }
+  
+  /*变化太多或者增量写入失败 在当前bank追加完整的env 写入失败时缓存已经无效 重新查找跳过写坏的记录*/
+  if(bootloader_search_cur_env() == 0 && cur_env_bank == bank && next_env_addr != 0 &&
+     next_env_addr + ENV_RECORD_SIZE(sizeof(bootloader_env_t)) <= env_bank[bank].addr + env_bank[bank].size){
+     memcpy((uint8_t *)env_record + sizeof(bootloader_env_record_t),env,sizeof(bootloader_env_t));
+     if(bootloader_write_env_record(bank,next_env_addr,sequence,ENV_RECORD_TYPE_FULL,sizeof(bootloader_env_t),env) == 0){
+        return 0;
+     }
+  }
+  
+  /*当前bank已满或者写入失败 换到另一个bank 写入完整的env*/
+  return bootloader_switch_env_bank(bank ^ 1,sequence,env);
+}
+
+/*名称：bootloader_write_fw
+* 功能：flash固件写入参数
+* 参数：fw_dest_addr 固件目标地址
+* 参数：fw_src_addr  固件源地址
+* 参数：size         固件大小
+* 返回：0：成功 其他：失败
+*/
+int bootloader_write_fw(uint32_t fw_dest_addr,uint32_t fw_src_addr,uint32_t size)
+{
+  int rc;
+  /*拷贝fw*/
+  /*擦除FW区域*/
+  log_warning("program fw form addr:0x%X to 0x%X size:%d...\r\n",fw_src_addr,fw_dest_addr,size);
+  log_warning("erase addr:0x%X size:%d...\r\n",fw_dest_addr,size);
+  rc = flash_utils_erase(fw_dest_addr,size); 
+  if(rc != 0){
+  return -1;
+  }
+  log_warning("done.\r\n");
+  /*编程FW区域*/
+  log_warning("write addr:0x%X size:%d...\r\n",fw_dest_addr,size);
+  rc = flash_utils_write(fw_dest_addr,(uint32_t *)fw_src_addr,size % 4 == 0 ? size / 4 : size / 4 + 1); 
+  if(rc != 0){
+  return -1;
+  }
+  log_warning("done.\r\n");
+  return 0; 
+}
+
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
+/*名称：bootloader_is_same_page
+* 功能：比较两个flash页的内容是否相同
+* 参数：addr1 页1地址
+* 参数：addr2 页2地址
+* 返回：true：相同 false：不同
+*/
+static bool bootloader_is_same_page(uint32_t addr1,uint32_t addr2)
+{
+  return memcmp((void *)addr1,(void *)addr2,BOOTLOADER_FLASH_PAGE_SIZE) == 0;
+}
+
+/*名称：bootloader_copy_page
+* 功能：复制一页 目的页和源页相同时不擦写
+* 参数：dest_addr 目的页地址
+* 参数：src_addr  源页地址
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_copy_page(uint32_t dest_addr,uint32_t src_addr)
+{
+  if(bootloader_is_same_page(dest_addr,src_addr)){
+     return 0;
+  }
+  
+  return bootloader_write_fw(dest_addr,src_addr,BOOTLOADER_FLASH_PAGE_SIZE);
+}
+
+/*名称：bootloader_erase_journal
+* 功能：擦除进度日志页
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_erase_journal()
+{
+  int rc;
+  
+  log_warning("erase journal...\r\n");
+  rc = flash_utils_erase(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_JOURNAL_ADDR_OFFSET,BOOTLOADER_FLASH_JOURNAL_SIZE);
+  if(rc != 0){
+     log_error("erase journal addr:0x%X err.\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_JOURNAL_ADDR_OFFSET);  
+     return -1;
+  }
+  log_warning("done.\r\n"); 
+  
+  return 0;
+}
+
+/*名称：bootloader_is_journal_marked
+* 功能：进度日志的标记是否已写入 掉电时写了一半的标记也算已写入
+* 参数：index 标记序号
+* 返回：true：已写入 false：未写入
+*/
+static bool bootloader_is_journal_marked(uint32_t index)
+{
+  return *(volatile uint16_t *)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_JOURNAL_ADDR_OFFSET + index * 2) != 0xFFFF;
+}
+
+/*名称：bootloader_mark_journal
+* 功能：写入进度日志的标记 半字从0xFFFF编程为0x0000 不需要擦除
+* 参数：index 标记序号
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_mark_journal(uint32_t index)
+{
+  if(bootloader_is_journal_marked(index)){
+     return 0;
+  }
+  
+  return flash_utils_write_halfword(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_JOURNAL_ADDR_OFFSET + index * 2,0x0000);
+}
+
+/*名称：bootloader_get_journal_cnt
+* 功能：获取进度日志中已完成的页操作数量
+* 参数：无
+* 返回：已完成的页操作数量
+*/
+static uint32_t bootloader_get_journal_cnt()
+{
+  uint32_t cnt;
+  
+  for(cnt = 0; cnt < BOOTLOADER_JOURNAL_OP_CNT && bootloader_is_journal_marked(cnt); cnt++);
+  
+  return cnt;
+}
+
+/*名称：bootloader_get_swap_op_cnt
+* 功能：获取交换需要的页操作数量 两种交换方式都是原固件每页2次、更新固件每页1次
+* 参数：origin_page 原固件页数
+* 参数：update_page 更新固件页数
+* 返回：页操作数量
+*/
+static uint32_t bootloader_get_swap_op_cnt(uint32_t origin_page,uint32_t update_page)
+{
+  return origin_page * 2 + update_page;
+}
+
+#if  BOOTLOADER_SWAP_MODE == BOOTLOADER_SWAP_MODE_SCRATCH
+/*名称：bootloader_swap_page
+* 功能：执行经过交换区交换的第op个页操作
+* 顺序：按交换区大小分块，每块依次执行
+*       1.用户区的页复制到交换区 用户区和更新区相同的页只在日志中标记
+*       2.更新区的页复制到用户区
+*       3.交换区的页复制到更新区 标记为相同的页不需要复制
+* 每个页操作的源页在本块下一个步骤之前都不会被修改，掉电后重新执行当前页操作即可
+* 参数：op          页操作序号
+* 参数：origin_page 原固件页数
+* 参数：update_page 更新固件页数
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_swap_page(uint32_t op,uint32_t origin_page,uint32_t update_page)
+{
+  uint32_t block_page,base,origin_cnt,update_cnt,page;
+  
+  block_page = BOOTLOADER_FLASH_SWAP_BLOCK_SIZE / BOOTLOADER_FLASH_PAGE_SIZE;
+  /*找到op所在的块*/
+  for(base = 0; ; base += block_page){
+      origin_cnt = origin_page > base ? origin_page - base : 0;
+      origin_cnt = origin_cnt > block_page ? block_page : origin_cnt;
+      update_cnt = update_page > base ? update_page - base : 0;
+      update_cnt = update_cnt > block_page ? block_page : update_cnt;
+      if(op < origin_cnt * 2 + update_cnt){
+         break;
+      }
+      op -= origin_cnt * 2 + update_cnt;
+  }
+  /*步骤1*/
+  if(op < origin_cnt){
+     page = base + op;
+     if(page < update_page && 
+        bootloader_is_same_page(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE,
+                                BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE)){
+        return bootloader_mark_journal(BOOTLOADER_JOURNAL_OP_CNT + page);
+     }
+     return bootloader_copy_page(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET + op * BOOTLOADER_FLASH_PAGE_SIZE,
+                                 BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE);
+  }
+  op -= origin_cnt;
+  /*步骤2*/
+  if(op < update_cnt){
+     page = base + op;
+     return bootloader_copy_page(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE,
+                                 BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE);
+  }
+  op -= update_cnt;
+  /*步骤3*/
+  page = base + op;
+  if(bootloader_is_journal_marked(BOOTLOADER_JOURNAL_OP_CNT + page)){
+     return 0;
+  }
+  return bootloader_copy_page(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE,
+                              BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET + op * BOOTLOADER_FLASH_PAGE_SIZE);
+}
+#else
+/*名称：bootloader_moved_page_addr
+* 功能：原用户区第page页后移后的地址 用户区最后一页移到交换页
+* 参数：page 页序号
+* 返回：页地址
+*/
+static uint32_t bootloader_moved_page_addr(uint32_t page)
+{
+  if(page + 1 < BOOTLOADER_FLASH_USER_APPLICATION_SIZE / BOOTLOADER_FLASH_PAGE_SIZE){
+     return BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + (page + 1) * BOOTLOADER_FLASH_PAGE_SIZE;
+  }
+  
+  return BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET;
+}
+
+/*名称：bootloader_swap_page
+* 功能：执行后移交换的第op个页操作
+* 顺序：1.原固件从最后一页到第0页依次后移一页
+*       2.从第0页开始逐页：更新区第i页复制到用户区第i页，后移的原固件第i页复制到更新区第i页
+* 每个页操作的源页在下一个页操作之前都不会被擦除，掉电后重新执行当前页操作即可
+* 参数：op          页操作序号
+* 参数：origin_page 原固件页数
+* 参数：update_page 更新固件页数
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_swap_page(uint32_t op,uint32_t origin_page,uint32_t update_page)
+{
+  uint32_t page;
+  
+  /*后移*/
+  if(op < origin_page){
+     page = origin_page - 1 - op;
+     return bootloader_copy_page(bootloader_moved_page_addr(page),
+                                 BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE);
+  }
+  /*逐页交换*/
+  op -= origin_page;
+  for(page = 0; ; page++){
+      if(page < update_page){
+         if(op == 0){
+            return bootloader_copy_page(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE,
+                                        BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE);
+         }
+         op --;
+      }
+      if(page < origin_page){
+         if(op == 0){
+            return bootloader_copy_page(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + page * BOOTLOADER_FLASH_PAGE_SIZE,
+                                        bootloader_moved_page_addr(page));
+         }
+         op --;
+      }
+  }
+}
+#endif
+
+/*名称：bootloader_run_journal
+* 功能：按顺序执行页操作
+* 开始时擦除进度日志页并保存一次env，之后每完成一个页操作在日志中标记一个半字，掉电后从未完成的页操作继续
+* 参数：env         参数指针
+* 参数：step        记录在env中的步骤
+* 参数：op_cnt      页操作数量
+* 参数：page_op     页操作
+* 参数：origin_page 原固件页数
+* 参数：update_page 更新固件页数
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_run_journal(bootloader_env_t *env,swap_step_t step,uint32_t op_cnt,bootloader_page_op_t page_op,uint32_t origin_page,uint32_t update_page)
+{
+  int rc;
+  uint32_t op;
+  
+  if(env->swap_ctrl.step != step){
+     rc = bootloader_erase_journal();
+     if(rc != 0){
+        return -1;
+     }
+     env->swap_ctrl.step = step;
+     rc = bootloader_save_env(env);
+     if(rc != 0){
+        return -1;  
+     }
+  }
+  op = bootloader_get_journal_cnt();
+  log_warning("page op %d/%d.\r\n",op,op_cnt);
+  for(; op < op_cnt; op++){
+     rc = page_op(op,origin_page,update_page);
+     if(rc != 0){
+        return -1;
+     }
+     rc = bootloader_mark_journal(op);
+     if(rc != 0){
+        return -1;
+     }
+     bootloader_feed_watchdog();
+  }
+  
+  boot_timeline_mark(BOOT_TIMELINE_PHASE_UPDATE_SWAP);
+  
+  return 0;
+}
+
+/*名称：bootloader_swap_user_app
+* 功能：交换用户区和更新区的固件
+* 参数：env 参数指针
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_swap_user_app(bootloader_env_t *env)
+{
+  uint32_t origin_page,update_page;
+  
+  origin_page = (env->fw_origin.size + BOOTLOADER_FLASH_PAGE_SIZE - 1) / BOOTLOADER_FLASH_PAGE_SIZE;
+  update_page = (env->fw_update.size + BOOTLOADER_FLASH_PAGE_SIZE - 1) / BOOTLOADER_FLASH_PAGE_SIZE;
+  
+  return bootloader_run_journal(env,SWAP_STEP_JOURNAL,bootloader_get_swap_op_cnt(origin_page,update_page),bootloader_swap_page,origin_page,update_page);
+}
+
+/*名称：bootloader_overwrite_page
+* 功能：覆盖升级的第op个页操作 更新区第op页复制到用户区第op页
+* 更新区不会被修改，掉电后重新执行当前页操作即可
+* 参数：op          页操作序号
+* 参数：origin_page 原固件页数
+* 参数：update_page 更新固件页数
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_overwrite_page(uint32_t op,uint32_t origin_page,uint32_t update_page)
+{
+  (void)origin_page;
+  (void)update_page;
+  
+  return bootloader_copy_page(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + op * BOOTLOADER_FLASH_PAGE_SIZE,
+                              BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + op * BOOTLOADER_FLASH_PAGE_SIZE);
+}
+
+/*名称：bootloader_check_update_sha256
+* 功能：按页读取更新区计算sha256 和env中的摘要比较 env中没有摘要时不校验
+* 参数：env 参数指针
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_check_update_sha256(bootloader_env_t *env)
+{
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  uint32_t start_time;
+  
+  if(env->fw_update.sha256.tag != BOOTLOADER_FW_SHA256_TAG){
+     log_warning("update no sha256.skip check.\r\n");
+     return 0;
+  }
+  if(env->fw_update.size > BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE){
+     log_error("update size:%d err.\r\n",env->fw_update.size);
+     return -1;
+  }
+  
+  start_time = HAL_GetTick();
+  bootloader_calculate_sha256(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,env->fw_update.size,digest);
+  log_debug("update size:%d sha256 %dms.\r\n",env->fw_update.size,HAL_GetTick() - start_time);
+  
+  if(memcmp(digest,env->fw_update.sha256.value,SHA256_DIGEST_SIZE) != 0){
+     return -1;
+  }
+  
+  return 0;
+}
+
+/*名称：bootloader_is_overwrite_update
+* 功能：判断本次升级是否是覆盖升级 更新的固件头带有BOOTLOADER_IMAGE_FLAG_OVERWRITE标志
+* 参数：env 参数指针
+* 返回：true：是 false：否
+*/
+static bool bootloader_is_overwrite_update(bootloader_env_t *env)
+{
+  const bootloader_image_header_t *header;
+  
+  if(env->swap_ctrl.step == SWAP_STEP_OVERWRITE){
+     return true;
+  }
+  if(env->swap_ctrl.step == SWAP_STEP_INIT){
+     header = bootloader_get_image_header(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
+                                          BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                                          BOOTLOADER_FLASH_USER_APPLICATION_SIZE);
+     /*下载的数据可能在固件之后带有签名块*/
+     return header != NULL && header->size <= env->fw_update.size && (header->flags & BOOTLOADER_IMAGE_FLAG_OVERWRITE) != 0;
+  }
+  
+  return false;
+}
+
+/*名称：bootloader_overwrite_user_app
+* 功能：更新区的固件直接写入用户区 不能回滚
+* 参数：env 参数指针
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_overwrite_user_app(bootloader_env_t *env)
+{
+  int rc;
+  uint32_t update_page;
+  
+  log_warning("overwrite user app.no rollback...\r\n");
+  update_page = (env->fw_update.size + BOOTLOADER_FLASH_PAGE_SIZE - 1) / BOOTLOADER_FLASH_PAGE_SIZE;
+  rc = bootloader_run_journal(env,SWAP_STEP_OVERWRITE,update_page,bootloader_overwrite_page,0,update_page);
+  if(rc != 0){
+     return -1;
+  }
+  
+  env->boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
+  env->fw_origin = env->fw_update;
+  env->swap_ctrl.step = SWAP_STEP_INIT;
+  rc = bootloader_save_env(env);
+  if(rc != 0){
+     return -1;  
+  }
+  log_warning("done.\r\n");
+  
+  return 0;
+}
+
+/*名称：bootloader_get_package
+* 功能：识别补丁包或压缩包
+* 参数：addr    包地址
+* 参数：size    包大小
+* 参数：raw_size 解包后的固件大小
+* 参数：raw_crc  解包后的固件crc32
+* 返回：包类型
+*/
+static bootloader_package_t bootloader_get_package(uint32_t addr,uint32_t size,uint32_t *raw_size,uint32_t *raw_crc)
+{
+  delta_header_t delta_header;
+  lz_header_t lz_header;
+  
+  if(delta_get_header((uint8_t *)addr,size,&delta_header) == 0){
+     *raw_size = delta_header.new_size;
+     *raw_crc = delta_header.new_crc;
+     return BOOTLOADER_PACKAGE_DELTA;
+  }
+  if(lz_get_header((uint8_t *)addr,size,&lz_header) == 0){
+     *raw_size = lz_header.raw_size;
+     *raw_crc = lz_header.raw_crc;
+     return BOOTLOADER_PACKAGE_LZ;
+  }
+  
+  return BOOTLOADER_PACKAGE_NONE;
+}
+
+/*名称：bootloader_is_package_update
+* 功能：判断本次升级是否是补丁包或者压缩包升级
+* 参数：env 参数指针
+* 返回：true：是 false：否
+*/
+static bool bootloader_is_package_update(bootloader_env_t *env)
+{
+  uint32_t raw_size,raw_crc;
+  
+  if(env->swap_ctrl.step == SWAP_STEP_COPY_PACKAGE_TO_SWAP || env->swap_ctrl.step == SWAP_STEP_COPY_USER_TO_UPDATE){
+     return true;
+  }
+  if(env->swap_ctrl.step == SWAP_STEP_INIT){
+     return bootloader_get_package(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,env->fw_update.size,&raw_size,&raw_crc) != BOOTLOADER_PACKAGE_NONE;
+  }
+  
+  return false;
+}
+
+/*名称：bootloader_unpack_write
+* 功能：把解包生成的新固件数据写入用户区
+* 参数：offset 数据在新固件中的偏移
+* 参数：buffer 数据地址
+* 参数：size   数据大小
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_unpack_write(uint32_t offset,const uint8_t *buffer,uint32_t size)
+{
+  return bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + offset,(uint32_t)buffer,size);
+}
+
+/*名称：bootloader_check_package
+* 功能：检查更新区的包是否完整以及是否能用于当前用户区固件
+* 参数：env 参数指针
+* 返回：0：可以使用 其他：不能使用
+*/
+static int bootloader_check_package(bootloader_env_t *env)
+{
+  uint8_t *package = (uint8_t *)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET);
+  delta_header_t delta_header;
+  lz_header_t lz_header;
+  
+  if(delta_get_header(package,env->fw_update.size,&delta_header) == 0){
+     /*补丁包需要交换区保存补丁 原固件用于回滚*/
+     if(env->fw_update.size > BOOTLOADER_FLASH_SWAP_BLOCK_SIZE){
+        log_error("patch size:%d is large than swap block.\r\n",env->fw_update.size);
+        return -1;
+     }
+     if(delta_header.new_size > BOOTLOADER_FLASH_USER_APPLICATION_SIZE){
+        log_error("new fw size:%d is too large.\r\n",delta_header.new_size);
+        return -1;
+     }
+     if(crc32_calculate(package + sizeof(delta_header_t),env->fw_update.size - sizeof(delta_header_t)) != delta_header.patch_crc){
+        log_error("patch crc err.\r\n");
+        return -1;
+     }
+     if(delta_header.old_size != env->fw_origin.size || 
+        crc32_calculate((uint8_t *)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET),delta_header.old_size) != delta_header.old_crc){
+        log_error("patch does not match user app.\r\n");
+        return -1;
+     }
+     return 0;
+  }
+  
+  if(lz_get_header(package,env->fw_update.size,&lz_header) == 0){
+     if(lz_header.raw_size > BOOTLOADER_FLASH_USER_APPLICATION_SIZE){
+        log_error("new fw size:%d is too large.\r\n",lz_header.raw_size);
+        return -1;
+     }
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+     /*交换区放不下的压缩包直接解压到用户区 验签失败时原固件已经被覆盖*/
+     if(env->fw_update.size > BOOTLOADER_FLASH_SWAP_BLOCK_SIZE){
+        log_error("lz size:%d is large than swap block.no rollback with sign.\r\n",env->fw_update.size);
+        return -1;
+     }
+#endif
+     if(crc32_calculate(package + sizeof(lz_header_t),env->fw_update.size - sizeof(lz_header_t)) != lz_header.data_crc){
+        log_error("lz data crc err.\r\n");
+        return -1;
+     }
+     return 0;
+  }
+  
+  return -1;
+}
+
+/*名称：bootloader_unpack
+* 功能：解包生成新固件写入用户区并校验
+* 参数：package_addr 包地址
+* 参数：package_size 包大小
+* 参数：origin_addr  补丁包对应的原固件地址
+* 参数：origin_size  补丁包对应的原固件大小
+* 参数：raw_size     生成的新固件大小
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_unpack(uint32_t package_addr,uint32_t package_size,uint32_t origin_addr,uint32_t origin_size,uint32_t *raw_size)
+{
+  int rc;
+  uint32_t raw_crc;
+  bootloader_package_t package;
+  
+  package = bootloader_get_package(package_addr,package_size,raw_size,&raw_crc);
+  if(package == BOOTLOADER_PACKAGE_DELTA){
+     log_warning("apply patch.\r\n");
+     rc = delta_apply((uint8_t *)package_addr,package_size,(uint8_t *)origin_addr,origin_size,
+                      unpack_buffer,BOOTLOADER_FLASH_PAGE_SIZE,bootloader_unpack_write);
+  }else if(package == BOOTLOADER_PACKAGE_LZ){
+     log_warning("decompress.\r\n");
+     rc = lz_decompress((uint8_t *)package_addr,package_size,(uint8_t *)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET),
+                        unpack_buffer,BOOTLOADER_FLASH_PAGE_SIZE,bootloader_unpack_write);
+  }else{
+     log_error("package header err.\r\n");
+     return -1;
+  }
+  if(rc != 0){
+     log_error("unpack err.\r\n");
+     return -1;
+  }
+  if(crc32_calculate((uint8_t *)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET),*raw_size) != raw_crc){
+     log_error("new fw crc err.\r\n");
+     return -1;
+  }
+  
+  return 0;
+}
+
+/*名称：bootloader_set_unpacked_fw
+* 功能：记录解包生成的新固件 包的摘要只对应包本身 按用户区中的新固件重新计算
+* 参数：fw       固件信息 版本沿用包的版本
+* 参数：raw_size 新固件大小
+* 返回：无
+*/
+static void bootloader_set_unpacked_fw(bootloader_fw_t *fw,uint32_t raw_size)
+{
+  fw->size = raw_size;
+  bootloader_calculate_sha256(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,raw_size,fw->sha256.value);
+  fw->sha256.tag = BOOTLOADER_FW_SHA256_TAG;
+}
+
+/*名称：bootloader_package_user_app
+* 功能：用更新区的补丁包或者压缩包更新用户APP
+* 步骤：1.包复制到交换区 2.原固件复制到更新区用于回滚 3.解包生成新固件写入用户区并校验
+* 不能放入交换区的压缩包直接从更新区解压到用户区，不保留原固件，不能回滚 签名模式下不支持
+* 参数：env  环境参数指针
+* 返回：0：成功 其他：失败
+*/
+static int bootloader_package_user_app(bootloader_env_t *env)
+{
+  int rc;
+  uint32_t raw_size;
+  bootloader_fw_t fw_temp,fw_new;
+  
+  log_warning("unpack user app...\r\n");
+  /*步骤1.检查包并复制到交换区*/
+  if(env->swap_ctrl.step == SWAP_STEP_INIT){
+     if(bootloader_check_package(env) != 0){
+        /*包无效 放弃本次升级*/
+        log_error("discard update.\r\n");
+        env->boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
+        return bootloader_save_env(env);
+     }
+     /*交换区放不下 直接解压 更新区不会被修改，掉电后重新执行即可*/
+     if(env->fw_update.size > BOOTLOADER_FLASH_SWAP_BLOCK_SIZE){
+        log_warning("package is large than swap block.no rollback.\r\n");
+        rc = bootloader_unpack(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,env->fw_update.size,0,0,&raw_size);
+        if(rc != 0){
+           return -1;
+        }
+        env->boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
+        env->fw_origin = env->fw_update;
+        bootloader_set_unpacked_fw(&env->fw_origin,raw_size);
+        rc = bootloader_save_env(env);
+        if(rc != 0){
+           return -1;  
+        }
+        log_warning("done.\r\n");
+        return 0;
+     }
+     log_warning("copy package to swap.\r\n");
+     rc = bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,
+                              BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
+                              env->fw_update.size);
+     if(rc != 0){
+        return -1;
+     }
+     env->swap_ctrl.step = SWAP_STEP_COPY_PACKAGE_TO_SWAP;
+     rc = bootloader_save_env(env);
+     if(rc != 0){
+        return -1;  
+     }
+  }
+  /*步骤2.原固件复制到更新区*/
+  if(env->swap_ctrl.step == SWAP_STEP_COPY_PACKAGE_TO_SWAP){
+     log_warning("copy user to update.\r\n");
+     rc = bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
+                              BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                              env->fw_origin.size);
+     if(rc != 0){
+        return -1;
+     }
+     env->swap_ctrl.step = SWAP_STEP_COPY_USER_TO_UPDATE;
+     rc = bootloader_save_env(env);
+     if(rc != 0){
+        return -1;  
+     }
+  }
+  /*步骤3.生成新固件 输入都不会被修改，掉电后重新执行本步骤即可*/
+  rc = bootloader_unpack(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,env->fw_update.size,
+                         BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,env->fw_origin.size,&raw_size);
+  if(rc != 0){
+     return -1;
+  }
+  /*写入env前校验新固件 签名模式下验签 失败时从更新区恢复原固件 放弃本次升级*/
+  fw_new = env->fw_update;
+  bootloader_set_unpacked_fw(&fw_new,raw_size);
+  if(bootloader_check_image(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                            BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                            BOOTLOADER_FLASH_USER_APPLICATION_SIZE,&fw_new.sha256) != 0){
+     log_error("new fw check err.restore user app.\r\n");
+     rc = bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                              BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
+                              env->fw_origin.size);
+     if(rc != 0){
+        return -1;
+     }
+     env->boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
+     env->swap_ctrl.step = SWAP_STEP_INIT;
+     return bootloader_save_env(env);
+  }
+  
+  env->boot_flag = BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE;
+  
+  fw_temp = env->fw_origin;
+  env->fw_origin = fw_new;
+  env->fw_update = fw_temp;
+  env->swap_ctrl.step = SWAP_STEP_INIT;
+  /*保存当前env*/ 
+  rc = bootloader_save_env(env);
+  if(rc != 0){
+     return -1;  
+  }
+  log_warning("done.\r\n");
+  
+  return 0;
 }
 
-/*名称：bootloader_erase_bank2
-* 功能：擦除bank2空间
+#else
+/*名称：bootloader_get_newest_slot
+* 功能：获取序号最大的有效固件所在的区
 * 参数：无
-* 返回：0：成功 其他：失败
-*/
-static int bootloader_erase_bank2()
-{
-  int rc;
-  /*擦除bank2参数区域*/
-  log_warning("erase bank2...\r\n");
-  rc = flash_utils_erase(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET,BOOTLOADER_FLASH_ENV_BANK2_SIZE);
-  if(rc != 0){
-   log_error("erase bank2 addr:0x%X err.\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET);  
-   return -1;
-   }    
-  log_warning("done.\r\n"); 
-   
- return 0; 
-}
-
-/*名称：bootloader_read_bank1_env
-* 功能：读取bank1空间的env
-* 参数：offset env在bank1的偏移量
-* 参数：env env指针
-* 返回：0：成功 其他：失败
+* 返回：区的起始地址 0：没有有效的固件
 */
-static int bootloader_read_bank1_env(uint32_t offset,bootloader_env_t *env)
+static uint32_t bootloader_get_newest_slot()
 {
-  int rc;
-  log_debug("read bank1 env addr:0x%X...\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET + offset * sizeof(bootloader_env_t));
-  rc = flash_utils_read((uint32_t *)env,BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET + offset * sizeof(bootloader_env_t),sizeof(bootloader_env_t) / 4);
-  if(rc != 0 ){
-    log_error("read bank2 env addr:0x%X err.\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET + offset * sizeof(bootloader_env_t));  
-    return -1;
+  const bootloader_image_header_t *user,*update;
+  
+  user = bootloader_get_image_header(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                                     BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_USER_APPLICATION_SIZE);
+  update = bootloader_get_image_header(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
+                                       BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE);
+  
+  if(update != NULL && (user == NULL || update->sequence > user->sequence)){
+     return update->load_addr;
+  }
+  if(user != NULL){
+     return user->load_addr;
   }
-  log_debug("done.\r\n");   
   
   return 0;
 }
 
-/*名称：bootloader_write_bank1_env
-* 功能：向bank1空间写入env
-* 参数：offset env在bank1的偏移量
-* 参数：env env指针
-* 返回：0：成功 其他：失败
+/*名称：bootloader_get_confirmed_slot
+* 功能：获取env中记录的已确认运行的区
+* 参数：env 参数指针
+* 返回：区的起始地址 0：没有记录
 */
-static int bootloader_write_bank1_env(uint32_t offset,bootloader_env_t *env)
+static uint32_t bootloader_get_confirmed_slot(const bootloader_env_t *env)
 {
-  int rc;
-  log_debug("write bank1 env addr:0x%X...\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET + offset * sizeof(bootloader_env_t));
-  rc = flash_utils_write(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET + offset * sizeof(bootloader_env_t),(uint32_t *)env,sizeof(bootloader_env_t) / 4);
-  if( rc != 0 ){
-    log_error("write bank2 env addr:0x%X err.\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET + offset * sizeof(bootloader_env_t));  
-    return -1;
+  if(env->swap_ctrl.origin_offset != BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET &&
+     env->swap_ctrl.origin_offset != BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET){
+     return 0;
   }
-  log_debug("done.\r\n");   
   
-  return 0;
+  return BOOTLOADER_FLASH_BASE_ADDR + env->swap_ctrl.origin_offset;
 }
 
-/*名称：bootloader_get_bank1_env_cnt
-* 功能：获取bank1空间可存储的env数量
-* 参数：无 
+/*名称：bootloader_check_slot
+* 功能：校验区内的固件 直接运行模式下没有固件头的区无效
+* 参数：slot_addr 区的起始地址
+* 参数：verified  验签标记
 * 返回：0：成功 其他：失败
 */
-static int bootloader_get_bank1_env_cnt()
+static int bootloader_check_slot(uint32_t slot_addr,bootloader_fw_sha256_t *verified)
 {
-  return  BOOTLOADER_FLASH_ENV_BANK1_SIZE / sizeof(bootloader_env_t);
+  uint32_t slot_size;
+  
+  if(((const bootloader_image_header_t *)(slot_addr + BOOTLOADER_IMAGE_HEADER_OFFSET))->magic != BOOTLOADER_IMAGE_MAGIC){
+     return -1;
+  }
+  slot_size = slot_addr == BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET ?
+              BOOTLOADER_FLASH_USER_APPLICATION_SIZE : BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE;
+  
+  return bootloader_check_image(slot_addr,slot_addr,slot_size,verified);
 }
 
-/*名称：bootloader_read_bank2_env
-* 功能：读取bank2空间的env
-* 参数：offset env在bank2的偏移量
-* 参数：env env指针
-* 返回：0：成功 其他：失败
+/*名称：bootloader_select_slot
+* 功能：选择要运行的区 升级和试运行时优先序号大的新固件 其他时候优先env中记录的已确认的区
+* 没有确认的新固件不会因为序号大而运行 优先的区校验失败时运行另一个区
+* 参数：env      参数指针
+* 参数：verified 验签标记 校验时更新
+* 返回：区的起始地址 0：没有有效的固件
 */
-static int bootloader_read_bank2_env(uint32_t offset,bootloader_env_t *env)
+static uint32_t bootloader_select_slot(const bootloader_env_t *env,bootloader_fw_sha256_t *verified)
 {
-  int rc;
-  log_debug("read bank2 env addr:0x%X...\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET + offset * sizeof(bootloader_env_t));
-  rc = flash_utils_read((uint32_t *)env,BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET + offset * sizeof(bootloader_env_t),sizeof(bootloader_env_t) / 4);
-  if( rc != 0 ){
-    log_error("read bank2 env addr:0x%X err.\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET + offset * sizeof(bootloader_env_t));  
-    return -1;
+  const bootloader_image_header_t *user,*update;
+  uint32_t prefer,other;
+  
+  user = (const bootloader_image_header_t *)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + BOOTLOADER_IMAGE_HEADER_OFFSET);
+  update = (const bootloader_image_header_t *)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + BOOTLOADER_IMAGE_HEADER_OFFSET);
+  prefer = 0;
+  if(env->boot_flag != BOOTLOADER_FLAG_BOOT_UPDATE && env->boot_flag != BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE){
+     prefer = bootloader_get_confirmed_slot(env);
   }
-  log_debug("done.\r\n");   
+  /*固件头在校验前只用于比较序号*/
+  if(prefer == 0){
+     prefer = update->magic == BOOTLOADER_IMAGE_MAGIC && (user->magic != BOOTLOADER_IMAGE_MAGIC || update->sequence > user->sequence) ?
+              BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET :
+              BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET;
+  }
+  other = prefer == BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET ?
+          BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET :
+          BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET;
   
-  return 0;
-}
-/*名称：bootloader_write_bank2_env
-* 功能：向bank2空间写入env
-* 参数：offset env在bank2的偏移量
-* 参数：env env指针
-* 返回：0：成功 其他：失败
-*/
-static int bootloader_write_bank2_env(uint32_t offset,bootloader_env_t *env)
-{
-  int rc;
-  log_debug("write bank2 env addr:0x%X...\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET + offset * sizeof(bootloader_env_t));
-  rc = flash_utils_write(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET + offset * sizeof(bootloader_env_t),(uint32_t *)env,sizeof(bootloader_env_t) / 4);
-  if( rc != 0 ){
-    log_error("write bank2 env addr:0x%X err.\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET + offset * sizeof(bootloader_env_t));  
-    return -1;
+  if(bootloader_check_slot(prefer,verified) == 0){
+     return prefer;
+  }
+  log_warning("image addr:0x%X invalid.try addr:0x%X.\r\n",prefer,other);
+  if(bootloader_check_slot(other,verified) == 0){
+     return other;
   }
-  log_debug("done.\r\n");   
   
   return 0;
 }
 
-/*名称：bootloader_flush_env
-* 功能：重置bank1的存储空间
-* 参数：env 当前env指针
-* 返回：0 成功 其他：失败
-*/ 
-static int bootloader_flush_env(bootloader_env_t *env)
-{ 
-   int rc;
-   /*步骤1.擦除bank2*/
-   log_debug("step 1.erase bank2...\r\n");
-   rc = bootloader_erase_bank2();
-   if(rc != 0){
-      return -1;
-    }
-   log_debug("done.\r\n");
-    /*步骤2.把当前env写入到bank2 offset0*/
-   log_debug("step 2.write bank1 env to bank2...\r\n");
-   rc = bootloader_write_bank2_env(0,env);
-   if(rc != 0){
-      log_error("write bank1 offset addr:0x%X err.\r\n",0);  
-      return -1;
-    }         
-   /*步骤3.擦除bank1 */
-   log_debug("step 3.erase bank1...\r\n");
-   rc = bootloader_erase_bank1();
-   if(rc != 0){
-      return -1;
-   }
-   /*步骤4.把env回写到bank1*/
-   log_debug("step 4.write env to bank1...\r\n");
-   rc = bootloader_write_bank1_env(0,env);
-   if(rc != 0){
-      log_error("write bank1 offset addr:0x%X err.\r\n",0);  
-      return -1;
-    }    
-   /* 步骤5.擦除bank2*/
-   log_debug("step 5.erase bank2...\r\n");
-   rc = bootloader_erase_bank2();
-   if(rc != 0){
-      return -1;
-    } 
-   
-   return 0;
-}
-
-/*名称：bootloader_if_init
-* 功能：flash接口初始化
-* 返回：0：成功 其他：失败
+/*名称：bootloader_get_valid_slot_cnt
+* 功能：获取有效固件的数量
+* 参数：无
+* 返回：有效固件的数量
 */
-static void bootloader_if_init()
+static uint32_t bootloader_get_valid_slot_cnt()
 {
-  flash_utils_init();
+  uint32_t cnt = 0;
+  
+  if(bootloader_get_image_header(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                                 BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_USER_APPLICATION_SIZE) != NULL){
+     cnt ++;
+  }
+  if(bootloader_get_image_header(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
+                                 BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE) != NULL){
+     cnt ++;
+  }
+  
+  return cnt;
 }
-/*名称：bootloader_init
-* 功能：bootloader初始化
+
+/*名称：bootloader_invalidate_slot
+* 功能：把区内固件头的magic编程为0 使固件无效 不需要擦除
+* 参数：slot_addr 区的起始地址
 * 返回：0：成功 其他：失败
 */
-int bootloader_init()
+static int bootloader_invalidate_slot(uint32_t slot_addr)
 {
   int rc;
-  bootloader_env_t env_bank1,env_bank2;
+  uint32_t magic_addr;
   
-  bootloader_if_init();
-
-  log_debug("check env.\r\n");
-  rc = bootloader_read_bank1_env(0,&env_bank1);
+  log_warning("invalidate image addr:0x%X.\r\n",slot_addr);
+  magic_addr = slot_addr + BOOTLOADER_IMAGE_HEADER_OFFSET;
+  rc = flash_utils_write_halfword(magic_addr,0x0000);
   if(rc != 0){
-    return -1;
+     return -1;
   }
-  
-  rc = bootloader_read_bank2_env(0,&env_bank2);
+  rc = flash_utils_write_halfword(magic_addr + 2,0x0000);
   if(rc != 0){
-    return -1;
+     return -1;
   }
   
-  if(env_bank1.status != BOOTLOADER_ENV_STATUS_VALID && env_bank2.status != BOOTLOADER_ENV_STATUS_VALID){  
-    
-     /*把默认env写入bank1区域第一个位置*/
-     log_debug("firt boot.\r\n");
-      /*第一次启动，擦除bank1*/
-     rc = bootloader_erase_bank1();
-     if(rc != 0){
-        return -1;
-     }
-     rc = bootloader_write_bank1_env(0,&default_env);
-     if(rc != 0){
-        log_error("write bank1 offset addr:0x%X err.\r\n",0);  
-        return -1;
-     } 
-     log_debug("done.\r\n")   
-  }else if(env_bank2.status == BOOTLOADER_ENV_STATUS_VALID){
-     /*有数据没有回写到bank1，回写到bank1*/ 
-     log_debug("need recovery bank1 env.\r\n");
-    /*擦除bank1参数区域*/
-    rc = bootloader_erase_bank1();  
-    if(rc != 0){
-      return -1;
-    }    
-    log_debug("done.\r\n");   
-    /*把bank2的env写入bank1区域第一个位置*/
-    rc = bootloader_write_bank1_env(0,&env_bank2);
-    if(rc != 0){
-      log_error("write bank1 offset addr:0x%X err.\r\n",0);  
-      return -1;
-    } 
-   /*擦除bank1参数区域*/
-   rc = bootloader_erase_bank1();   
-   if(rc != 0){
-      return -1;
-    }  
-  }
   return 0;
 }
- 
-/*名称：bootloader_search_cur_env_offset
-* 功能：找到当前的env的在bank1的偏移
-* 参数：env_offset偏移量
-* 返回：0 成功 其他：失败
-*/
-static int bootloader_search_cur_env_offset(uint32_t *env_offset)
-{
-    int rc;
-    uint32_t offset = 0;
-    uint32_t env_cnt;
-    bootloader_env_t env;
-    
-    log_debug("search cur env addr.\r\n");
-    log_debug("search bank1...\r\n");
-    
-    env_cnt = bootloader_get_bank1_env_cnt(); 
-    while(offset < env_cnt){
-        rc = bootloader_read_bank1_env(offset,&env);
-        if(rc != 0){
-           return -1;
-        }
-        if(env.status != BOOTLOADER_ENV_STATUS_VALID){
-           break;  
-        }
-        offset ++;
-    }
-    if(offset == 0){
-     log_error("bank1 is null.\r\n");
-     return -1;  
-    }
-
-    if(offset >= env_cnt){
-      log_debug("bank1 is full.\r\n");
-      *env_offset = env_cnt - 1;
-    }else{
-      *env_offset = offset - 1;
-    }
-    log_debug("find cur env offset:%d.\r\n",*env_offset );
-    
-    return 0;
-}
-
-
-/*名称：bootloader_search_next_env_offset
-* 功能：搜索下一个可写入env的偏移量
-* 参数：env_offset 偏移量指针
-* 返回：0 成功 其他 失败
-*/
-static int bootloader_search_next_env_offset(uint32_t *env_offset)
-{
-    int rc;
-    uint32_t offset = 0;
-    uint32_t env_cnt;
-    bootloader_env_t env;
-    
-    log_debug("search next env offset.\r\n");
-    log_debug("search bank1...\r\n");
-    
-    env_cnt = bootloader_get_bank1_env_cnt(); 
-    while(offset < env_cnt){
-        rc = bootloader_read_bank1_env(offset,&env);
-        if(rc != 0){
-           return -1;
-        }
-        if(env.status != BOOTLOADER_ENV_STATUS_VALID){
-           break;  
-        }
-        offset ++;
-    } 
-    if(offset == 0){
-       log_error("bank1 is null. err.\r\n");
-       return -1;
-    }
-    /*bank1全部写入了env*/
-    if(offset >= env_cnt){
-       log_debug("bank1 is full.\r\n");     
-       *env_offset = BANK_FULL_ENV_OFFSET;            
-    }else{
-       *env_offset = offset; 
-    }
-    log_debug("find next env offset:%d.\r\n",*env_offset ); 
-    
-    return 0;
-}
-
+#endif
 
-/*名称：bootloader_get_env
-* 功能：获取ENV参数
-* 参数：env 环境参数指针
-* 返回：0：成功 其他：失败
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP || BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+/*名称：bootloader_calculate_sha256
+* 功能：按页读取flash计算sha256
+* 参数：addr   数据地址
+* 参数：size   数据大小
+* 参数：digest 摘要 SHA256_DIGEST_SIZE字节
+* 返回：无
 */
-int bootloader_get_env(bootloader_env_t *env)
+static void bootloader_calculate_sha256(uint32_t addr,uint32_t size,uint8_t *digest)
 {
-  int rc;
-  uint32_t env_offset;
-
-  rc = bootloader_search_cur_env_offset(&env_offset);
-  if(rc < 0 ){
-    return -1;
-  }else {
-    rc = bootloader_read_bank1_env(env_offset,env);
-    if(rc != 0){
-       return -1;
-   }
+  sha256_ctx_t ctx;
+  uint32_t len;
+  
+  sha256_init(&ctx);
+  while(size > 0){
+     len = size > BOOTLOADER_FLASH_PAGE_SIZE ? BOOTLOADER_FLASH_PAGE_SIZE : size;
+     sha256_update(&ctx,(const void *)addr,len);
+     bootloader_feed_watchdog();
+     addr += len;
+     size -= len;
   }
-  return 0;
+  sha256_final(&ctx,digest);
 }
+#endif
 
-
-/*名称：bootloader_save_env
-* 功能：保存当前env
-* 参数：env 环境参数指针
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+/*名称：bootloader_verify_image_sign
+* 功能：校验固件的签名块 固件的sha256和验签标记相同时已经验签过 否则验签并更新验签标记
+* 签名块在下载的数据中 其中的内容不作为验签结果 验签标记只由bootloader写入env
+* 参数：image_addr 固件所在的地址
+* 参数：header     已经校验过crc的固件头
+* 参数：slot_size  运行区的大小
+* 参数：verified   验签标记 NULL：总是验签
 * 返回：0：成功 其他：失败
 */
-int bootloader_save_env(bootloader_env_t *env)
+static int bootloader_verify_image_sign(uint32_t image_addr,const bootloader_image_header_t *header,uint32_t slot_size,bootloader_fw_sha256_t *verified)
 {
+  const bootloader_image_sign_t *sign;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  uint32_t sign_addr,start_time,hash_time;
   int rc;
-  uint32_t env_offset;
   
-  rc = bootloader_search_next_env_offset(&env_offset);
-  if(rc < 0 ){
+  sign_addr = image_addr + ((header->size + 3) & ~3U);
+  if(sign_addr + sizeof(bootloader_image_sign_t) > image_addr + slot_size){
+     log_error("image addr:0x%X no space for sign.\r\n",image_addr);
+     return -1;
+  }
+  sign = (const bootloader_image_sign_t *)sign_addr;
+  if(sign->magic != BOOTLOADER_IMAGE_SIGN_MAGIC){
+     log_error("image addr:0x%X no sign.\r\n",image_addr);
      return -1;
   }
   
-  if(env_offset == BANK_FULL_ENV_OFFSET){
-     rc = bootloader_flush_env(env);
-     if(rc != 0){
-        return -1;
-     }
-  }else{     
-    rc = bootloader_write_bank1_env( env_offset,env);  
-    if(rc != 0 ){
-       return -1;
-    }
+  start_time = HAL_GetTick();
+  bootloader_calculate_sha256(image_addr,header->size,digest);
+  hash_time = HAL_GetTick() - start_time;
+  if(verified != NULL && verified->tag == BOOTLOADER_FW_SHA256_VERIFIED_TAG && memcmp(verified->value,digest,SHA256_DIGEST_SIZE) == 0){
+     log_debug("image addr:0x%X size:%d verified sha256:%dms.\r\n",image_addr,header->size,hash_time);
+     return 0;
+  }
+  rc = ecdsa_p256_verify(sign_public_key,digest,sign->signature);
+  log_warning("image addr:0x%X size:%d verify sha256:%dms ecdsa:%dms.\r\n",image_addr,header->size,hash_time,HAL_GetTick() - start_time - hash_time);
+  if(rc != 0){
+     log_error("image addr:0x%X sign err.\r\n",image_addr);
+     return -1;
+  }
+  if(verified != NULL){
+     memcpy(verified->value,digest,SHA256_DIGEST_SIZE);
+     verified->tag = BOOTLOADER_FW_SHA256_VERIFIED_TAG;
   }
   
   return 0;
 }
+#endif
 
-/*名称：bootloader_write_fw
-* 功能：flash固件写入参数
-* 参数：fw_dest_addr 固件目标地址
-* 参数：fw_src_addr  固件源地址
-* 参数：size         固件大小
-* 返回：0：成功 其他：失败
+/*名称：bootloader_get_image_crc
+* 功能：计算固件的crc32 跳过固件头中的crc字段 硬件计算失败时用软件重新计算
+* 参数：image_addr 固件所在的地址
+* 参数：size       固件大小
+* 返回：crc结果
 */
-int bootloader_write_fw(uint32_t fw_dest_addr,uint32_t fw_src_addr,uint32_t size)
+static uint32_t bootloader_get_image_crc(uint32_t image_addr,uint32_t size)
 {
-  int rc;
-  /*拷贝fw*/
-  /*擦除FW区域*/
-  log_warning("program fw form addr:0x%X to 0x%X size:%d...\r\n",fw_src_addr,fw_dest_addr,size);
-  log_warning("erase addr:0x%X size:%d...\r\n",fw_dest_addr,size);
-  rc = flash_utils_erase(fw_dest_addr,size); 
-  if(rc != 0){
-  return -1;
-  }
-  log_warning("done.\r\n");
-  /*编程FW区域*/
-  log_warning("write addr:0x%X size:%d...\r\n",fw_dest_addr,size);
-  rc = flash_utils_write(fw_dest_addr,(uint32_t *)fw_src_addr,size % 4 == 0 ? size / 4 : size / 4 + 1); 
-  if(rc != 0){
-  return -1;
+  uint32_t crc_addr,crc;
+  uint32_t start_time;
+  
+  start_time = HAL_GetTick();
+  crc_addr = image_addr + BOOTLOADER_IMAGE_HEADER_OFFSET + offsetof(bootloader_image_header_t,crc);
+#if  BOOTLOADER_IMAGE_CRC_HW_ENABLE > 0
+  crc32_hw_reset();
+  if(crc32_hw_update((const void *)image_addr,crc_addr - image_addr) == 0 &&
+     crc32_hw_update((const void *)(crc_addr + 4),image_addr + size - crc_addr - 4) == 0){
+     crc = crc32_hw_value();
+     log_debug("image addr:0x%X size:%d hw crc:0x%X %dms.\r\n",image_addr,size,crc,HAL_GetTick() - start_time);
+     return crc;
   }
-  log_warning("done.\r\n");
-  return 0; 
+  log_error("hw crc err.use software.\r\n");
+#endif
+  crc = crc32_update(CRC32_INIT_VALUE,(const void *)image_addr,crc_addr - image_addr);
+  crc = crc32_update(crc,(const void *)(crc_addr + 4),image_addr + size - crc_addr - 4);
+  log_debug("image addr:0x%X size:%d crc:0x%X %dms.\r\n",image_addr,size,crc,HAL_GetTick() - start_time);
+  
+  return crc;
 }
 
-/*名称：bootloader_copy_user_to_swap
-* 功能：从用户区复制数据到交换区
-* 参数：env 参数指针
-* 返回：0：成功 其他：失败
+/*名称：bootloader_get_image_header
+* 功能：获取固件头 检查固件头、链接地址、中断向量表和固件crc
+* 参数：image_addr 固件所在的地址
+* 参数：load_addr  固件应该链接的运行地址
+* 参数：slot_size  运行区的大小
+* 返回：固件头指针 NULL：没有有效的固件
 */
-static int bootloader_copy_user_to_swap(bootloader_env_t *env)
+const bootloader_image_header_t *bootloader_get_image_header(uint32_t image_addr,uint32_t load_addr,uint32_t slot_size)
 {
-  int rc;
-  uint32_t size;
-  
-  /*第一次运行或者已经完成上一步骤是 SWAP_STEP_COPY_SWAP_TO_UPDATE 情况下才会执行过程*/
-  log_warning("copy user app to swap.\r\n");
-  if(env->swap_ctrl.step == SWAP_STEP_INIT || env->swap_ctrl.step == SWAP_STEP_COPY_SWAP_TO_UPDATE){    
-     if(env->swap_ctrl.origin_offset < env->fw_origin.size){  
-        size = env->fw_origin.size - env->swap_ctrl.origin_offset > BOOTLOADER_FLASH_SWAP_BLOCK_SIZE ? BOOTLOADER_FLASH_SWAP_BLOCK_SIZE : env->fw_origin.size - env->swap_ctrl.origin_offset;
-        rc = bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,
-                                 BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + env->swap_ctrl.origin_offset,
-                                 size);
-        if(rc != 0){
-           return -1;
-         }           
-         env->swap_ctrl.origin_offset += env->swap_ctrl.size;
-         env->swap_ctrl.size = size;
-     }
-  env->swap_ctrl.step = SWAP_STEP_COPY_USER_TO_SWAP;
-  /*保存当前env*/ 
-  rc = bootloader_save_env(env);
-  if(rc != 0){
-   return -1;  
+  const bootloader_image_header_t *header;
+  uint32_t msp,reset_handler,crc;
+  
+  header = (const bootloader_image_header_t *)(image_addr + BOOTLOADER_IMAGE_HEADER_OFFSET);
+  if(header->magic != BOOTLOADER_IMAGE_MAGIC){
+     return NULL;
   }
+  /*固件必须是为运行区链接的*/
+  if(header->load_addr != load_addr || header->size <= BOOTLOADER_IMAGE_HEADER_OFFSET + sizeof(bootloader_image_header_t) || header->size > slot_size){
+     log_error("image addr:0x%X link addr:0x%X size:%d err.\r\n",image_addr,header->load_addr,header->size);
+     return NULL;
   }
-  log_warning("done.\r\n");
-  return 0;
- } 
-  
-/*名称：bootloader_copy_update_to_user
-* 功能：从更新区复制数据到用户区
-* 参数：env 参数指针
-* 返回：0：成功 其他：失败
-*/
-static int bootloader_copy_update_to_user(bootloader_env_t *env)
-{
-  int rc;
-  uint32_t size;
-  
-  log_warning("copy update to user.\r\n");
-  /*上一步骤是SWAP_STEP_COPY_USER_TO_SWAP情况下才会执行复制过程*/
-  if(env->swap_ctrl.step == SWAP_STEP_COPY_USER_TO_SWAP){
-     if(env->swap_ctrl.update_offset < env->fw_update.size){
-        size = env->fw_update.size - env->swap_ctrl.update_offset > BOOTLOADER_FLASH_SWAP_BLOCK_SIZE ? BOOTLOADER_FLASH_SWAP_BLOCK_SIZE : env->fw_update.size - env->swap_ctrl.update_offset;
-        rc = bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + env->swap_ctrl.update_offset,
-                                 BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + env->swap_ctrl.update_offset,
-                                 size);
-        if(rc != 0){
-           return -1;
-        } 
-       env->swap_ctrl.update_offset += size;
-    }
-    env->swap_ctrl.step = SWAP_STEP_COPY_UPDATE_TO_USER;
-    /*保存当前env*/ 
-    rc = bootloader_save_env(env);
-    if(rc != 0){
-      return -1;  
-    }
+  msp = *(uint32_t *)image_addr;
+  reset_handler = *(uint32_t *)(image_addr + 4);
+  if(msp <= BOOTLOADER_SRAM_BASE_ADDR || msp > BOOTLOADER_SRAM_SHARED_ADDR ||
+     reset_handler < load_addr || reset_handler >= load_addr + header->size){
+     log_error("image addr:0x%X vector msp:0x%X reset:0x%X err.\r\n",image_addr,msp,reset_handler);
+     return NULL;
   }
-  log_warning("done.\r\n");
-  return 0;
+  crc = bootloader_get_image_crc(image_addr,header->size);
+  if(crc != header->crc){
+     log_error("image addr:0x%X crc:0x%X expect:0x%X err.\r\n",image_addr,crc,header->crc);
+     return NULL;
+  }
+  
+  return header;
 }
 
-/*名称：bootloader_copy_swap_to_update
-* 功能：从交换区复制数据到更新区
-* 参数：env env参数指针
+/*名称：bootloader_check_image
+* 功能：校验区内的固件 没有固件头的固件无法校验 按有效处理
+* 参数：image_addr 固件所在的地址
+* 参数：load_addr  固件应该链接的运行地址
+* 参数：slot_size  运行区的大小
+* 参数：verified   验签标记 和固件相同时不再验签 验签通过后更新 NULL：总是验签
 * 返回：0：成功 其他：失败
 */
-static int bootloader_copy_swap_to_update(bootloader_env_t *env)
+static int bootloader_check_image(uint32_t image_addr,uint32_t load_addr,uint32_t slot_size,bootloader_fw_sha256_t *verified)
 {
-  int rc;
+  const bootloader_image_header_t *header;
   
-  log_warning("copy swap to update.\r\n");
-  /*上一步骤是SWAP_STEP_COPY_UPDATE_TO_USER情况下才会执行复制过程*/
-  if(env->swap_ctrl.step == SWAP_STEP_COPY_UPDATE_TO_USER){
-     if(env->swap_ctrl.size > 0){  
-        rc = bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET + env->swap_ctrl.origin_offset,
-                                 BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,
-                                 env->swap_ctrl.size);
-        if(rc != 0){
-           return -1;
-        }           
-        env->swap_ctrl.origin_offset += env->swap_ctrl.size;
-        env->swap_ctrl.size = 0;
-    }
-    env->swap_ctrl.step = SWAP_STEP_COPY_SWAP_TO_UPDATE;
-    /*保存当前env*/ 
-    rc = bootloader_save_env(env);
-    if(rc != 0){
-       return -1;  
-    }
+  header = (const bootloader_image_header_t *)(image_addr + BOOTLOADER_IMAGE_HEADER_OFFSET);
+  if(header->magic != BOOTLOADER_IMAGE_MAGIC){
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+     log_error("image addr:0x%X no header.\r\n",image_addr);
+     return -1;
+#else
+     log_warning("image addr:0x%X no header.skip check.\r\n",image_addr);
+     return 0;
+#endif
   }
-  log_warning("done.\r\n");
+  header = bootloader_get_image_header(image_addr,load_addr,slot_size);
+  if(header == NULL){
+     return -1;
+  }
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+  return bootloader_verify_image_sign(image_addr,header,slot_size,verified);
+#else
+  (void)verified;
   return 0;
- } 
-  
+#endif
+}
 
 /*名称：bootloader_update_user_app
 * 功能：更新用户APP
@@ -618,21 +2209,66 @@ int bootloader_update_user_app(bootloader_env_t *env)
 {
  int rc;
  bootloader_fw_t fw_temp;
+ bootloader_fw_sha256_t verified;
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_XIP
+ uint32_t slot_addr;
+#endif
+ 
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
+ /*开始交换前校验下载的数据 摘要错误时不修改任何固件*/
+ if(env->swap_ctrl.step == SWAP_STEP_INIT && bootloader_check_update_sha256(env) != 0){
+    log_error("update sha256 err.discard update.\r\n");
+    env->boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
+    return bootloader_save_env(env);
+ }
+ 
+ /*更新区是补丁包或者压缩包*/
+ if(bootloader_is_package_update(env)){
+    return bootloader_package_user_app(env);
+ }
+ 
+ /*开始交换或覆盖前校验更新的固件 开始后更新区或用户区已经被修改 没有验签标记 总是验签*/
+ /*验签标记随fw_update在交换开始时保存 完成后成为fw_origin的验签标记*/
+ if(env->swap_ctrl.step == SWAP_STEP_INIT){
+    memset(&verified,0,sizeof(verified));
+    if(bootloader_check_image(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
+                              BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                              BOOTLOADER_FLASH_USER_APPLICATION_SIZE,&verified) != 0){
+       log_error("update image check err.discard update.\r\n");
+       env->boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
+       return bootloader_save_env(env);
+    }
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+    env->fw_update.sha256 = verified;
+#endif
+ }
+ 
+ boot_timeline_mark(BOOT_TIMELINE_PHASE_UPDATE_VERIFY);
+ 
+ /*不需要回滚的固件直接覆盖*/
+ if(bootloader_is_overwrite_update(env)){
+    return bootloader_overwrite_user_app(env);
+ }
  
  log_warning("update user app...\r\n");
- /*等待所有数据复制完毕*/
- while(env->swap_ctrl.update_offset != env->fw_update.size || env->swap_ctrl.origin_offset != env->fw_origin.size){ 
-    /*以下3个步骤顺序，循环执行*/
-   if( bootloader_copy_user_to_swap(env) != 0){
-      return -1;
-   }
-   if( bootloader_copy_update_to_user(env)!= 0){
-      return -1;
-   }
-   if( bootloader_copy_swap_to_update(env)!= 0){
-      return -1;
-   }
+ if(bootloader_swap_user_app(env) != 0){
+    return -1;
  }
+#else
+ /*直接运行模式不复制固件 选择序号最大的有效固件 记录在env中 试运行和确认后都运行这个区*/
+ log_warning("select user app...\r\n");
+ memset(&verified,0,sizeof(verified));
+ slot_addr = bootloader_select_slot(env,&verified);
+ if(slot_addr == 0 || slot_addr == bootloader_get_confirmed_slot(env)){
+    log_error("no new valid image.discard update.\r\n");
+    env->boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
+    return bootloader_save_env(env);
+ }
+ log_warning("new image addr:0x%X.\r\n",slot_addr);
+#if  BOOTLOADER_IMAGE_SIGN_ENABLE > 0
+ env->fw_update.sha256 = verified;
+#endif
+#endif
  
  env->boot_flag = BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE;
 
@@ -640,7 +2276,11 @@ int bootloader_update_user_app(bootloader_env_t *env)
  env->fw_origin = env->fw_update;
  env->fw_update = fw_temp;
  env->swap_ctrl.step = SWAP_STEP_INIT;
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
  env->swap_ctrl.origin_offset = 0;
+#else
+ env->swap_ctrl.origin_offset = slot_addr - BOOTLOADER_FLASH_BASE_ADDR;
+#endif
  env->swap_ctrl.update_offset = 0;
  env->swap_ctrl.size = 0;
  /*保存当前env*/ 
@@ -661,17 +2301,55 @@ int bootloader_update_user_app(bootloader_env_t *env)
 int bootloader_recovery_user_app(bootloader_env_t *env)
 {
  int rc;
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_XIP
+ uint32_t slot_addr;
+#endif
  
  log_warning("recovery user app...\r\n");
- bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
-                     BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
-                     env->fw_update.size);
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
+ /*复制失败或者复制后的固件校验失败时不修改env 下次启动重新恢复*/
+ rc = bootloader_write_fw(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                          BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,
+                          env->fw_update.size);
+ if(rc != 0){
+    log_error("recovery write err.\r\n");
+    return -1;
+ }
+ /*原固件的验签标记在fw_update中*/
+ if(bootloader_check_image(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                           BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET,
+                           BOOTLOADER_FLASH_USER_APPLICATION_SIZE,&env->fw_update.sha256) != 0){
+    log_error("recovery image check err.\r\n");
+    return -1;
+ }
+#else
+ /*回滚只需要使试运行的新固件无效 只剩一个有效固件时不能回滚 另一个区记录为已确认的区*/
+ slot_addr = bootloader_get_confirmed_slot(env);
+ if(slot_addr == 0){
+    slot_addr = bootloader_get_newest_slot();
+ }
+ if(bootloader_get_valid_slot_cnt() > 1){
+    rc = bootloader_invalidate_slot(slot_addr);
+    if(rc != 0){
+       return -1;
+    }
+ }else{
+    log_error("no image to recovery.\r\n");
+ }
+ slot_addr = slot_addr == BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET ?
+             BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET :
+             BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET;
+#endif
  
  env->fw_origin = env->fw_update;
  env->boot_flag = BOOTLOADER_FLAG_BOOT_NORMAL;
  
  env->swap_ctrl.step = SWAP_STEP_INIT;
+#if  BOOTLOADER_BOOT_MODE == BOOTLOADER_BOOT_MODE_SWAP
  env->swap_ctrl.origin_offset = 0;
+#else
+ env->swap_ctrl.origin_offset = slot_addr - BOOTLOADER_FLASH_BASE_ADDR;
+#endif
  env->swap_ctrl.update_offset = 0;
  env->swap_ctrl.size = 0;
  /*保存当前env*/ 
@@ -683,3 +2361,77 @@ int bootloader_recovery_user_app(bootloader_env_t *env)
    
  return 0;
 }
+
+/*名称：bootloader_stat_reset
+* 功能：开始新的升级代价统计区间
+* 参数：无
+* 返回：无
+*/
+void bootloader_stat_reset()
+{
+  env_write_cnt = 0;
+  stat_start_time = HAL_GetTick();
+  flash_utils_stat_reset();
+}
+
+/*名称：bootloader_stat_report
+* 功能：输出统计区间内的耗时、各分区页擦除次数和env写入次数
+* 参数：name 统计的操作名称
+* 返回：无
+*/
+void bootloader_stat_report(const char *name)
+{
+  const flash_utils_stat_t *stat;
+  uint32_t i,page,page_begin,page_end;
+  uint32_t erase_cnt,erase_max;
+  
+  stat = flash_utils_get_stat();
+  if(stat == NULL){
+     return;
+  }
+  log_warning("%s cost: time:%dms estimate:%dms erase:%d pages %dms program:%d halfwords %dms env write:%d.\r\n",
+              name,HAL_GetTick() - stat_start_time,flash_utils_stat_estimate_time(),
+              stat->erase_cnt,stat->erase_time,stat->program_cnt,stat->program_time,env_write_cnt);
+  log_warning("%s skip: blank erase:%d pages 0xFFFF program:%d halfwords.\r\n",name,stat->erase_skip_cnt,stat->program_skip_cnt);
+  if(stat->erase_time > 0 && stat->program_time > 0){
+     log_warning("%s erase:%dKB/s program:%dKB/s.\r\n",name,
+                 stat->erase_cnt * (BOOTLOADER_FLASH_PAGE_SIZE / 1024) * 1000 / stat->erase_time,
+                 stat->program_cnt * 2 * 1000 / 1024 / stat->program_time);
+  }
+  
+  for(i = 0; i < sizeof(flash_region) / sizeof(flash_region[0]); i++){
+     page_begin = flash_region[i].offset / BOOTLOADER_FLASH_PAGE_SIZE;
+     page_end = (flash_region[i].offset + flash_region[i].size) / BOOTLOADER_FLASH_PAGE_SIZE;
+     erase_cnt = 0;
+     erase_max = 0;
+     for(page = page_begin; page < page_end && page < FLASH_UTILS_STAT_PAGE_CNT; page++){
+        erase_cnt += stat->page_erase_cnt[page];
+        if(stat->page_erase_cnt[page] > erase_max){
+           erase_max = stat->page_erase_cnt[page];
+        }
+     }
+     log_warning("%s erase:%d pages max per page:%d.\r\n",flash_region[i].name,erase_cnt,erase_max);
+  }
+}
+
+/*名称：bootloader_flash_bench
+* 功能：在交换区测试flash擦除和编程速度并输出 交换区没有使用时才能调用
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+int bootloader_flash_bench()
+{
+  int rc;
+  flash_utils_bench_t bench;
+  
+  log_warning("flash bench addr:0x%X size:%d...\r\n",BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,BOOTLOADER_FLASH_SWAP_BLOCK_SIZE);
+  rc = flash_utils_bench(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,BOOTLOADER_FLASH_SWAP_BLOCK_SIZE,&bench);
+  if(rc != 0){
+     log_error("flash bench err.\r\n");
+     return -1;
+  }
+  log_warning("erase:%dKB/s hal program:%dKB/s fast program:%dKB/s engine program:%dKB/s.\r\n",
+              bench.erase_speed,bench.hal_program_speed,bench.fast_program_speed,bench.engine_program_speed);
+  
+  return 0;
+}
@@ -5,6 +5,7 @@
 
 #define  BOOTLOADER_FLASH_BASE_ADDR                      (0x08000000)
 #define  BOOTLOADER_FLASH_BOOTLOADER_ADDR_OFFSET         (0x00000000)
+#define  BOOTLOADER_FLASH_BOOTLOADER_SIZE                (0x6000) /*bootloader 24k*/
 #define  BOOTLOADER_FLASH_PAGE_SIZE                      (0x800)
 
 #define  BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET          (0x6000)
@@ -19,11 +20,60 @@
 #define  BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET (0x20000)/*更新的应用程序区 100k*/
 #define  BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE        (0x19000)
 
-#define  BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET         (0x39000)/*数据交换区 20k*/
-#define  BOOTLOADER_FLASH_SWAP_BLOCK_SIZE                (0x5000)
+/*交换方式*/
+#define  BOOTLOADER_SWAP_MODE_SCRATCH                    0        /*经过交换区按20k块三步交换*/
+#define  BOOTLOADER_SWAP_MODE_MOVE                       1        /*用户区固件整体后移一页后逐页交换 交换区只需要一页*/
+#define  BOOTLOADER_SWAP_MODE                            BOOTLOADER_SWAP_MODE_SCRATCH
 
+#define  BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET         (0x39000)/*数据交换区*/
+#if  BOOTLOADER_SWAP_MODE == BOOTLOADER_SWAP_MODE_MOVE
+#define  BOOTLOADER_FLASH_SWAP_BLOCK_SIZE                (0x800)  /*2k 0x39800之后的18k空闲*/
+#else
+#define  BOOTLOADER_FLASH_SWAP_BLOCK_SIZE                (0x5000) /*20k*/
+#endif
 
-#define  BOOTLOADER_RESET_LATER_TIME                     3        /*复位延时 单位：秒*/
+/*启动方式*/
+#define  BOOTLOADER_BOOT_MODE_SWAP                       0        /*更新的固件交换到用户区后运行*/
+#define  BOOTLOADER_BOOT_MODE_XIP                        1        /*用户区和更新区的固件都在原地运行 不复制固件 不支持补丁包和压缩包*/
+#define  BOOTLOADER_BOOT_MODE                            BOOTLOADER_BOOT_MODE_SWAP
+
+#define  BOOTLOADER_SRAM_BASE_ADDR                       (0x20000000)
+#define  BOOTLOADER_SRAM_SIZE                            (0x10000)/*64k*/
+#define  BOOTLOADER_SRAM_SHARED_ADDR                     (0x2000FF00)/*SRAM末尾256字节 启动时间线 启动信息和命令邮箱 固件的栈不能覆盖*/
+
+#define  BOOTLOADER_FLASH_JOURNAL_ADDR_OFFSET            (0x3E000)/*交换进度日志 2k*/
+#define  BOOTLOADER_FLASH_JOURNAL_SIZE                   (0x800)
+#define  BOOTLOADER_JOURNAL_OP_CNT                       (BOOTLOADER_FLASH_JOURNAL_SIZE / 4)/*前半页记录页操作 后半页记录相同的页*/
+
+
+#define  BOOTLOADER_ENV_BKP_HINT_ENABLE                  1        /*当前env的位置记录在后备寄存器 启动时不用查找*/
+#define  BOOTLOADER_WR_PROTECTION_ENABLE                 1        /*按策略写保护 bootloader始终保护 交换模式下用户区只在升级和回滚时打开 关闭时全部不保护*/
+#define  BOOTLOADER_ENV_VERSION                          1        /*env结构版本 bootloader_env_t只能在末尾增加字段*/
+
+#define  BOOTLOADER_RESET_RETRY_CNT                      3        /*连续失败这么多次之内立即复位 之后每次的等待时间加倍*/
+#define  BOOTLOADER_RESET_BACKOFF_MAX_TIME               64       /*失败复位前最长的等待时间 单位：秒*/
+#define  BOOTLOADER_LOG_FLUSH_TIMEOUT                    100      /*跳转前等待日志输出完毕的最长时间 单位：ms*/
+
+/*试运行 新固件没有确认时打开独立看门狗后运行 挂死后由看门狗复位 试运行次数记录在后备寄存器 不写flash*/
+/*看门狗打开后不能关闭 新固件需要喂狗 试运行BOOTLOADER_TRIAL_BOOT_CNT次都没有确认时回滚*/
+#define  BOOTLOADER_TRIAL_BOOT_ENABLE                    1
+#define  BOOTLOADER_TRIAL_BOOT_CNT                       3        /*没有确认时最多运行的次数*/
+#define  BOOTLOADER_TRIAL_IWDG_PRESCALER                 IWDG_PRESCALER_256
+#define  BOOTLOADER_TRIAL_IWDG_RELOAD                    4095     /*LSI约40kHz 超时约26秒*/
+
+/*bootloader失败复位的原因 记录在后备寄存器 下次启动时输出*/
+typedef enum
+{
+BOOTLOADER_RESET_REASON_NONE = 0,
+BOOTLOADER_RESET_REASON_INIT,       /*查找或者初始化env失败*/
+BOOTLOADER_RESET_REASON_ENV_READ,   /*读取env失败*/
+BOOTLOADER_RESET_REASON_WRP,        /*修改写保护 修改成功后也会复位*/
+BOOTLOADER_RESET_REASON_UPDATE,     /*升级失败*/
+BOOTLOADER_RESET_REASON_ENV_SAVE,   /*保存env失败*/
+BOOTLOADER_RESET_REASON_RECOVERY,   /*回滚失败*/
+BOOTLOADER_RESET_REASON_BOOT,       /*没有可以运行的固件*/
+BOOTLOADER_RESET_REASON_CNT
+}bootloader_reset_reason_t;
 
 typedef enum
 {
@@ -36,13 +86,18 @@ typedef enum
 SWAP_STEP_INIT = 0x00000000U,
 SWAP_STEP_COPY_USER_TO_SWAP = 0x22334455U,
 SWAP_STEP_COPY_UPDATE_TO_USER,
-SWAP_STEP_COPY_SWAP_TO_UPDATE
+SWAP_STEP_COPY_SWAP_TO_UPDATE,
+SWAP_STEP_COPY_PACKAGE_TO_SWAP, /*补丁包或压缩包升级：包已复制到交换区*/
+SWAP_STEP_COPY_USER_TO_UPDATE,  /*补丁包或压缩包升级：原固件已复制到更新区*/
+SWAP_STEP_JOURNAL,              /*逐页交换中：进度记录在进度日志页*/
+SWAP_STEP_OVERWRITE             /*覆盖升级中：进度记录在进度日志页*/
 }swap_step_t;
 
 
 /*更新完成 需要新的应用程序改回BOOTLOADER_FLAG_BOOT_UPDATE_OK代表升级成功*/
 /*如果第二次bootloader启动时是BOOTLOADER_FLAG_BOOT_UPDATE_OK 代表升级成功 设置为 BOOTLOADER_FLAG_BOOT_NORMAL*/
 /*如果第二次bootloader启动时仍然是BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE 代表升级失败 进行回滚操作 回滚完成设置BOOTLOADER_FLAG_BOOT_NORMAL*/
+/*打开试运行时 BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE会再运行新固件 直到试运行BOOTLOADER_TRIAL_BOOT_CNT次后才回滚*/
 typedef enum
 {
 BOOTLOADER_FLAG_BOOT_NORMAL = 0x12340000U, /*正常启动*/
@@ -51,10 +106,14 @@ BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE,     /*更新完成,待验证是否成功*/
 BOOTLOADER_FLAG_BOOT_UPDATE_OK,           /*更新成功*/
 }bootloader_flag_t;
 
+#define  BOOTLOADER_FW_SHA256_TAG                        (0x32414853U)/*"SHA2"*/
+#define  BOOTLOADER_FW_SHA256_VERIFIED_TAG               (0x56414853U)/*"SHAV" 验签标记 只由bootloader写入fw_origin*/
+
 typedef struct
 {
-char value[36];
-}bootloader_fw_md5_t;
+uint8_t  value[32];/*更新区前size字节的sha256 由应用程序下载完成后填写*/
+uint32_t tag;      /*BOOTLOADER_FW_SHA256_TAG：value有效 BOOTLOADER_FW_SHA256_VERIFIED_TAG：value是验签通过的固件头size字节的sha256 其他：没有摘要 不校验*/
+}bootloader_fw_sha256_t;
 
 typedef struct
 {
@@ -66,7 +125,7 @@ uint32_t  code;
 typedef struct
 {
 uint32_t    update_offset;/*更新区的偏移*/
-uint32_t    origin_offset;/*用户区的偏移*/
+uint32_t    origin_offset;/*用户区的偏移 直接运行模式下是已确认运行的区的偏移 0：没有记录*/
 uint32_t    size;         /*交换区的数据大小*/
 swap_step_t step;         /*当前已完成的步骤*/
 }bootloader_swap_ctrl_t;
@@ -74,20 +133,105 @@ swap_step_t step;         /*当前已完成的步骤*/
 typedef struct
 {
 bootloader_fw_version_t version;
-bootloader_fw_md5_t     md5;
+bootloader_fw_sha256_t  sha256;
 uint32_t                size;
 }bootloader_fw_t;
 
+/*固件头 应用程序在固件偏移BOOTLOADER_IMAGE_HEADER_OFFSET处保留，由tools/bm_image填写*/
+/*直接运行模式下 用户区和更新区哪个是待更新的区由应用程序根据自己的链接地址决定 升级时运行序号最大的有效固件 确认后一直运行这个区*/
+#define  BOOTLOADER_IMAGE_HEADER_OFFSET                  (0x200)  /*在中断向量表之后*/
+#define  BOOTLOADER_IMAGE_MAGIC                          (0x48494D42U)/*"BMIH"*/
+#define  BOOTLOADER_IMAGE_FLAG_OVERWRITE                 (1 << 0) /*交换模式下直接覆盖用户区 不保留原固件 不能回滚*/
+#define  BOOTLOADER_IMAGE_CRC_HW_ENABLE                  1        /*用硬件CRC单元校验固件 关闭时用软件计算 结果相同*/
+#define  BOOTLOADER_IMAGE_SIGN_ENABLE                    0        /*固件必须带有签名块 公钥在bootloader_if.c中配置*/
+#define  BOOTLOADER_IMAGE_SIGN_MAGIC                     (0x47495342U)/*"BSIG"*/
+
+typedef struct
+{
+uint32_t  magic;     /*BOOTLOADER_IMAGE_MAGIC*/
+uint32_t  load_addr; /*固件链接的运行地址 必须是用户区或者更新区的起始地址*/
+uint32_t  size;      /*固件大小*/
+uint32_t  version;   /*固件版本*/
+uint32_t  sequence;  /*发布序号 越大越新*/
+uint32_t  flags;     /*固件标志*/
+uint32_t  crc;       /*固件前size字节的crc32 计算时跳过本字段*/
+uint32_t  reserved[1];
+}bootloader_image_header_t;
+
+/*签名块 由tools/bm_sign追加在固件之后 按4字节对齐*/
+/*验签比较耗时 通过后bootloader把固件的sha256作为验签标记写入env的fw_origin 以后启动摘要相同时不再验签*/
+/*签名块在下载的数据中 不能保存验签结果 升级时总是重新验签*/
+typedef struct
+{
+uint32_t  magic;        /*BOOTLOADER_IMAGE_SIGN_MAGIC*/
+uint8_t   signature[64];/*固件前size字节sha256的ECDSA P-256签名 r||s 大端*/
+uint32_t  verified;     /*保留 0xFFFFFFFF 不作为验签结果使用*/
+}bootloader_image_sign_t;
+
 typedef struct
 {
 bootloader_flag_t       boot_flag;    /*启动标志*/
-uint32_t                reserved[32]; /*保留32个参数，供应用程序使用*/
+uint32_t                reserved[32]; /*保留32个参数，供应用程序使用 经常修改的设置放在kv_store中*/
 bootloader_fw_t         fw_update;    /*更新的固件*/
 bootloader_fw_t         fw_origin;    /*原有的固件*/
 bootloader_swap_ctrl_t  swap_ctrl;    /*数据交换控制*/
 bootloader_env_status_t status;       /*环境参数状态*/
 }bootloader_env_t;
 
+/*启动信息 跳转前写入SRAM末尾不初始化的区域 在启动时间线之后 应用程序的链接文件也要保留这个区域*/
+/*跳转时保留时钟配置 应用程序可以根据这里的记录跳过时钟初始化*/
+#define  BOOTLOADER_BOOT_INFO_ADDR                       (0x2000FF40)
+#define  BOOTLOADER_BOOT_INFO_MAGIC                      (0x464E4942U)/*"BINF"*/
+#define  BOOTLOADER_HANDOFF_KEEP_CLOCK                   1        /*跳转时保留bootloader的时钟配置 0：恢复到复位后的HSI*/
+
+typedef struct
+{
+uint32_t  magic;        /*BOOTLOADER_BOOT_INFO_MAGIC*/
+uint32_t  size;         /*结构大小 只能在末尾增加字段*/
+uint32_t  core_clock;   /*SystemCoreClock 单位：Hz*/
+uint32_t  rcc_cr;       /*RCC->CR 打开的时钟源和PLL*/
+uint32_t  rcc_cfgr;     /*RCC->CFGR 系统时钟源 PLL倍频和总线分频*/
+uint32_t  flash_acr;    /*FLASH->ACR flash等待周期*/
+uint32_t  reset_flags;  /*RCC->CSR 本次复位的标志 bootloader已经清除*/
+uint16_t  reset_reason; /*上次bootloader失败复位的记录 高8位：bootloader_reset_reason_t 低8位：启动阶段*/
+uint16_t  reset_cnt;    /*上次bootloader连续失败复位的次数*/
+uint32_t  boot_flag;    /*跳转时env中的启动标志*/
+uint32_t  trial_cnt;    /*新固件已经试运行的次数 0：已经确认*/
+uint32_t  image_addr;   /*运行的固件地址*/
+uint32_t  image_version;/*固件头中的版本 0：没有固件头*/
+uint32_t  boot_time;    /*跳转时的HAL_GetTick 单位：ms 各阶段的时间在启动时间线中*/
+uint32_t  cmd;          /*本次启动执行的邮箱命令 BOOTLOADER_CMD_NONE：没有命令*/
+int32_t   cmd_result;   /*邮箱命令的结果 0：成功 其他：失败*/
+uint32_t  crc;          /*前面字段的crc32*/
+}bootloader_boot_info_t;
+
+/*命令邮箱 应用程序写入后软件复位 bootloader执行命令 不需要写flash*/
+/*命令只修改env的副本 开始升级或者回滚时才写入flash 成功跳转到应用程序时清除邮箱*/
+/*命令执行后在邮箱中记录结果 跳转前复位(例如修改写保护)后不再执行 只重新修改env的副本*/
+/*不支持进入下载模式的命令：bootloader没有通信接口 应用程序把固件下载到更新区后发送BOOTLOADER_CMD_UPDATE*/
+#define  BOOTLOADER_MAILBOX_ADDR                         (0x2000FF80)/*在启动信息之后*/
+#define  BOOTLOADER_MAILBOX_MAGIC                        (0x584F424DU)/*"MBOX"*/
+#define  BOOTLOADER_MAILBOX_DONE                         (0x454E4F44U)/*"DONE"*/
+
+typedef enum
+{
+BOOTLOADER_CMD_NONE = 0,
+BOOTLOADER_CMD_UPDATE,    /*更新区已经下载完成 开始升级 只在正常启动状态执行*/
+BOOTLOADER_CMD_ROLLBACK,  /*新固件还没有确认时立即回滚 不再试运行*/
+BOOTLOADER_CMD_SELF_TEST, /*跳转前检查固件和flash 结果在启动信息中*/
+BOOTLOADER_CMD_CNT
+}bootloader_cmd_t;
+
+typedef struct
+{
+uint32_t          magic;    /*BOOTLOADER_MAILBOX_MAGIC*/
+uint32_t          cmd;      /*bootloader_cmd_t*/
+bootloader_fw_t   fw_update;/*BOOTLOADER_CMD_UPDATE：更新区中下载的固件 其他命令不使用*/
+uint32_t          crc;      /*前面字段的crc32*/
+uint32_t          done;     /*BOOTLOADER_MAILBOX_DONE：bootloader已经执行过 其他：没有执行*/
+int32_t           result;   /*执行过的命令的结果*/
+}bootloader_mailbox_t;
+
 
 /******************************************************************************/
 /*             bootloader 接口                                                */
@@ -99,26 +243,71 @@ bootloader_env_status_t status;       /*环境参数状态*/
 int bootloader_init();
 
 /*名称：bootloader_boot_user_application
-* 功能：启动用户区APP
+* 功能：启动用户区APP 新固件没有确认时打开看门狗并增加试运行次数
+* 跳转前写入启动信息 复位外设 清除中断 中断向量表指向固件
 * 参数：无
-* 返回：无
+* 返回：固件校验失败时返回
 */
 void bootloader_boot_user_application();
 
+/*名称：bootloader_get_boot_info
+* 功能：获取bootloader跳转前写入的启动信息 应用程序调用
+* 参数：无
+* 返回：启动信息指针 NULL：没有有效的启动信息
+*/
+const bootloader_boot_info_t *bootloader_get_boot_info();
+
+/*名称：bootloader_post_command
+* 功能：写入命令邮箱 应用程序调用 然后调用bootloader_boot_bootloader
+* 参数：cmd       命令
+* 参数：fw_update BOOTLOADER_CMD_UPDATE时是更新区中下载的固件 其他命令为NULL
+* 返回：0：成功 其他：失败 不支持的命令返回失败
+*/
+int bootloader_post_command(bootloader_cmd_t cmd,const bootloader_fw_t *fw_update);
+
+/*名称：bootloader_handle_mailbox
+* 功能：检查命令邮箱 按命令修改env的副本 结果记录在邮箱和启动信息中 已经执行过的命令不再执行
+* 参数：env 环境参数指针
+* 返回：无
+*/
+void bootloader_handle_mailbox(bootloader_env_t *env);
+
 /*名称：bootloader_boot_bootloader
-* 功能：应用程序启动bootloader
+* 功能：应用程序启动bootloader 软件复位 命令邮箱保留
 * 参数：无
 * 返回：无
 */
 void bootloader_boot_bootloader();
 
+/*名称：bootloader_get_trial_boot_cnt
+* 功能：获取新固件已经试运行的次数
+* 参数：无
+* 返回：次数
+*/
+uint32_t bootloader_get_trial_boot_cnt();
+
 /*名称：bootloader_reset
-* 功能：应用程序复位
+* 功能：应用程序复位 立即复位
 * 参数：无
 * 返回：无
 */
 void bootloader_reset();
 
+/*名称：bootloader_fail_reset
+* 功能：bootloader失败复位 原因 启动阶段和连续失败次数记录在后备寄存器
+* 连续失败BOOTLOADER_RESET_RETRY_CNT次之内立即复位 之后等待1 2 4...秒 最长BOOTLOADER_RESET_BACKOFF_MAX_TIME
+* 参数：reason 失败原因
+* 返回：无
+*/
+void bootloader_fail_reset(bootloader_reset_reason_t reason);
+
+/*名称：bootloader_delay
+* 功能：延时 等待时喂狗
+* 参数：ms 毫秒
+* 返回：无
+*/
+void bootloader_delay(uint32_t ms);
+
 /*名称：bootloader_enable_wr_protection
 * 功能：去除flash写保护
 * 参数：无
@@ -133,10 +322,17 @@ int bootloader_enable_wr_protection();
 */
 int bootloader_disable_wr_protection();
 
+/*名称：bootloader_config_wr_protection
+* 功能：按写保护策略设置选项字节 和选项字节相同时不擦写 修改后复位使其生效
+* 参数：env env指针 NULL：env还没有读取 打开升级时需要写入的区域
+* 返回：0：写保护已经是策略要求的状态 其他：失败 修改成功时复位不返回
+*/
+int bootloader_config_wr_protection(const bootloader_env_t *env);
+
 /*名称：bootloader_get_env
 * 功能：获取ENV参数
 * 参数：env 环境参数指针
-* 返回：0：成功 1：成功 但是ENV参数是无效的 其他：失败
+* 返回：0：成功 其他：失败
 */
 int bootloader_get_env(bootloader_env_t *env);
 
@@ -157,6 +353,15 @@ int bootloader_save_env(bootloader_env_t *env);
 int bootloader_write_fw(uint32_t fw_dest_addr,uint32_t fw_src_addr,uint32_t size);
 
 
+/*名称：bootloader_get_image_header
+* 功能：获取固件头 检查固件头、链接地址、中断向量表和固件crc
+* 参数：image_addr 固件所在的地址
+* 参数：load_addr  固件应该链接的运行地址
+* 参数：slot_size  运行区的大小
+* 返回：固件头指针 NULL：没有有效的固件
+*/
+const bootloader_image_header_t *bootloader_get_image_header(uint32_t image_addr,uint32_t load_addr,uint32_t slot_size);
+
 /*名称：bootloader_update_user_app
 * 功能：更新用户APP
 * 参数：env  环境参数指针
@@ -171,5 +376,26 @@ int bootloader_update_user_app(bootloader_env_t *env);
 */
 int bootloader_recovery_user_app(bootloader_env_t *env);
 
+/*名称：bootloader_stat_reset
+* 功能：开始新的升级代价统计区间
+* 参数：无
+* 返回：无
+*/
+void bootloader_stat_reset();
+
+/*名称：bootloader_stat_report
+* 功能：输出统计区间内的耗时、各分区页擦除次数和env写入次数
+* 参数：name 统计的操作名称
+* 返回：无
+*/
+void bootloader_stat_report(const char *name);
+
+/*名称：bootloader_flash_bench
+* 功能：在交换区测试flash擦除和编程速度并输出 交换区没有使用时才能调用
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+int bootloader_flash_bench();
+
 
 #endif
\ No newline at end of file
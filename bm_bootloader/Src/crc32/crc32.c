@@ -0,0 +1,70 @@
+#include "crc32.h"
+
+/*4位查表 每次处理半个字节*/
+static const uint32_t crc32_table[16] = {
+0x00000000U,0x04C11DB7U,0x09823B6EU,0x0D4326D9U,
+0x130476DCU,0x17C56B6BU,0x1A864DB2U,0x1E475005U,
+0x2608EDB8U,0x22C9F00FU,0x2F8AD6D6U,0x2B4BCB61U,
+0x350C9B64U,0x31CD86D3U,0x3C8EA00AU,0x384FBDBDU
+};
+
+/*名称：crc32_update_word
+* 功能：crc计算一个字
+* 参数：crc  当前crc
+* 参数：word 输入字
+* 返回：crc结果
+*/
+static uint32_t crc32_update_word(uint32_t crc,uint32_t word)
+{
+  uint8_t i;
+  
+  crc ^= word;
+  for(i = 0; i < 8; i++){
+      crc = (crc << 4) ^ crc32_table[crc >> 28];
+  }
+  
+  return crc;
+}
+
+/*名称：crc32_update
+* 功能：在已有的crc上继续计算一段数据
+* 参数：crc    上一段的crc结果 第一段使用CRC32_INIT_VALUE
+* 参数：buffer 数据地址
+* 参数：size   数据大小 只有最后一段允许不是4的倍数 不足一个字的部分用0xFF补齐
+* 返回：crc结果
+*/
+uint32_t crc32_update(uint32_t crc,const void *buffer,uint32_t size)
+{
+  const uint8_t *pos = (const uint8_t *)buffer;
+  uint32_t word;
+  uint8_t i;
+  
+  while(size >= 4){
+     word = (uint32_t)pos[0] | (uint32_t)pos[1] << 8 | (uint32_t)pos[2] << 16 | (uint32_t)pos[3] << 24;
+     crc = crc32_update_word(crc,word);
+     pos += 4;
+     size -= 4;
+  }
+  
+  if(size > 0){
+     word = 0xFFFFFFFFU;
+     for(i = 0; i < size; i++){
+         word &= ~(0xFFU << (i * 8));
+         word |= (uint32_t)pos[i] << (i * 8);
+     }
+     crc = crc32_update_word(crc,word);
+  }
+  
+  return crc;
+}
+
+/*名称：crc32_calculate
+* 功能：计算一段数据的crc
+* 参数：buffer 数据地址
+* 参数：size   数据大小
+* 返回：crc结果
+*/
+uint32_t crc32_calculate(const void *buffer,uint32_t size)
+{
+  return crc32_update(CRC32_INIT_VALUE,buffer,size);
+}
@@ -0,0 +1,36 @@
+#ifndef  __CRC32_H__
+#define  __CRC32_H__
+#include "stdint.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*与STM32F1硬件CRC单元一致：多项式0x04C11DB7 初值0xFFFFFFFF 按32位小端字输入 不反转 无结果异或*/
+#define  CRC32_INIT_VALUE                0xFFFFFFFFU
+#define  CRC32_POLYNOMIAL                0x04C11DB7U
+
+
+/*名称：crc32_update
+* 功能：在已有的crc上继续计算一段数据
+* 参数：crc    上一段的crc结果 第一段使用CRC32_INIT_VALUE
+* 参数：buffer 数据地址
+* 参数：size   数据大小 只有最后一段允许不是4的倍数 不足一个字的部分用0xFF补齐
+* 返回：crc结果
+*/
+uint32_t crc32_update(uint32_t crc,const void *buffer,uint32_t size);
+
+/*名称：crc32_calculate
+* 功能：计算一段数据的crc
+* 参数：buffer 数据地址
+* 参数：size   数据大小
+* 返回：crc结果
+*/
+uint32_t crc32_calculate(const void *buffer,uint32_t size);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+#include "main.h"
+#include "crc32_hw.h"
+#include "log.h"
+#define  LOG_MODULE_LEVEL    LOG_LEVEL_DEBUG
+#define  LOG_MODULE_NAME     "[crc32_hw]"
+
+#define  CRC32_HW_DMA_MAX_CNT              0xFFFFU /*CNDTR最大传输数量*/
+
+#if  CRC32_HW_DMA_ENABLE > 0
+/*名称：crc32_hw_dma_transfer
+* 功能：DMA存储器到存储器方式 把flash或SRAM中的字逐个写入CRC数据寄存器 CPU等待传输完成
+* 参数：addr 数据地址
+* 参数：cnt  字数 不超过CRC32_HW_DMA_MAX_CNT
+* 返回：0：成功 其他：失败
+*/
+static int crc32_hw_dma_transfer(uint32_t addr,uint32_t cnt)
+{
+  uint32_t start;
+  uint32_t isr;
+  
+  CRC32_HW_DMA_CHANNEL->CCR = 0;
+  CRC32_HW_DMA->IFCR = CRC32_HW_DMA_FLAG_CLEAR;
+  CRC32_HW_DMA_CHANNEL->CPAR = (uint32_t)&CRC->DR;
+  CRC32_HW_DMA_CHANNEL->CMAR = addr;
+  CRC32_HW_DMA_CHANNEL->CNDTR = cnt;
+  /*存储器读 外设写 存储器地址递增 两边都是32位*/
+  CRC32_HW_DMA_CHANNEL->CCR = DMA_CCR_MEM2MEM | DMA_CCR_PL_1 | DMA_CCR_MSIZE_1 | DMA_CCR_PSIZE_1 | DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+  
+  start = HAL_GetTick();
+  do{
+     isr = CRC32_HW_DMA->ISR;
+     if(HAL_GetTick() - start > CRC32_HW_DMA_TIMEOUT){
+        break;
+     }
+  }while((isr & (CRC32_HW_DMA_FLAG_TC | CRC32_HW_DMA_FLAG_TE)) == 0);
+  
+  CRC32_HW_DMA_CHANNEL->CCR = 0;
+  CRC32_HW_DMA->IFCR = CRC32_HW_DMA_FLAG_CLEAR;
+  if((isr & CRC32_HW_DMA_FLAG_TE) != 0 || (isr & CRC32_HW_DMA_FLAG_TC) == 0){
+     log_error("dma addr:0x%X cnt:%d err.isr:0x%X.\r\n",addr,cnt,isr);
+     return -1;
+  }
+  
+  return 0;
+}
+#else
+/*名称：crc32_hw_cpu_transfer
+* 功能：CPU把字逐个写入CRC数据寄存器
+* 参数：addr 数据地址
+* 参数：cnt  字数
+* 返回：无
+*/
+static void crc32_hw_cpu_transfer(uint32_t addr,uint32_t cnt)
+{
+  const uint32_t *pos = (const uint32_t *)addr;
+  
+  while(cnt > 0){
+     CRC->DR = *pos++;
+     cnt--;
+  }
+}
+#endif
+
+/*名称：crc32_hw_reset
+* 功能：打开CRC和DMA时钟 复位CRC单元 开始新的计算
+* 参数：无
+* 返回：无
+*/
+void crc32_hw_reset(void)
+{
+  __HAL_RCC_CRC_CLK_ENABLE();
+#if  CRC32_HW_DMA_ENABLE > 0
+  __HAL_RCC_DMA1_CLK_ENABLE();
+#endif
+  CRC->CR = CRC_CR_RESET;
+}
+
+/*名称：crc32_hw_update
+* 功能：把一段数据送入CRC单元继续计算
+* 参数：buffer 数据地址 必须按4字节对齐
+* 参数：size   数据大小 只有最后一段允许不是4的倍数 不足一个字的部分用0xFF补齐
+* 返回：0：成功 其他：失败 失败后需要重新计算
+*/
+int crc32_hw_update(const void *buffer,uint32_t size)
+{
+  uint32_t addr = (uint32_t)buffer;
+  uint32_t cnt,word;
+  uint8_t i;
+  
+  if((addr & 3) != 0){
+     log_error("addr:0x%X not aligned.\r\n",addr);
+     return -1;
+  }
+  
+  while(size >= 4){
+     cnt = size / 4;
+#if  CRC32_HW_DMA_ENABLE > 0
+     if(cnt > CRC32_HW_DMA_MAX_CNT){
+        cnt = CRC32_HW_DMA_MAX_CNT;
+     }
+     if(crc32_hw_dma_transfer(addr,cnt) != 0){
+        return -1;
+     }
+#else
+     crc32_hw_cpu_transfer(addr,cnt);
+#endif
+     addr += cnt * 4;
+     size -= cnt * 4;
+  }
+  
+  if(size > 0){
+     word = 0xFFFFFFFFU;
+     for(i = 0; i < size; i++){
+         word &= ~(0xFFU << (i * 8));
+         word |= (uint32_t)((const uint8_t *)addr)[i] << (i * 8);
+     }
+     CRC->DR = word;
+  }
+  
+  return 0;
+}
+
+/*名称：crc32_hw_value
+* 功能：获取当前crc结果
+* 参数：无
+* 返回：crc结果
+*/
+uint32_t crc32_hw_value(void)
+{
+  return CRC->DR;
+}
+
+/*名称：crc32_hw_deinit
+* 功能：关闭DMA通道 关闭CRC和DMA时钟 跳转到应用程序前调用
+* 参数：无
+* 返回：无
+*/
+void crc32_hw_deinit(void)
+{
+#if  CRC32_HW_DMA_ENABLE > 0
+  CRC32_HW_DMA_CHANNEL->CCR = 0;
+  CRC32_HW_DMA->IFCR = CRC32_HW_DMA_FLAG_CLEAR;
+  __HAL_RCC_DMA1_CLK_DISABLE();
+#endif
+  __HAL_RCC_CRC_CLK_DISABLE();
+}
@@ -0,0 +1,51 @@
+#ifndef  __CRC32_HW_H__
+#define  __CRC32_HW_H__
+#include "stm32f1xx_hal.h"
+
+/******************************************************************************/
+/*    配置开始                                                                */
+/******************************************************************************/
+#define  CRC32_HW_DMA_ENABLE                     1     /*DMA把数据送入CRC单元 关闭时CPU逐字写入*/
+#define  CRC32_HW_DMA                            DMA1
+#define  CRC32_HW_DMA_CHANNEL                    DMA1_Channel1
+#define  CRC32_HW_DMA_FLAG_TC                    DMA_ISR_TCIF1
+#define  CRC32_HW_DMA_FLAG_TE                    DMA_ISR_TEIF1
+#define  CRC32_HW_DMA_FLAG_CLEAR                 DMA_IFCR_CGIF1
+#define  CRC32_HW_DMA_TIMEOUT                    100   /*一次DMA传输的超时 单位：ms*/
+/******************************************************************************/
+/*    配置结束                                                                */
+/******************************************************************************/
+
+/*结果与crc32.h中的crc32_update一致 软件可以用crc32_update(crc32_hw_value(),...)接着计算*/
+
+/*名称：crc32_hw_reset
+* 功能：打开CRC和DMA时钟 复位CRC单元 开始新的计算
+* 参数：无
+* 返回：无
+*/
+void crc32_hw_reset(void);
+
+/*名称：crc32_hw_update
+* 功能：把一段数据送入CRC单元继续计算
+* 参数：buffer 数据地址 必须按4字节对齐
+* 参数：size   数据大小 只有最后一段允许不是4的倍数 不足一个字的部分用0xFF补齐
+* 返回：0：成功 其他：失败 失败后需要重新计算
+*/
+int crc32_hw_update(const void *buffer,uint32_t size);
+
+/*名称：crc32_hw_value
+* 功能：获取当前crc结果
+* 参数：无
+* 返回：crc结果
+*/
+uint32_t crc32_hw_value(void);
+
+/*名称：crc32_hw_deinit
+* 功能：关闭DMA通道 关闭CRC和DMA时钟 跳转到应用程序前调用
+* 参数：无
+* 返回：无
+*/
+void crc32_hw_deinit(void);
+
+
+#endif
@@ -87,6 +87,55 @@ uint32_t log_read(char *dst,uint32_t size)
 }
 
 
+/*
+* @brief 还没有输出的日志
+* @param 无
+* @return 还没有被读取或者发送的字节数
+* @note RTT由调试器读取 没有连接调试器时不会减少
+*/
+
+uint32_t log_pending(void)
+{
+    int pending = 0;
+#if    LOG_USE_RTT > 0
+    pending = SEGGER_RTT_HasDataUp(0);
+#elif  LOG_USE_SERIAL > 0
+    pending = log_serial_uart_pending();
+#endif
+    return pending > 0 ? pending : 0;
+}
+
+
+/*
+* @brief 每个等级的日志前缀
+*/
+static const char *const log_prefix_format[LOG_LEVEL_LOWEST + 1] = {
+    "",
+    LOG_ERROR_PREFIX_FORMAT,
+    LOG_WARNING_PREFIX_FORMAT,
+    LOG_INFO_PREFIX_FORMAT,
+    LOG_DEBUG_PREFIX_FORMAT,
+    LOG_ARRAY_PREFIX_FORMAT
+};
+
+/*
+* @brief 输出格式化好的日志
+* @param buffer 日志
+* @param size 日志长度
+* @return 实际写入的数量
+* @note
+*/
+static int log_write(const char *buffer,uint32_t size)
+{
+    int rc = 0;
+#if    LOG_USE_RTT > 0
+    rc = SEGGER_RTT_Write(0,buffer,size);
+#elif  LOG_USE_SERIAL > 0
+    rc = log_serial_uart_write(buffer,size);
+#endif
+    return rc;
+}
+
 /*
 * @brief 终端日志输出
  @param level 输出等级
@@ -112,12 +161,48 @@ int log_vnprintf(uint8_t level,const char *format,...)
             rc = -1;
             goto exit;
         }
-#if    LOG_USE_RTT > 0
-        rc = SEGGER_RTT_Write(0,buffer,size);
-#elif  LOG_USE_SERIAL > 0
-        rc = log_serial_uart_write(buffer,size);
-#endif
+        rc = log_write(buffer,size);
+    }
+exit:
+    va_end(ap);
+    return rc;
+}
+
+/*
+* @brief 终端日志输出 带时间、文件名和行号的前缀
+* @param level 输出等级 同时选择前缀
+* @param file 文件名
+* @param line 行号
+* @param format 格式化字符串
+* @param ... 可变参数列表
+* @return 实际写入的数量
+* @note 前缀格式只保存一份 不和每条日志的格式化字符串拼接
+*/
+int log_printf(uint8_t level,const char *file,int line,const char *format,...)
+{
+    int rc = 0;
+    uint32_t size,cnt;
+    char buffer[LOG_PRINTF_BUFFER_SIZE];
+    va_list ap;
+
+    if (level > log_level_globle) {
+        return 0;
+    }
+    
+    va_start(ap,format);
+
+    size = snprintf(buffer,LOG_PRINTF_BUFFER_SIZE,log_prefix_format[level],LOG_TIME_VALUE,file,line);
+    /*保证输出是完整的*/
+    if (size > LOG_PRINTF_BUFFER_SIZE - 1) {
+        rc = -1;
+        goto exit;
+    }
+    cnt = vsnprintf(buffer + size,LOG_PRINTF_BUFFER_SIZE - size,format,ap);
+    if (cnt > LOG_PRINTF_BUFFER_SIZE - 1 - size) {
+        rc = -1;
+        goto exit;
     }
+    rc = log_write(buffer,size + cnt);
 exit:
     va_end(ap);
     return rc;
@@ -32,6 +32,9 @@
 /******************************************************************************/
 #define  LOG_PRINTF_BUFFER_SIZE    256
 #define  LOG_LEVEL_GLOBLE_DEFAULT  LOG_LEVEL_DEBUG 
+#ifndef  LOG_LEVEL_COMPILE
+#define  LOG_LEVEL_COMPILE         LOG_LEVEL_OFF   /*高于这个等级的日志不编译进固件 bootloader限制在24k以内 调试时提高等级可能需要关闭其他功能*/
+#endif
 #define  LOG_USE_RTT               1
 #define  LOG_USE_SERIAL            0
 #define  LOG_USE_COLORS            1
@@ -82,8 +85,6 @@
 #define LOG_DEBUG_PREFIX_FORMAT       "\r\n"LOG_DEBUG_COLOR   LOG_TIME_FORMAT   "[debug]"   LOG_FILE_NAME_FORMAT LOG_LINE_NUM_FORMAT "\r\n"
 #define LOG_ARRAY_PREFIX_FORMAT       "\r\n"LOG_ARRAY_COLOR   LOG_TIME_FORMAT   "[array]"   LOG_FILE_NAME_FORMAT LOG_LINE_NUM_FORMAT "\r\n"
 
-#define LOG_PREFIX_VALUE              LOG_TIME_VALUE,__FILE__,__LINE__ 
-
 
 /*
 * @brief 终端日志初始化
@@ -113,6 +114,14 @@ uint32_t log_time(void);
 
 uint32_t log_read(char *dst,uint32_t size);
 
+/*
+* @brief 还没有输出的日志
+* @param 无
+* @return 还没有被读取或者发送的字节数
+* @note RTT由调试器读取 没有连接调试器时不会减少
+*/
+uint32_t log_pending(void);
+
 /*
 * @brief 设置日志全局输出等级
 * @param lelvel 日志等级
@@ -132,6 +141,18 @@ int log_set_level(uint8_t level);
 */
 int log_vnprintf(uint8_t level,const char *format,...);
 
+/*
+* @brief 终端日志输出 带时间、文件名和行号的前缀
+* @param level 输出等级 同时选择前缀
+* @param file 文件名
+* @param line 行号
+* @param format 格式化字符串
+* @param ... 可变参数列表
+* @return 实际写入的数量
+* @note 前缀格式只保存一份 不和每条日志的格式化字符串拼接
+*/
+int log_printf(uint8_t level,const char *file,int line,const char *format,...);
+
 /*
 * @brief 日志array输出
 * @param format格式化字符串
@@ -141,7 +162,9 @@ int log_vnprintf(uint8_t level,const char *format,...);
 */
 #define  log_array(format,arg...)                                                           \
 {                                                                                           \
-   log_vnprintf(LOG_LEVEL_ARRAY,LOG_ARRAY_PREFIX_FORMAT format,LOG_PREFIX_VALUE,##arg);     \
+   if (LOG_LEVEL_ARRAY <= LOG_LEVEL_COMPILE) {                                              \
+      log_printf(LOG_LEVEL_ARRAY,__FILE__,__LINE__,format,##arg);                           \
+   }                                                                                        \
 }
 
 /*
@@ -153,7 +176,9 @@ int log_vnprintf(uint8_t level,const char *format,...);
 */
 #define  log_debug(format,arg...)                                                           \
 {                                                                                           \
-   log_vnprintf(LOG_LEVEL_DEBUG,LOG_DEBUG_PREFIX_FORMAT format,LOG_PREFIX_VALUE,##arg);     \
+   if (LOG_LEVEL_DEBUG <= LOG_LEVEL_COMPILE) {                                              \
+      log_printf(LOG_LEVEL_DEBUG,__FILE__,__LINE__,format,##arg);                           \
+   }                                                                                        \
 }
 
 /*
@@ -165,7 +190,9 @@ int log_vnprintf(uint8_t level,const char *format,...);
 */
 #define  log_info(format,arg...)                                                            \
 {                                                                                           \
-   log_vnprintf(LOG_LEVEL_INFO,LOG_INFO_PREFIX_FORMAT format,LOG_PREFIX_VALUE,##arg);       \
+   if (LOG_LEVEL_INFO <= LOG_LEVEL_COMPILE) {                                               \
+      log_printf(LOG_LEVEL_INFO,__FILE__,__LINE__,format,##arg);                            \
+   }                                                                                        \
 }
 
 /*
@@ -177,7 +204,9 @@ int log_vnprintf(uint8_t level,const char *format,...);
 */
 #define  log_warning(format,arg...)                                                        \
 {                                                                                          \
-   log_vnprintf(LOG_LEVEL_WARNING,LOG_WARNING_PREFIX_FORMAT format,LOG_PREFIX_VALUE,##arg);\
+   if (LOG_LEVEL_WARNING <= LOG_LEVEL_COMPILE) {                                            \
+      log_printf(LOG_LEVEL_WARNING,__FILE__,__LINE__,format,##arg);                         \
+   }                                                                                        \
 }
 
 /*
@@ -189,7 +218,9 @@ int log_vnprintf(uint8_t level,const char *format,...);
 */
 #define  log_error(format,arg...)                                                           \
 {                                                                                           \
-   log_vnprintf(LOG_LEVEL_ERROR,LOG_ERROR_PREFIX_FORMAT format,LOG_PREFIX_VALUE,##arg);     \
+   if (LOG_LEVEL_ERROR <= LOG_LEVEL_COMPILE) {                                              \
+      log_printf(LOG_LEVEL_ERROR,__FILE__,__LINE__,format,##arg);                           \
+   }                                                                                        \
 }
 
 /*
@@ -86,6 +86,18 @@ int log_serial_uart_write(char *src,uint32_t size)
     return serial_write(log_serial_uart_handle,src,size);
 }
 
+/*
+* @brief 串口uart没有发送完的数据
+* @param 无
+* @return  没有发送完的数量
+* @note
+*/
+
+int log_serial_uart_pending(void)
+{
+    return serial_complete(log_serial_uart_handle,0);
+}
+
 
 
 
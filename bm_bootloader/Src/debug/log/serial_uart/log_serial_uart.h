@@ -62,6 +62,15 @@ int log_serial_uart_read(char *dst,uint32_t size);
 
 int log_serial_uart_write(char *src,uint32_t size);
 
+/*
+* @brief 串口uart没有发送完的数据
+* @param 无
+* @return  没有发送完的数量
+* @note
+*/
+
+int log_serial_uart_pending(void);
+
 
 #ifdef  __cplusplus
     }
@@ -0,0 +1,164 @@
+#include "string.h"
+#include "delta.h"
+
+typedef struct
+{
+const uint8_t *pos;
+const uint8_t *end;
+}delta_stream_t;
+
+typedef struct
+{
+uint8_t      *buffer;
+uint32_t      buffer_size;
+uint32_t      used;       /*缓存中的数据量*/
+uint32_t      offset;     /*缓存数据在新固件中的偏移*/
+delta_write_t write;
+}delta_output_t;
+
+
+/*名称：delta_read_varint
+* 功能：从补丁流中读取一个变长整数
+* 参数：stream 补丁流
+* 参数：value  读取的值
+* 返回：0：成功 其他：失败
+*/
+static int delta_read_varint(delta_stream_t *stream,uint32_t *value)
+{
+  uint8_t byte;
+  uint8_t shift = 0;
+  
+  *value = 0;
+  do{
+     if(stream->pos >= stream->end || shift > 28){
+        return -1;
+     }
+     byte = *stream->pos++;
+     *value |= (uint32_t)(byte & 0x7F) << shift;
+     shift += 7;
+  }while(byte & 0x80);
+  
+  return 0;
+}
+
+/*名称：delta_output
+* 功能：向输出缓存写入数据 缓存满时输出
+* 参数：output 输出
+* 参数：src    数据地址
+* 参数：size   数据大小
+* 返回：0：成功 其他：失败
+*/
+static int delta_output(delta_output_t *output,const uint8_t *src,uint32_t size)
+{
+  uint32_t copy_size;
+  
+  while(size > 0){
+     copy_size = output->buffer_size - output->used;
+     if(copy_size > size){
+        copy_size = size;
+     }
+     memcpy(output->buffer + output->used,src,copy_size);
+     output->used += copy_size;
+     src += copy_size;
+     size -= copy_size;
+     
+     if(output->used == output->buffer_size){
+        if(output->write(output->offset,output->buffer,output->used) != 0){
+           return -1;
+        }
+        output->offset += output->used;
+        output->used = 0;
+     }
+  }
+  
+  return 0;
+}
+
+/*名称：delta_get_header
+* 功能：读取并检查补丁头
+* 参数：patch      补丁地址
+* 参数：patch_size 补丁大小
+* 参数：header     补丁头指针
+* 返回：0：成功 其他：不是有效的补丁
+*/
+int delta_get_header(const uint8_t *patch,uint32_t patch_size,delta_header_t *header)
+{
+  if(patch_size < sizeof(delta_header_t)){
+     return -1;
+  }
+  memcpy(header,patch,sizeof(delta_header_t));
+  if(header->magic != DELTA_MAGIC || header->version != DELTA_VERSION){
+     return -1;
+  }
+  
+  return 0;
+}
+
+/*名称：delta_apply
+* 功能：根据原固件和补丁生成新固件 输出数据先写入缓存，缓存满后调用write输出
+* 参数：patch       补丁地址
+* 参数：patch_size  补丁大小
+* 参数：old         原固件地址
+* 参数：old_size    原固件大小
+* 参数：buffer      输出缓存
+* 参数：buffer_size 输出缓存大小 除最后一次外每次输出的大小
+* 参数：write       输出函数
+* 返回：0：成功 其他：失败
+*/
+int delta_apply(const uint8_t *patch,uint32_t patch_size,const uint8_t *old,uint32_t old_size,uint8_t *buffer,uint32_t buffer_size,delta_write_t write)
+{
+  delta_header_t header;
+  delta_stream_t stream;
+  delta_output_t output;
+  uint32_t cmd,offset,size,new_size = 0;
+  
+  if(delta_get_header(patch,patch_size,&header) != 0 || header.old_size != old_size){
+     return -1;
+  }
+  stream.pos = patch + sizeof(delta_header_t);
+  stream.end = patch + patch_size;
+  output.buffer = buffer;
+  output.buffer_size = buffer_size;
+  output.used = 0;
+  output.offset = 0;
+  output.write = write;
+
+  while(stream.pos < stream.end){
+     cmd = *stream.pos++;
+     if(cmd == DELTA_CMD_COPY){
+        if(delta_read_varint(&stream,&offset) != 0 || delta_read_varint(&stream,&size) != 0){
+           return -1;
+        }
+        if(offset > old_size || size > old_size - offset){
+           return -1;
+        }
+        if(size > header.new_size - new_size || delta_output(&output,old + offset,size) != 0){
+           return -1;
+        }
+     }else if(cmd == DELTA_CMD_DATA){
+        if(delta_read_varint(&stream,&size) != 0 || size > (uint32_t)(stream.end - stream.pos)){
+           return -1;
+        }
+        if(size > header.new_size - new_size || delta_output(&output,stream.pos,size) != 0){
+           return -1;
+        }
+        stream.pos += size;
+     }else{
+        return -1;
+     }
+     new_size += size;
+  }
+  
+  if(new_size != header.new_size){
+     return -1;
+  }
+  /*输出剩余数据 缓存剩余部分补0xFF*/
+  if(output.used > 0){
+     memset(output.buffer + output.used,0xFF,output.buffer_size - output.used);
+     if(write(output.offset,output.buffer,output.used) != 0){
+        return -1;
+     }
+  }
+  
+  return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef  __DELTA_H__
+#define  __DELTA_H__
+#include "stdint.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*补丁格式：delta_header_t + 命令流
+* DELTA_CMD_COPY varint(原固件偏移) varint(长度)       从原固件复制
+* DELTA_CMD_DATA varint(长度) 数据                     直接写入补丁中的数据
+* varint为7位一组的小端变长整数，最高位为1表示后面还有字节
+*/
+#define  DELTA_MAGIC                     0x50444D42U /*"BMDP"*/
+#define  DELTA_VERSION                   1U
+
+#define  DELTA_CMD_COPY                  0x01U
+#define  DELTA_CMD_DATA                  0x02U
+
+typedef struct
+{
+uint32_t magic;      /*DELTA_MAGIC*/
+uint32_t version;    /*补丁格式版本*/
+uint32_t old_size;   /*原固件大小*/
+uint32_t old_crc;    /*原固件crc32*/
+uint32_t new_size;   /*新固件大小*/
+uint32_t new_crc;    /*新固件crc32*/
+uint32_t patch_crc;  /*补丁头之后命令流的crc32*/
+}delta_header_t;
+
+/*名称：delta_write_t
+* 功能：输出新固件数据
+* 参数：offset 数据在新固件中的偏移
+* 参数：buffer 数据地址
+* 参数：size   数据大小
+* 返回：0：成功 其他：失败
+*/
+typedef int (*delta_write_t)(uint32_t offset,const uint8_t *buffer,uint32_t size);
+
+
+/*名称：delta_get_header
+* 功能：读取并检查补丁头
+* 参数：patch      补丁地址
+* 参数：patch_size 补丁大小
+* 参数：header     补丁头指针
+* 返回：0：成功 其他：不是有效的补丁
+*/
+int delta_get_header(const uint8_t *patch,uint32_t patch_size,delta_header_t *header);
+
+/*名称：delta_apply
+* 功能：根据原固件和补丁生成新固件 输出数据先写入缓存，缓存满后调用write输出
+* 参数：patch       补丁地址
+* 参数：patch_size  补丁大小
+* 参数：old         原固件地址
+* 参数：old_size    原固件大小
+* 参数：buffer      输出缓存
+* 参数：buffer_size 输出缓存大小 除最后一次外每次输出的大小
+* 参数：write       输出函数
+* 返回：0：成功 其他：失败
+*/
+int delta_apply(const uint8_t *patch,uint32_t patch_size,const uint8_t *old,uint32_t old_size,uint8_t *buffer,uint32_t buffer_size,delta_write_t write);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
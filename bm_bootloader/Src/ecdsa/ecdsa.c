@@ -0,0 +1,411 @@
+#include "string.h"
+#include "ecdsa.h"
+
+/*256位整数用8个32位字表示 低位在前*/
+#define  ECDSA_WORDS                     8
+
+/*雅可比坐标的点 坐标是蒙哥马利形式 z为0表示无穷远点*/
+typedef struct
+{
+uint32_t x[ECDSA_WORDS];
+uint32_t y[ECDSA_WORDS];
+uint32_t z[ECDSA_WORDS];
+}ecdsa_point_t;
+
+typedef struct
+{
+const uint32_t *m;          /*模数*/
+uint32_t        minv;       /*-m^-1 mod 2^32*/
+const uint32_t *r2;         /*2^512 mod m 转换成蒙哥马利形式用*/
+}ecdsa_mod_t;
+
+/*素数域 p = 2^256 - 2^224 + 2^192 + 2^96 - 1*/
+static const uint32_t p256_p[ECDSA_WORDS] = {0xFFFFFFFFU,0xFFFFFFFFU,0xFFFFFFFFU,0x00000000U,0x00000000U,0x00000000U,0x00000001U,0xFFFFFFFFU};
+static const uint32_t p256_p_r2[ECDSA_WORDS] = {0x00000003U,0x00000000U,0xFFFFFFFFU,0xFFFFFFFBU,0xFFFFFFFEU,0xFFFFFFFFU,0xFFFFFFFDU,0x00000004U};
+/*基点的阶*/
+static const uint32_t p256_n[ECDSA_WORDS] = {0xFC632551U,0xF3B9CAC2U,0xA7179E84U,0xBCE6FAADU,0xFFFFFFFFU,0xFFFFFFFFU,0x00000000U,0xFFFFFFFFU};
+static const uint32_t p256_n_r2[ECDSA_WORDS] = {0xBE79EEA2U,0x83244C95U,0x49BD6FA6U,0x4699799CU,0x2B6BEC59U,0x2845B239U,0xF3D95620U,0x66E12D94U};
+/*曲线参数b和基点 蒙哥马利形式*/
+static const uint32_t p256_b[ECDSA_WORDS] = {0x29C4BDDFU,0xD89CDF62U,0x78843090U,0xACF005CDU,0xF7212ED6U,0xE5A220ABU,0x04874834U,0xDC30061DU};
+static const uint32_t p256_gx[ECDSA_WORDS] = {0x18A9143CU,0x79E730D4U,0x5FEDB601U,0x75BA95FCU,0x77622510U,0x79FB732BU,0xA53755C6U,0x18905F76U};
+static const uint32_t p256_gy[ECDSA_WORDS] = {0xCE95560AU,0xDDF25357U,0xBA19E45CU,0x8B4AB8E4U,0xDD21F325U,0xD2E88688U,0x25885D85U,0x8571FF18U};
+
+static const ecdsa_mod_t mod_p = {p256_p,0x00000001U,p256_p_r2};
+static const ecdsa_mod_t mod_n = {p256_n,0xEE00BC4FU,p256_n_r2};
+
+/*点运算的工作区 栈只有1k 放在静态区*/
+static ecdsa_point_t table[4];/*0 G Q G+Q*/
+static ecdsa_point_t result;
+/*验签比较耗时 每一位调用一次*/
+static ecdsa_idle_hook_t idle_hook;
+
+/*名称：bn_add
+* 功能：r = a + b
+* 返回：进位
+*/
+static uint32_t bn_add(uint32_t *r,const uint32_t *a,const uint32_t *b)
+{
+  uint64_t c = 0;
+  uint8_t i;
+  
+  for(i = 0; i < ECDSA_WORDS; i++){
+     c += (uint64_t)a[i] + b[i];
+     r[i] = (uint32_t)c;
+     c >>= 32;
+  }
+  
+  return (uint32_t)c;
+}
+
+/*名称：bn_sub
+* 功能：r = a - b
+* 返回：借位
+*/
+static uint32_t bn_sub(uint32_t *r,const uint32_t *a,const uint32_t *b)
+{
+  uint64_t t;
+  uint32_t borrow = 0;
+  uint8_t i;
+  
+  for(i = 0; i < ECDSA_WORDS; i++){
+     t = (uint64_t)a[i] - b[i] - borrow;
+     r[i] = (uint32_t)t;
+     borrow = (uint32_t)(t >> 32) & 1;
+  }
+  
+  return borrow;
+}
+
+/*名称：bn_cmp
+* 功能：比较a和b
+* 返回：1：a > b 0：相等 -1：a < b
+*/
+static int bn_cmp(const uint32_t *a,const uint32_t *b)
+{
+  int8_t i;
+  
+  for(i = ECDSA_WORDS - 1; i >= 0; i--){
+     if(a[i] != b[i]){
+        return a[i] > b[i] ? 1 : -1;
+     }
+  }
+  
+  return 0;
+}
+
+static int bn_is_zero(const uint32_t *a)
+{
+  uint32_t acc = 0;
+  uint8_t i;
+  
+  for(i = 0; i < ECDSA_WORDS; i++){
+     acc |= a[i];
+  }
+  
+  return acc == 0;
+}
+
+/*名称：bn_from_bytes
+* 功能：32字节大端数转换成整数
+*/
+static void bn_from_bytes(uint32_t *r,const uint8_t *bytes)
+{
+  uint8_t i;
+  const uint8_t *pos;
+  
+  for(i = 0; i < ECDSA_WORDS; i++){
+     pos = bytes + (ECDSA_WORDS - 1 - i) * 4;
+     r[i] = (uint32_t)pos[0] << 24 | (uint32_t)pos[1] << 16 | (uint32_t)pos[2] << 8 | (uint32_t)pos[3];
+  }
+}
+
+static void mod_add(uint32_t *r,const uint32_t *a,const uint32_t *b,const ecdsa_mod_t *mod)
+{
+  if(bn_add(r,a,b) != 0 || bn_cmp(r,mod->m) >= 0){
+     bn_sub(r,r,mod->m);
+  }
+}
+
+static void mod_sub(uint32_t *r,const uint32_t *a,const uint32_t *b,const ecdsa_mod_t *mod)
+{
+  if(bn_sub(r,a,b) != 0){
+     bn_add(r,r,mod->m);
+  }
+}
+
+/*名称：mod_mul
+* 功能：蒙哥马利乘法 r = a * b / 2^256 mod m 逐字乘加后逐字约减(CIOS)
+* 32x32位乘累加在Cortex-M3上编译为UMULL/UMLAL
+* 参数：a b 小于m
+*/
+static void mod_mul(uint32_t *r,const uint32_t *a,const uint32_t *b,const ecdsa_mod_t *mod)
+{
+  uint32_t t[ECDSA_WORDS + 2];
+  uint64_t c;
+  uint32_t q;
+  uint8_t i,j;
+  
+  memset(t,0,sizeof(t));
+  for(i = 0; i < ECDSA_WORDS; i++){
+     c = 0;
+     for(j = 0; j < ECDSA_WORDS; j++){
+        c += (uint64_t)a[j] * b[i] + t[j];
+        t[j] = (uint32_t)c;
+        c >>= 32;
+     }
+     c += t[ECDSA_WORDS];
+     t[ECDSA_WORDS] = (uint32_t)c;
+     t[ECDSA_WORDS + 1] = (uint32_t)(c >> 32);
+     
+     q = t[0] * mod->minv;
+     c = ((uint64_t)q * mod->m[0] + t[0]) >> 32;
+     for(j = 1; j < ECDSA_WORDS; j++){
+        c += (uint64_t)q * mod->m[j] + t[j];
+        t[j - 1] = (uint32_t)c;
+        c >>= 32;
+     }
+     c += t[ECDSA_WORDS];
+     t[ECDSA_WORDS - 1] = (uint32_t)c;
+     t[ECDSA_WORDS] = t[ECDSA_WORDS + 1] + (uint32_t)(c >> 32);
+  }
+  
+  if(t[ECDSA_WORDS] != 0 || bn_cmp(t,mod->m) >= 0){
+     bn_sub(t,t,mod->m);
+  }
+  memcpy(r,t,ECDSA_WORDS * 4);
+}
+
+/*名称：mod_inv
+* 功能：费马小定理求逆 r = a^(m-2) 输入输出都是蒙哥马利形式
+*/
+static void mod_inv(uint32_t *r,const uint32_t *a,const ecdsa_mod_t *mod)
+{
+  uint32_t e[ECDSA_WORDS];
+  uint32_t x[ECDSA_WORDS];
+  int16_t bit;
+  
+  memcpy(e,mod->m,sizeof(e));
+  e[0] -= 2;
+  /*蒙哥马利形式的1 = 2^256 - m*/
+  memset(x,0,sizeof(x));
+  bn_sub(x,x,mod->m);
+  for(bit = ECDSA_WORDS * 32 - 1; bit >= 0; bit--){
+     mod_mul(x,x,x,mod);
+     if((e[bit / 32] >> (bit % 32)) & 1){
+        mod_mul(x,x,a,mod);
+     }
+  }
+  memcpy(r,x,sizeof(x));
+}
+
+/*名称：point_double
+* 功能：r = 2 * a 雅可比坐标 曲线参数a = -3 (dbl-2001-b) r可以和a相同
+*/
+static void point_double(ecdsa_point_t *r,const ecdsa_point_t *a)
+{
+  uint32_t delta[ECDSA_WORDS],gamma[ECDSA_WORDS],beta[ECDSA_WORDS],alpha[ECDSA_WORDS];
+  
+  mod_mul(delta,a->z,a->z,&mod_p);
+  mod_mul(gamma,a->y,a->y,&mod_p);
+  mod_mul(beta,a->x,gamma,&mod_p);
+  /*alpha = 3 * (x - delta) * (x + delta)*/
+  mod_sub(alpha,a->x,delta,&mod_p);
+  mod_add(r->x,a->x,delta,&mod_p);
+  mod_mul(alpha,alpha,r->x,&mod_p);
+  mod_add(r->x,alpha,alpha,&mod_p);
+  mod_add(alpha,r->x,alpha,&mod_p);
+  /*z = (y + z)^2 - gamma - delta*/
+  mod_add(r->z,a->y,a->z,&mod_p);
+  mod_mul(r->z,r->z,r->z,&mod_p);
+  mod_sub(r->z,r->z,gamma,&mod_p);
+  mod_sub(r->z,r->z,delta,&mod_p);
+  /*x = alpha^2 - 8 * beta*/
+  mod_add(beta,beta,beta,&mod_p);
+  mod_add(beta,beta,beta,&mod_p);
+  mod_mul(r->x,alpha,alpha,&mod_p);
+  mod_sub(r->x,r->x,beta,&mod_p);
+  mod_sub(r->x,r->x,beta,&mod_p);
+  /*y = alpha * (4 * beta - x) - 8 * gamma^2*/
+  mod_sub(beta,beta,r->x,&mod_p);
+  mod_mul(gamma,gamma,gamma,&mod_p);
+  mod_add(gamma,gamma,gamma,&mod_p);
+  mod_add(gamma,gamma,gamma,&mod_p);
+  mod_add(gamma,gamma,gamma,&mod_p);
+  mod_mul(r->y,alpha,beta,&mod_p);
+  mod_sub(r->y,r->y,gamma,&mod_p);
+}
+
+/*名称：point_add
+* 功能：r = r + a 雅可比坐标 (add-1998-cmo-2) 处理无穷远点和相同的点
+*/
+static void point_add(ecdsa_point_t *r,const ecdsa_point_t *a)
+{
+  uint32_t u1[ECDSA_WORDS],u2[ECDSA_WORDS],s1[ECDSA_WORDS],s2[ECDSA_WORDS],t[ECDSA_WORDS];
+  
+  if(bn_is_zero(a->z)){
+     return;
+  }
+  if(bn_is_zero(r->z)){
+     *r = *a;
+     return;
+  }
+  
+  /*u1 = x1 * z2^2  u2 = x2 * z1^2  s1 = y1 * z2^3  s2 = y2 * z1^3*/
+  mod_mul(t,a->z,a->z,&mod_p);
+  mod_mul(u1,r->x,t,&mod_p);
+  mod_mul(t,t,a->z,&mod_p);
+  mod_mul(s1,r->y,t,&mod_p);
+  mod_mul(t,r->z,r->z,&mod_p);
+  mod_mul(u2,a->x,t,&mod_p);
+  mod_mul(t,t,r->z,&mod_p);
+  mod_mul(s2,a->y,t,&mod_p);
+  
+  /*h = u2 - u1  rr = s2 - s1*/
+  mod_sub(u2,u2,u1,&mod_p);
+  mod_sub(s2,s2,s1,&mod_p);
+  if(bn_is_zero(u2)){
+     if(bn_is_zero(s2)){
+        point_double(r,r);
+     }else{
+        memset(r,0,sizeof(*r));
+     }
+     return;
+  }
+  
+  /*z3 = z1 * z2 * h*/
+  mod_mul(r->z,r->z,a->z,&mod_p);
+  mod_mul(r->z,r->z,u2,&mod_p);
+  /*v = u1 * h^2  hhh = h^3*/
+  mod_mul(t,u2,u2,&mod_p);
+  mod_mul(u1,u1,t,&mod_p);
+  mod_mul(u2,u2,t,&mod_p);
+  /*x3 = rr^2 - hhh - 2 * v*/
+  mod_mul(r->x,s2,s2,&mod_p);
+  mod_sub(r->x,r->x,u2,&mod_p);
+  mod_sub(r->x,r->x,u1,&mod_p);
+  mod_sub(r->x,r->x,u1,&mod_p);
+  /*y3 = rr * (v - x3) - s1 * hhh*/
+  mod_sub(u1,u1,r->x,&mod_p);
+  mod_mul(u1,u1,s2,&mod_p);
+  mod_mul(s1,s1,u2,&mod_p);
+  mod_sub(r->y,u1,s1,&mod_p);
+}
+
+/*名称：point_set_affine
+* 功能：用仿射坐标设置点 z = 1
+* 参数：x y 蒙哥马利形式
+*/
+static void point_set_affine(ecdsa_point_t *r,const uint32_t *x,const uint32_t *y)
+{
+  memcpy(r->x,x,sizeof(r->x));
+  memcpy(r->y,y,sizeof(r->y));
+  /*蒙哥马利形式的1 = 2^256 - p*/
+  memset(r->z,0,sizeof(r->z));
+  bn_sub(r->z,r->z,p256_p);
+}
+
+/*名称：point_is_on_curve
+* 功能：检查仿射坐标的点是否满足 y^2 = x^3 - 3x + b
+* 参数：x y 蒙哥马利形式
+*/
+static int point_is_on_curve(const uint32_t *x,const uint32_t *y)
+{
+  uint32_t left[ECDSA_WORDS],right[ECDSA_WORDS];
+  
+  mod_mul(left,y,y,&mod_p);
+  mod_mul(right,x,x,&mod_p);
+  mod_mul(right,right,x,&mod_p);
+  mod_sub(right,right,x,&mod_p);
+  mod_sub(right,right,x,&mod_p);
+  mod_sub(right,right,x,&mod_p);
+  mod_add(right,right,p256_b,&mod_p);
+  
+  return bn_cmp(left,right) == 0;
+}
+
+/*名称：ecdsa_p256_verify
+* 功能：NIST P-256曲线ECDSA验签 只用公钥运算 不需要防侧信道
+* 参数：public_key 公钥
+* 参数：digest     被签名数据的sha256摘要
+* 参数：signature  签名
+* 返回：0：签名正确 其他：失败
+*/
+int ecdsa_p256_verify(const uint8_t *public_key,const uint8_t *digest,const uint8_t *signature)
+{
+  uint32_t r[ECDSA_WORDS],s[ECDSA_WORDS],e[ECDSA_WORDS];
+  uint32_t u1[ECDSA_WORDS],u2[ECDSA_WORDS];
+  uint32_t x[ECDSA_WORDS],y[ECDSA_WORDS];
+  uint8_t idx;
+  int16_t bit;
+  
+  /*1 <= r,s < n*/
+  bn_from_bytes(r,signature);
+  bn_from_bytes(s,signature + 32);
+  if(bn_is_zero(r) || bn_is_zero(s) || bn_cmp(r,p256_n) >= 0 || bn_cmp(s,p256_n) >= 0){
+     return -1;
+  }
+  
+  /*公钥必须在曲线上*/
+  bn_from_bytes(x,public_key);
+  bn_from_bytes(y,public_key + 32);
+  if(bn_cmp(x,p256_p) >= 0 || bn_cmp(y,p256_p) >= 0){
+     return -1;
+  }
+  mod_mul(x,x,p256_p_r2,&mod_p);
+  mod_mul(y,y,p256_p_r2,&mod_p);
+  if(!point_is_on_curve(x,y)){
+     return -1;
+  }
+  
+  /*w = s^-1  u1 = e * w  u2 = r * w 普通数乘蒙哥马利形式的w结果是普通数*/
+  bn_from_bytes(e,digest);
+  if(bn_cmp(e,p256_n) >= 0){
+     bn_sub(e,e,p256_n);
+  }
+  mod_mul(s,s,p256_n_r2,&mod_n);
+  mod_inv(s,s,&mod_n);
+  mod_mul(u1,e,s,&mod_n);
+  mod_mul(u2,r,s,&mod_n);
+  
+  /*u1 * G + u2 * Q 两个标量同时按位计算*/
+  memset(&table[0],0,sizeof(table[0]));
+  point_set_affine(&table[1],p256_gx,p256_gy);
+  point_set_affine(&table[2],x,y);
+  table[3] = table[1];
+  point_add(&table[3],&table[2]);
+  memset(&result,0,sizeof(result));
+  for(bit = ECDSA_WORDS * 32 - 1; bit >= 0; bit--){
+     point_double(&result,&result);
+     idx = (uint8_t)((u1[bit / 32] >> (bit % 32)) & 1) | (uint8_t)(((u2[bit / 32] >> (bit % 32)) & 1) << 1);
+     point_add(&result,&table[idx]);
+     if(idle_hook != NULL){
+        idle_hook();
+     }
+  }
+  if(bn_is_zero(result.z)){
+     return -1;
+  }
+  
+  /*x = X / Z^2 转换为普通数后模n 和r比较*/
+  mod_inv(e,result.z,&mod_p);
+  mod_mul(e,e,e,&mod_p);
+  mod_mul(x,result.x,e,&mod_p);
+  memset(e,0,sizeof(e));
+  e[0] = 1;
+  mod_mul(x,x,e,&mod_p);
+  if(bn_cmp(x,p256_n) >= 0){
+     bn_sub(x,x,p256_n);
+  }
+  
+  return bn_cmp(x,r) == 0 ? 0 : -1;
+}
+
+/*名称：ecdsa_set_idle_hook
+* 功能：设置验签时每次点运算后调用的函数 例如喂狗
+* 参数：hook 函数 NULL：不调用
+* 返回：无
+*/
+void ecdsa_set_idle_hook(ecdsa_idle_hook_t hook)
+{
+  idle_hook = hook;
+}
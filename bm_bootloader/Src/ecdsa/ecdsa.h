@@ -0,0 +1,36 @@
+#ifndef  __ECDSA_H__
+#define  __ECDSA_H__
+#include "stdint.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+#define  ECDSA_P256_KEY_SIZE             64    /*公钥 x||y 各32字节大端*/
+#define  ECDSA_P256_SIG_SIZE             64    /*签名 r||s 各32字节大端*/
+#define  ECDSA_P256_DIGEST_SIZE          32    /*sha256摘要*/
+
+typedef void (*ecdsa_idle_hook_t)(void);
+
+/*名称：ecdsa_p256_verify
+* 功能：NIST P-256曲线ECDSA验签 只用公钥运算 不需要防侧信道
+* 参数：public_key 公钥
+* 参数：digest     被签名数据的sha256摘要
+* 参数：signature  签名
+* 返回：0：签名正确 其他：失败
+*/
+int ecdsa_p256_verify(const uint8_t *public_key,const uint8_t *digest,const uint8_t *signature);
+
+/*名称：ecdsa_set_idle_hook
+* 功能：设置验签时每次点运算后调用的函数 例如喂狗
+* 参数：hook 函数 NULL：不调用
+* 返回：无
+*/
+void ecdsa_set_idle_hook(ecdsa_idle_hook_t hook);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
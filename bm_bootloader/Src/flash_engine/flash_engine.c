@@ -0,0 +1,324 @@
+#include "main.h"
+#include "stdbool.h"
+#include "flash_engine.h"
+#include "log.h"
+#define  LOG_MODULE_LEVEL    LOG_LEVEL_DEBUG
+#define  LOG_MODULE_NAME     "[flash_engine]"
+
+#define  FLASH_ENGINE_SYSTICK_VECTOR       15
+#define  FLASH_ENGINE_FLASH_VECTOR         (16 + FLASH_IRQn)
+
+typedef enum
+{
+FLASH_ENGINE_OP_ERASE = 0,
+FLASH_ENGINE_OP_PROGRAM
+}flash_engine_op_type_t;
+
+typedef struct
+{
+flash_engine_op_type_t type;
+uint32_t               addr;  /*当前擦除的页或者编程的半字地址*/
+const uint16_t        *source;/*当前编程的源数据*/
+uint32_t               cnt;   /*剩余的页数或者半字数*/
+}flash_engine_op_t;
+
+extern __IO uint32_t uwTick;
+extern HAL_TickFreqTypeDef uwTickFreq;
+
+/*SRAM中的中断向量表*/
+#ifdef __ICCARM__
+#pragma data_alignment=FLASH_ENGINE_VECTOR_ALIGN
+static uint32_t ram_vector[FLASH_ENGINE_VECTOR_CNT];
+#else
+static uint32_t ram_vector[FLASH_ENGINE_VECTOR_CNT] __attribute__((aligned(FLASH_ENGINE_VECTOR_ALIGN)));
+#endif
+static uint32_t flash_vector;
+
+/*操作队列 head是正在执行的操作 由中断推进*/
+static flash_engine_op_t queue[FLASH_ENGINE_QUEUE_SIZE];
+static volatile uint32_t head;
+static volatile uint32_t tail;
+static volatile bool busy;
+static volatile flash_engine_error_t error;
+static flash_engine_idle_hook_t idle_hook;
+static volatile uint32_t skip_cnt;    /*跳过的0xFFFF半字数 只增加*/
+
+/*名称：flash_engine_start
+* 功能：开始执行队列头部操作的下一步 0xFFFF不需要编程直接跳过 队列为空或者出错时停止
+* 参数：无
+* 返回：无
+*/
+FLASH_ENGINE_RAMFUNC static void flash_engine_start(void)
+{
+  flash_engine_op_t *op;
+  
+  while(head != tail && error.code == 0){
+     op = &queue[head];
+     if(op->type == FLASH_ENGINE_OP_ERASE){
+        FLASH->CR &= ~FLASH_CR_PG;
+        FLASH->CR |= FLASH_CR_PER;
+        FLASH->AR = op->addr;
+        FLASH->CR |= FLASH_CR_STRT;
+        return;
+     }
+     /*目的地址是0xFFFF即可*/
+     while(op->cnt > 0 && *op->source == 0xFFFF){
+        if(*(__IO uint16_t *)op->addr != 0xFFFF){
+           error.code = FLASH_ENGINE_ERR_PG;
+           error.addr = op->addr;
+           break;
+        }
+        op->addr += 2;
+        op->source ++;
+        op->cnt --;
+        skip_cnt ++;
+     }
+     if(error.code == 0 && op->cnt > 0){
+        FLASH->CR &= ~FLASH_CR_PER;
+        FLASH->CR |= FLASH_CR_PG;
+        *(__IO uint16_t *)op->addr = *op->source;
+        return;
+     }
+     if(error.code == 0){
+        head = (head + 1) % FLASH_ENGINE_QUEUE_SIZE;
+     }
+  }
+  head = tail;
+  FLASH->CR &= ~(FLASH_CR_PG | FLASH_CR_PER | FLASH_CR_EOPIE | FLASH_CR_ERRIE);
+  busy = false;
+}
+
+/*名称：flash_engine_irq_handler
+* 功能：FLASH中断 一步完成后检查结果并开始下一步
+* 参数：无
+* 返回：无
+*/
+FLASH_ENGINE_RAMFUNC static void flash_engine_irq_handler(void)
+{
+  uint32_t sr;
+  flash_engine_op_t *op;
+  
+  sr = FLASH->SR;
+  /*写1清除*/
+  FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+  if(!busy){
+     return;
+  }
+  op = &queue[head];
+  if(sr & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)){
+     error.code = (sr & FLASH_SR_PGERR ? FLASH_ENGINE_ERR_PG : 0) | (sr & FLASH_SR_WRPRTERR ? FLASH_ENGINE_ERR_WRP : 0);
+     error.addr = op->addr;
+  }else if(op->type == FLASH_ENGINE_OP_PROGRAM){
+     if(*(__IO uint16_t *)op->addr != *op->source){
+        error.code = FLASH_ENGINE_ERR_VERIFY;
+        error.addr = op->addr;
+     }else{
+        op->addr += 2;
+        op->source ++;
+        op->cnt --;
+     }
+  }else{
+     op->addr += FLASH_PAGE_SIZE;
+     op->cnt --;
+  }
+  if(error.code == 0 && op->cnt == 0){
+     FLASH->CR &= ~(FLASH_CR_PG | FLASH_CR_PER);
+     head = (head + 1) % FLASH_ENGINE_QUEUE_SIZE;
+  }
+  flash_engine_start();
+}
+
+/*名称：flash_engine_systick_handler
+* 功能：SysTick中断 擦写期间HAL_GetTick继续计时
+* 参数：无
+* 返回：无
+*/
+FLASH_ENGINE_RAMFUNC static void flash_engine_systick_handler(void)
+{
+  uwTick += uwTickFreq;
+}
+
+/*名称：flash_engine_init
+* 功能：把中断向量表复制到SRAM 替换FLASH和SysTick中断为SRAM中的处理函数 使能FLASH中断
+* 参数：无
+* 返回：无
+*/
+void flash_engine_init(void)
+{
+  uint32_t i;
+  
+  if(SCB->VTOR == (uint32_t)ram_vector){
+     return;
+  }
+  flash_vector = SCB->VTOR;
+  for(i = 0; i < FLASH_ENGINE_VECTOR_CNT; i++){
+      ram_vector[i] = ((uint32_t *)flash_vector)[i];
+  }
+  ram_vector[FLASH_ENGINE_SYSTICK_VECTOR] = (uint32_t)flash_engine_systick_handler;
+  ram_vector[FLASH_ENGINE_FLASH_VECTOR] = (uint32_t)flash_engine_irq_handler;
+  
+  __disable_irq();
+  SCB->VTOR = (uint32_t)ram_vector;
+  __DSB();
+  __enable_irq();
+  
+  head = tail = 0;
+  busy = false;
+  NVIC_SetPriority(FLASH_IRQn,0);
+  NVIC_ClearPendingIRQ(FLASH_IRQn);
+  NVIC_EnableIRQ(FLASH_IRQn);
+  log_debug("ram vector addr:0x%X.\r\n",(uint32_t)ram_vector);
+}
+
+/*名称：flash_engine_deinit
+* 功能：等待所有操作完成 关闭FLASH中断 恢复原来的中断向量表
+* 参数：无
+* 返回：无
+*/
+void flash_engine_deinit(void)
+{
+  if(SCB->VTOR != (uint32_t)ram_vector){
+     return;
+  }
+  flash_engine_wait();
+  NVIC_DisableIRQ(FLASH_IRQn);
+  NVIC_ClearPendingIRQ(FLASH_IRQn);
+  __disable_irq();
+  SCB->VTOR = flash_vector;
+  __DSB();
+  __enable_irq();
+}
+
+/*名称：flash_engine_set_idle_hook
+* 功能：设置等待时调用的函数 例如喂狗
+* 参数：hook 函数 NULL：不调用
+* 返回：无
+*/
+void flash_engine_set_idle_hook(flash_engine_idle_hook_t hook)
+{
+  idle_hook = hook;
+}
+
+/*名称：flash_engine_push
+* 功能：操作加入队列 队列满时等待 引擎空闲时立即开始
+* 参数：type   操作类型
+* 参数：addr   开始地址
+* 参数：source 源数据
+* 参数：cnt    页数或者半字数
+* 返回：0：成功 其他：失败
+*/
+static int flash_engine_push(flash_engine_op_type_t type,uint32_t addr,const uint16_t *source,uint32_t cnt)
+{
+  uint32_t next;
+  
+  if(cnt == 0){
+     return 0;
+  }
+  next = (tail + 1) % FLASH_ENGINE_QUEUE_SIZE;
+  while(next == head && busy){
+     if(idle_hook != NULL){
+        idle_hook();
+     }
+  }
+  /*上次出错后重新开始*/
+  if(!busy && error.code != 0){
+     return -1;
+  }
+  
+  __disable_irq();
+  queue[tail].type = type;
+  queue[tail].addr = addr;
+  queue[tail].source = source;
+  queue[tail].cnt = cnt;
+  tail = next;
+  if(!busy){
+     busy = true;
+     FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+     FLASH->CR |= FLASH_CR_EOPIE | FLASH_CR_ERRIE;
+     flash_engine_start();
+  }
+  __enable_irq();
+  
+  return 0;
+}
+
+/*名称：flash_engine_erase
+* 功能：把页擦除加入队列 队列满时等待 调用前flash需要解锁
+* 参数：start_addr 开始地址 页对齐
+* 参数：page_cnt   页数
+* 返回：0：成功 其他：失败
+*/
+int flash_engine_erase(uint32_t start_addr,uint32_t page_cnt)
+{
+  return flash_engine_push(FLASH_ENGINE_OP_ERASE,start_addr,NULL,page_cnt);
+}
+
+/*名称：flash_engine_program
+* 功能：把半字编程加入队列 队列满时等待 调用前flash需要解锁 完成前源数据不能修改
+* 参数：destination 目的地址 半字对齐
+* 参数：source      源地址
+* 参数：cnt         半字数量
+* 返回：0：成功 其他：失败
+*/
+int flash_engine_program(uint32_t destination,const uint16_t *source,uint32_t cnt)
+{
+  return flash_engine_push(FLASH_ENGINE_OP_PROGRAM,destination,source,cnt);
+}
+
+/*名称：flash_engine_is_busy
+* 功能：是否有操作没有完成
+* 参数：无
+* 返回：true：有 false：没有
+*/
+bool flash_engine_is_busy(void)
+{
+  return busy;
+}
+
+/*名称：flash_engine_wait
+* 功能：在SRAM中等待所有操作完成 等待时循环调用idle hook
+* 参数：无
+* 返回：0：成功 其他：失败 出错后队列中剩余的操作被丢弃
+*/
+FLASH_ENGINE_RAMFUNC int flash_engine_wait(void)
+{
+  while(busy){
+     if(idle_hook != NULL){
+        idle_hook();
+     }
+  }
+  if(error.code != 0){
+     return -1;
+  }
+  
+  return 0;
+}
+
+/*名称：flash_engine_get_error
+* 功能：获取最近一次错误 读取后清除
+* 参数：无
+* 返回：错误信息指针
+*/
+const flash_engine_error_t *flash_engine_get_error(void)
+{
+  static flash_engine_error_t last_error;
+  
+  __disable_irq();
+  last_error.code = error.code;
+  last_error.addr = error.addr;
+  error.code = 0;
+  error.addr = 0;
+  __enable_irq();
+  
+  return &last_error;
+}
+
+/*名称：flash_engine_get_skip_cnt
+* 功能：获取编程时跳过的0xFFFF半字总数 两次读取的差就是期间跳过的数量
+* 参数：无
+* 返回：跳过的半字数
+*/
+uint32_t flash_engine_get_skip_cnt(void)
+{
+  return skip_cnt;
+}
@@ -0,0 +1,107 @@
+#ifndef  __FLASH_ENGINE_H__
+#define  __FLASH_ENGINE_H__
+#include "stm32f1xx_hal.h"
+#include "stdbool.h"
+
+/******************************************************************************/
+/*    配置开始                                                                */
+/******************************************************************************/
+#define  FLASH_ENGINE_QUEUE_SIZE                 4     /*操作队列长度*/
+#define  FLASH_ENGINE_VECTOR_CNT                 76    /*F103xE中断向量数量 16个内核 + 60个外设*/
+#define  FLASH_ENGINE_VECTOR_ALIGN               512   /*VTOR要求按向量表大小向上取2的幂对齐*/
+/******************************************************************************/
+/*    配置结束                                                                */
+/******************************************************************************/
+
+/*在SRAM中执行的函数 擦除和编程期间从flash取指会被暂停*/
+#ifdef __ICCARM__
+#define  FLASH_ENGINE_RAMFUNC                    __ramfunc
+#elif defined(__GNUC__)
+#define  FLASH_ENGINE_RAMFUNC                    __attribute__((section(".RamFunc"),noinline))
+#else
+#error "ramfunc not supported for this compiler."
+#endif
+
+/*操作错误*/
+#define  FLASH_ENGINE_ERR_PG                     (1 << 0)  /*PGERR 编程的位置没有擦除*/
+#define  FLASH_ENGINE_ERR_WRP                    (1 << 1)  /*WRPRTERR 操作的位置被写保护*/
+#define  FLASH_ENGINE_ERR_VERIFY                 (1 << 2)  /*编程后读出的数据不一致*/
+
+typedef struct
+{
+uint32_t code;                                       /*错误*/
+uint32_t addr;                                       /*出错的地址*/
+}flash_engine_error_t;
+
+/*等待操作完成时循环调用 只有放在SRAM中的函数才能和擦除编程同时执行*/
+typedef void (*flash_engine_idle_hook_t)(void);
+
+
+/*名称：flash_engine_init
+* 功能：把中断向量表复制到SRAM 替换FLASH和SysTick中断为SRAM中的处理函数 使能FLASH中断
+* 参数：无
+* 返回：无
+*/
+void flash_engine_init(void);
+
+/*名称：flash_engine_deinit
+* 功能：等待所有操作完成 关闭FLASH中断 恢复原来的中断向量表
+* 参数：无
+* 返回：无
+*/
+void flash_engine_deinit(void);
+
+/*名称：flash_engine_set_idle_hook
+* 功能：设置等待时调用的函数 例如喂狗
+* 参数：hook 函数 NULL：不调用
+* 返回：无
+*/
+void flash_engine_set_idle_hook(flash_engine_idle_hook_t hook);
+
+/*名称：flash_engine_erase
+* 功能：把页擦除加入队列 队列满时等待 调用前flash需要解锁
+* 参数：start_addr 开始地址 页对齐
+* 参数：page_cnt   页数
+* 返回：0：成功 其他：失败
+*/
+int flash_engine_erase(uint32_t start_addr,uint32_t page_cnt);
+
+/*名称：flash_engine_program
+* 功能：把半字编程加入队列 队列满时等待 调用前flash需要解锁 完成前源数据不能修改
+* 参数：destination 目的地址 半字对齐
+* 参数：source      源地址
+* 参数：cnt         半字数量
+* 返回：0：成功 其他：失败
+*/
+int flash_engine_program(uint32_t destination,const uint16_t *source,uint32_t cnt);
+
+/*名称：flash_engine_is_busy
+* 功能：是否有操作没有完成
+* 参数：无
+* 返回：true：有 false：没有
+*/
+bool flash_engine_is_busy(void);
+
+/*名称：flash_engine_wait
+* 功能：在SRAM中等待所有操作完成 等待时循环调用idle hook
+* 参数：无
+* 返回：0：成功 其他：失败 出错后队列中剩余的操作被丢弃
+*/
+int flash_engine_wait(void);
+
+/*名称：flash_engine_get_error
+* 功能：获取最近一次错误 读取后清除
+* 参数：无
+* 返回：错误信息指针
+*/
+const flash_engine_error_t *flash_engine_get_error(void);
+
+/*名称：flash_engine_get_skip_cnt
+* 功能：获取编程时跳过的0xFFFF半字总数 两次读取的差就是期间跳过的数量
+* 参数：无
+* 返回：跳过的半字数
+*/
+uint32_t flash_engine_get_skip_cnt(void);
+
+
+#endif
@@ -5,6 +5,13 @@
 #define  LOG_MODULE_LEVEL    LOG_LEVEL_DEBUG
 #define  LOG_MODULE_NAME     "[flash_utils]"
 
+#if  FLASH_UTILS_STAT_ENABLE > 0
+/*flash操作统计*/
+static flash_utils_stat_t stat;
+#endif
+/*最近一次编程错误*/
+static flash_utils_error_t error;
+
 /*名称：flash_utils_init
 * 功能：flash工具初始化
 * 参数：无
@@ -19,10 +26,92 @@ void flash_utils_init(void)
   __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
   /* Unlock the Program memory */
   HAL_FLASH_Lock();
+#if  FLASH_UTILS_ENGINE_ENABLE > 0
+  flash_engine_init();
+#endif
+}
+
+/*名称：flash_utils_deinit
+* 功能：flash工具去初始化 跳转到应用程序之前调用
+* 参数：无
+* 返回：无
+*/
+void flash_utils_deinit(void)
+{
+#if  FLASH_UTILS_ENGINE_ENABLE > 0
+  flash_engine_deinit();
+#endif
+}
+
+#if  FLASH_UTILS_ENGINE_ENABLE > 0
+/*名称：flash_utils_engine_done
+* 功能：等待flash_engine完成并锁定flash 出错时记录错误
+* 参数：rc 加入队列的结果
+* 返回：0：成功 其他：失败
+*/
+static uint32_t flash_utils_engine_done(int rc)
+{
+  const flash_engine_error_t *engine_error;
+  
+  if(rc == 0){
+     rc = flash_engine_wait();
+  }
+  HAL_FLASH_Lock();
+  if(rc != 0){
+     engine_error = flash_engine_get_error();
+     error.code = engine_error->code;
+     error.addr = engine_error->addr;
+     return -1;
+  }
+  
+  return 0;
+}
+
+/*名称：flash_utils_engine_write
+* 功能：通过flash_engine按半字编程
+* 参数：destination 目的地址 半字对齐
+* 参数：source      源地址
+* 参数：cnt         半字数量
+* 参数：skip_cnt    跳过的0xFFFF半字数 成功时有效
+* 返回：0：成功 其他：失败
+*/
+static uint32_t flash_utils_engine_write(uint32_t destination,const uint16_t *source,uint32_t cnt,uint32_t *skip_cnt)
+{
+  uint32_t rc,start_skip_cnt;
+  
+  if(cnt > (USER_FLASH_END_ADDRESS + 1 - destination) / 2){
+     cnt = (USER_FLASH_END_ADDRESS + 1 - destination) / 2;
+  }
+  start_skip_cnt = flash_engine_get_skip_cnt();
+  HAL_FLASH_Unlock();
+  rc = flash_utils_engine_done(flash_engine_program(destination,source,cnt));
+  *skip_cnt = flash_engine_get_skip_cnt() - start_skip_cnt;
+  
+  return rc;
+}
+#endif
+
+/*名称：flash_utils_is_blank
+* 功能：检查flash是否全部是0xFF
+* 参数：addr 开始地址 字对齐
+* 参数：size 大小
+* 返回：true：空白 false：不是空白
+*/
+static bool flash_utils_is_blank(uint32_t addr,uint32_t size)
+{
+  uint32_t i;
+  
+  for(i = 0; i < size; i += 4){
+      if(*(__IO uint32_t *)(addr + i) != 0xFFFFFFFF){
+         return false;
+      }
+  }
+  
+  return true;
 }
 
 /*名称：flash_utils_erase
-* 功能：擦出指定范围flash数据
+* 功能：擦出指定范围flash数据 已经是空白的页不擦除
 * 参数：start_addr 开始地址
 * 参数：size       数据大小
 * 返回：0：成功 其他：失败
@@ -30,9 +119,17 @@ void flash_utils_init(void)
 uint32_t flash_utils_erase(uint32_t start_addr,uint32_t size)
 {
   uint32_t NbrOfPages = 0;
+  uint32_t i,page_addr,erase_cnt = 0;
+#if  FLASH_UTILS_ENGINE_ENABLE == 0
   uint32_t PageError = 0;
   FLASH_EraseInitTypeDef pEraseInit;
+#endif
   HAL_StatusTypeDef status = HAL_OK;
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  uint32_t page,start_time;
+  
+  start_time = HAL_GetTick();
+#endif
 
   /* Unlock the Flash to enable the flash control register access *************/ 
   HAL_FLASH_Unlock();
@@ -40,15 +137,47 @@ uint32_t flash_utils_erase(uint32_t start_addr,uint32_t size)
   /* Get the sector where start the user flash area */
   NbrOfPages = size % FLASH_PAGE_SIZE == 0 ? size / FLASH_PAGE_SIZE : (size / FLASH_PAGE_SIZE) + 1;
 
+#if  FLASH_UTILS_ENGINE_ENABLE == 0
   pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-  pEraseInit.PageAddress = start_addr;
   pEraseInit.Banks = FLASH_BANK_1;
-  pEraseInit.NbPages = NbrOfPages;
-  status = HAL_FLASHEx_Erase(&pEraseInit, &PageError);
+  pEraseInit.NbPages = 1;
+#endif
+  for(i = 0; i < NbrOfPages && status == HAL_OK; i++){
+      page_addr = start_addr + i * FLASH_PAGE_SIZE;
+#if  FLASH_UTILS_BLANK_CHECK_ENABLE > 0
+      if(flash_utils_is_blank(page_addr,FLASH_PAGE_SIZE)){
+         continue;
+      }
+#endif
+#if  FLASH_UTILS_ENGINE_ENABLE > 0
+      status = flash_engine_erase(page_addr,1) == 0 ? HAL_OK : HAL_ERROR;
+#else
+      pEraseInit.PageAddress = page_addr;
+      status = HAL_FLASHEx_Erase(&pEraseInit, &PageError);
+#endif
+#if  FLASH_UTILS_STAT_ENABLE > 0
+      page = (page_addr - FLASH_BASE) / FLASH_PAGE_SIZE;
+      if(page < FLASH_UTILS_STAT_PAGE_CNT){
+         stat.page_erase_cnt[page] ++;
+      }
+#endif
+      erase_cnt ++;
+  }
 
+#if  FLASH_UTILS_ENGINE_ENABLE > 0
+  status = flash_utils_engine_done(status == HAL_OK ? 0 : -1) == 0 ? HAL_OK : HAL_ERROR;
+#else
   /* Lock the Flash to disable the flash control register access (recommended
      to protect the FLASH memory against possible unwanted operation) *********/
   HAL_FLASH_Lock();
+#endif
+
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  /*统计擦除次数、跳过的空白页和耗时*/
+  stat.erase_cnt += erase_cnt;
+  stat.erase_skip_cnt += i - erase_cnt;
+  stat.erase_time += HAL_GetTick() - start_time;
+#endif
 
   if (status != HAL_OK)
   {
@@ -59,14 +188,14 @@ uint32_t flash_utils_erase(uint32_t start_addr,uint32_t size)
   return 0;
 }
 
-/*名称：flash_utils_write
-* 功能：在指定位置写入flash数据
+/*名称：flash_utils_hal_write
+* 功能：通过HAL按字编程
 * 参数：destination 目的地址
 * 参数：source      源地址
-* 参数：size        源大小
+* 参数：size        源大小 单位：字
 * 返回：0：成功 其他：失败
 */
-uint32_t flash_utils_write(uint32_t destination, uint32_t *source, uint32_t size)
+static uint32_t flash_utils_hal_write(uint32_t destination, uint32_t *source, uint32_t size)
 {
   uint32_t i = 0;
 
@@ -83,6 +212,9 @@ uint32_t flash_utils_write(uint32_t destination, uint32_t *source, uint32_t size
       if (*(uint32_t*)destination != *(uint32_t*)(source+i))
       {
         /* Flash content doesn't match SRAM content */
+        error.code = FLASH_UTILS_ERR_VERIFY;
+        error.addr = destination;
+        HAL_FLASH_Lock();
         return -1;
       }
       /* Increment FLASH destination address */
@@ -91,6 +223,9 @@ uint32_t flash_utils_write(uint32_t destination, uint32_t *source, uint32_t size
     else
     {
       /* Error occurred while writing data in Flash memory */
+      error.code = (HAL_FLASH_GetError() & HAL_FLASH_ERROR_PROG) ? FLASH_UTILS_ERR_PG : FLASH_UTILS_ERR_WRP;
+      error.addr = destination;
+      HAL_FLASH_Lock();
       return -1;
     }
   }
@@ -102,86 +237,275 @@ uint32_t flash_utils_write(uint32_t destination, uint32_t *source, uint32_t size
   return 0;
 }
 
+/*名称：flash_utils_fast_write
+* 功能：直接操作寄存器按半字连续编程 整个过程只设置一次PG位 跳过0xFFFF
+* 参数：destination 目的地址 半字对齐
+* 参数：source      源地址
+* 参数：cnt         半字数量
+* 参数：skip_cnt    跳过的0xFFFF半字数 成功时有效
+* 返回：0：成功 其他：失败
+*/
+static uint32_t flash_utils_fast_write(uint32_t destination,const uint16_t *source,uint32_t cnt,uint32_t *skip_cnt)
+{
+  uint32_t i,sr;
+  __IO uint16_t *dst;
+  
+  *skip_cnt = 0;
+  if(cnt > (USER_FLASH_END_ADDRESS + 1 - destination) / 2){
+     cnt = (USER_FLASH_END_ADDRESS + 1 - destination) / 2;
+  }
+  dst = (__IO uint16_t *)destination;
+  
+  HAL_FLASH_Unlock();
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+  SET_BIT(FLASH->CR,FLASH_CR_PG);
+  for(i = 0; i < cnt; i++){
+      /*0xFFFF不需要编程 目的地址是0xFFFF即可*/
+      if(source[i] == 0xFFFF){
+         if(dst[i] != 0xFFFF){
+            error.code = FLASH_UTILS_ERR_PG;
+            error.addr = (uint32_t)&dst[i];
+            break;
+         }
+         (*skip_cnt) ++;
+         continue;
+      }
+      dst[i] = source[i];
+      while(READ_BIT(FLASH->SR,FLASH_SR_BSY));
+      sr = FLASH->SR;
+      if(sr & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)){
+         error.code = (sr & FLASH_SR_PGERR ? FLASH_UTILS_ERR_PG : 0) | (sr & FLASH_SR_WRPRTERR ? FLASH_UTILS_ERR_WRP : 0);
+         error.addr = (uint32_t)&dst[i];
+         break;
+      }
+      if(dst[i] != source[i]){
+         error.code = FLASH_UTILS_ERR_VERIFY;
+         error.addr = (uint32_t)&dst[i];
+         break;
+      }
+  }
+  CLEAR_BIT(FLASH->CR,FLASH_CR_PG);
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGERR | FLASH_FLAG_WRPERR);
+  HAL_FLASH_Lock();
+  
+  return i == cnt ? 0 : -1;
+}
 
-/*名称：flash_utils_get_write_protection_status
-* 功能：获取整个flash是否被写保护
-* 参数：无
-* 返回：写保护状态
+/*名称：flash_utils_write
+* 功能：在指定位置写入flash数据
+* 参数：destination 目的地址
+* 参数：source      源地址
+* 参数：size        源大小
+* 返回：0：成功 其他：失败
 */
-flash_utils_wr_protection_t flash_utils_get_write_protection_status()
+uint32_t flash_utils_write(uint32_t destination, uint32_t *source, uint32_t size)
 {
-  uint32_t ProtectedPAGE;
-  FLASH_OBProgramInitTypeDef OptionsBytesStruct;
+  uint32_t rc,skip_cnt = 0;
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  uint32_t start_time;
+  
+  start_time = HAL_GetTick();
+#endif
+
+#if  FLASH_UTILS_ENGINE_ENABLE > 0
+  rc = flash_utils_engine_write(destination,(const uint16_t *)source,size * 2,&skip_cnt);
+#elif  FLASH_UTILS_FAST_PROGRAM_ENABLE > 0
+  rc = flash_utils_fast_write(destination,(const uint16_t *)source,size * 2,&skip_cnt);
+#else
+  /*HAL按字编程 0xFFFF也会编程*/
+  rc = flash_utils_hal_write(destination,source,size);
+#endif
+  if(rc != 0){
+     log_error("program addr:0x%X err:0x%X.\r\n",error.addr,error.code);
+  }
 
-  /* Unlock the Flash to enable the flash control register access *************/
-  HAL_FLASH_Unlock();
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  /*只统计成功的编程 跳过的0xFFFF由实际编程的路径给出 一个字分两个半字编程*/
+  if(rc == 0){
+     stat.program_cnt += size * 2 - skip_cnt;
+     stat.program_skip_cnt += skip_cnt;
+     stat.program_time += HAL_GetTick() - start_time;
+  }
+#endif
 
-  /* Check if there are write protected sectors inside the user flash area ****/
-  HAL_FLASHEx_OBGetConfig(&OptionsBytesStruct);
+  return rc;
+}
 
-  /* Lock the Flash to disable the flash control register access (recommended
-     to protect the FLASH memory against possible unwanted operation) *********/
+/*名称：flash_utils_write_halfword
+* 功能：在指定位置写入一个半字 用于不擦除的进度标记
+* 参数：destination 目的地址 半字对齐
+* 参数：value       半字数据
+* 返回：0：成功 其他：失败
+*/
+uint32_t flash_utils_write_halfword(uint32_t destination,uint16_t value)
+{
+  uint32_t rc,skip_cnt = 0;
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  uint32_t start_time;
+  
+  start_time = HAL_GetTick();
+#endif
+
+  if(destination > USER_FLASH_END_ADDRESS - 1){
+     return -1;
+  }
+#if  FLASH_UTILS_ENGINE_ENABLE > 0
+  rc = flash_utils_engine_write(destination,&value,1,&skip_cnt);
+#elif  FLASH_UTILS_FAST_PROGRAM_ENABLE > 0
+  rc = flash_utils_fast_write(destination,&value,1,&skip_cnt);
+#else
+  HAL_FLASH_Unlock();
+  rc = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, destination, value) == HAL_OK && *(uint16_t *)destination == value ? 0 : -1;
   HAL_FLASH_Lock();
+#endif
+
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  if(rc == 0){
+     stat.program_cnt += 1 - skip_cnt;
+     stat.program_skip_cnt += skip_cnt;
+     stat.program_time += HAL_GetTick() - start_time;
+  }
+#endif
 
-  /* Get pages already write protected ****************************************/
-  ProtectedPAGE = ~(OptionsBytesStruct.WRPPage) & OB_WRP_ALLPAGES;
+  return rc;
+}
 
-  /* Check if desired pages are already write protected ***********************/
-  if(ProtectedPAGE != 0)
-  {
-    /* Some sectors inside the user flash area are write protected */
-    return FLASH_UTILS_WR_PROTECTION_ENABLED;
+
+/*名称：flash_utils_get_write_protection_mask
+* 功能：获取地址范围所在的写保护页组
+* 参数：start_addr 开始地址
+* 参数：size       大小
+* 返回：页组掩码 置位的页组包含范围中的页
+*/
+uint32_t flash_utils_get_write_protection_mask(uint32_t start_addr,uint32_t size)
+{
+  uint32_t first,last,mask;
+
+  if(size == 0){
+     return 0;
   }
-  else
-  { 
-    /* No write protected sectors inside the user flash area */
-    return FLASH_UTILS_WR_PROTECTION_NONE;
+  first = (start_addr - FLASH_BASE) / FLASH_UTILS_WRP_GROUP_SIZE;
+  last = (start_addr + size - 1 - FLASH_BASE) / FLASH_UTILS_WRP_GROUP_SIZE;
+  /*最后一个页组包含剩余的全部页*/
+  first = first < FLASH_UTILS_WRP_GROUP_CNT ? first : FLASH_UTILS_WRP_GROUP_CNT - 1;
+  last = last < FLASH_UTILS_WRP_GROUP_CNT ? last : FLASH_UTILS_WRP_GROUP_CNT - 1;
+  mask = 0;
+  while(first <= last){
+     mask |= 1U << first;
+     first ++;
   }
+
+  return mask;
 }
 
-/*名称：flash_utils_write_protection_config
-* 功能：配置整个flash写保护状态
-* 参数：protection    保护状态
-* 返回：0：成功 其他：失败
+/*名称：flash_utils_get_write_protection
+* 功能：获取当前生效的写保护 复位时从选项字节加载
+* 参数：无
+* 返回：页组掩码 置位的页组被写保护
 */
-int flash_utils_write_protection_config(flash_utils_wr_protection_t protection)
+uint32_t flash_utils_get_write_protection(void)
 {
-  uint32_t ProtectedPAGE = 0x0;
-  FLASH_OBProgramInitTypeDef config_new, config_old;
-  HAL_StatusTypeDef result = HAL_OK;
-  
+  return ~FLASH->WRPR;
+}
 
-  /* Get pages write protection status ****************************************/
-  HAL_FLASHEx_OBGetConfig(&config_old);
+/*名称：flash_utils_get_write_protection_option
+* 功能：获取选项字节中的写保护 修改后复位才生效
+* 参数：无
+* 返回：页组掩码 置位的页组被写保护
+*/
+uint32_t flash_utils_get_write_protection_option(void)
+{
+  return ~((uint32_t)(uint8_t)OB->WRP0 | (uint32_t)(uint8_t)OB->WRP1 << 8 | (uint32_t)(uint8_t)OB->WRP2 << 16 | (uint32_t)(uint8_t)OB->WRP3 << 24);
+}
 
-  /* The parameter says whether we turn the protection on or off */
-  config_new.WRPState = (protection == FLASH_UTILS_WR_PROTECTION_ENABLED ? OB_WRPSTATE_ENABLE : OB_WRPSTATE_DISABLE);
+/*名称：flash_utils_program_option
+* 功能：编程一个选项字节 擦除后是0xFF的不编程
+* 参数：addr  选项字节地址
+* 参数：value 值
+* 返回：HAL状态
+*/
+static HAL_StatusTypeDef flash_utils_program_option(__IO uint16_t *addr,uint8_t value)
+{
+  HAL_StatusTypeDef result;
 
-  /* We want to modify only the Write protection */
-  config_new.OptionType = OPTIONBYTE_WRP;
-  
-  /* No read protection, keep BOR and reset settings */
-  config_new.RDPLevel = OB_RDP_LEVEL_0;
-  config_new.USERConfig = config_old.USERConfig;  
-  /* Get pages already write protected ****************************************/
-  ProtectedPAGE = config_old.WRPPage | OB_WRP_ALLPAGES;
+  if(value == 0xFF){
+     return HAL_OK;
+  }
+  SET_BIT(FLASH->CR,FLASH_CR_OPTPG);
+  *addr = value;
+  result = FLASH_WaitForLastOperation(FLASH_TIMEOUT_VALUE);
+  CLEAR_BIT(FLASH->CR,FLASH_CR_OPTPG);
 
-  /* Unlock the Flash to enable the flash control register access *************/ 
-  HAL_FLASH_Unlock();
+  return result;
+}
+
+/*名称：flash_utils_set_write_protection
+* 功能：设置选项字节中的写保护 和当前选项字节相同时不擦写 复位后生效
+* 参数：mask 页组掩码 置位的页组被写保护
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_set_write_protection(uint32_t mask)
+{
+  uint8_t user,data0,data1;
+  HAL_StatusTypeDef result;
 
-  /* Unlock the Options Bytes *************************************************/
+  if(flash_utils_get_write_protection_option() == mask){
+     return 0;
+  }
+  /*擦除选项字节后HAL恢复读保护 用户配置和数据字节在这里恢复*/
+  user = (uint8_t)((READ_REG(FLASH->OBR) & FLASH_OBR_USER) >> FLASH_OBR_USER_Pos);
+  data0 = (uint8_t)HAL_FLASHEx_OBGetUserData(OB_DATA_ADDRESS_DATA0);
+  data1 = (uint8_t)HAL_FLASHEx_OBGetUserData(OB_DATA_ADDRESS_DATA1);
+
+  HAL_FLASH_Unlock();
   HAL_FLASH_OB_Unlock();
-  
-  /* Erase all the option Bytes ***********************************************/
   result = HAL_FLASHEx_OBErase();
-    
-  if (result == HAL_OK)
-  {
-    config_new.WRPPage    = ProtectedPAGE;
-    result = HAL_FLASHEx_OBProgram(&config_new);
+  /*直接编程选项字节 HAL_FLASHEx_OBProgram会合并复位前的写保护*/
+  if(result == HAL_OK){
+     result = flash_utils_program_option(&OB->WRP0,(uint8_t)~mask);
   }
-  
-  return (result == HAL_OK ? 0: -1);
+  if(result == HAL_OK){
+     result = flash_utils_program_option(&OB->WRP1,(uint8_t)(~mask >> 8));
+  }
+  if(result == HAL_OK){
+     result = flash_utils_program_option(&OB->WRP2,(uint8_t)(~mask >> 16));
+  }
+  if(result == HAL_OK){
+     result = flash_utils_program_option(&OB->WRP3,(uint8_t)(~mask >> 24));
+  }
+  if(result == HAL_OK){
+     result = flash_utils_program_option(&OB->USER,(uint8_t)(user | 0xF8U));
+  }
+  if(result == HAL_OK){
+     result = flash_utils_program_option(&OB->Data0,data0);
+  }
+  if(result == HAL_OK){
+     result = flash_utils_program_option(&OB->Data1,data1);
+  }
+  HAL_FLASH_OB_Lock();
+  HAL_FLASH_Lock();
+
+  return result == HAL_OK && flash_utils_get_write_protection_option() == mask ? 0 : -1;
+}
+
+/*名称：flash_utils_get_write_protection_status
+* 功能：获取整个flash是否被写保护
+* 参数：无
+* 返回：写保护状态
+*/
+flash_utils_wr_protection_t flash_utils_get_write_protection_status()
+{
+  return flash_utils_get_write_protection() != 0 ? FLASH_UTILS_WR_PROTECTION_ENABLED : FLASH_UTILS_WR_PROTECTION_NONE;
+}
+
+/*名称：flash_utils_write_protection_config
+* 功能：配置整个flash写保护状态 和当前选项字节相同时不擦写 复位后生效
+* 参数：protection    保护状态
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_write_protection_config(flash_utils_wr_protection_t protection)
+{
+  return flash_utils_set_write_protection(protection == FLASH_UTILS_WR_PROTECTION_ENABLED ? OB_WRP_ALLPAGES : 0);
 }
 
 /*名称：flash_utils_read
@@ -209,3 +533,120 @@ for(i = 0; i < size; i ++){
 
 return 0;
 }
+
+
+/*名称：flash_utils_get_error
+* 功能：获取最近一次编程错误
+* 参数：无
+* 返回：错误信息指针
+*/
+const flash_utils_error_t *flash_utils_get_error(void)
+{
+  return &error;
+}
+
+/*名称：flash_utils_bench_speed
+* 功能：计算速度
+* 参数：size 数据大小 单位：字节
+* 参数：time 耗时 单位：ms
+* 返回：速度 单位：KB/s
+*/
+static uint32_t flash_utils_bench_speed(uint32_t size,uint32_t time)
+{
+  /*不足1ms按1ms计算*/
+  return size * 1000 / 1024 / (time > 0 ? time : 1);
+}
+
+/*名称：flash_utils_bench
+* 功能：测试擦除速度，以及HAL编程和寄存器编程的速度 测试区域原有数据会被擦除
+* 编程的数据取自flash开始处的bootloader代码
+* 参数：start_addr 测试区域开始地址 页对齐
+* 参数：size       测试区域大小
+* 参数：bench      测试结果
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_bench(uint32_t start_addr,uint32_t size,flash_utils_bench_t *bench)
+{
+  uint32_t start_time,skip_cnt;
+  
+  size = size / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+  /*测试区域不能和数据来源重叠*/
+  if(size == 0 || start_addr < FLASH_BASE + size || start_addr + size - 1 > USER_FLASH_END_ADDRESS){
+     return -1;
+  }
+  
+  start_time = HAL_GetTick();
+  if(flash_utils_erase(start_addr,size) != 0){
+     return -1;
+  }
+  bench->erase_speed = flash_utils_bench_speed(size,HAL_GetTick() - start_time);
+  
+  start_time = HAL_GetTick();
+  if(flash_utils_hal_write(start_addr,(uint32_t *)FLASH_BASE,size / 4) != 0){
+     return -1;
+  }
+  bench->hal_program_speed = flash_utils_bench_speed(size,HAL_GetTick() - start_time);
+  
+  if(flash_utils_erase(start_addr,size) != 0){
+     return -1;
+  }
+  start_time = HAL_GetTick();
+  if(flash_utils_fast_write(start_addr,(const uint16_t *)FLASH_BASE,size / 2,&skip_cnt) != 0){
+     return -1;
+  }
+  bench->fast_program_speed = flash_utils_bench_speed(size,HAL_GetTick() - start_time);
+  
+  bench->engine_program_speed = 0;
+#if  FLASH_UTILS_ENGINE_ENABLE > 0
+  if(flash_utils_erase(start_addr,size) != 0){
+     return -1;
+  }
+  start_time = HAL_GetTick();
+  if(flash_utils_engine_write(start_addr,(const uint16_t *)FLASH_BASE,size / 2,&skip_cnt) != 0){
+     return -1;
+  }
+  bench->engine_program_speed = flash_utils_bench_speed(size,HAL_GetTick() - start_time);
+#endif
+  
+  return 0;
+}
+
+/*名称：flash_utils_stat_reset
+* 功能：清零flash操作统计
+* 参数：无
+* 返回：无
+*/
+void flash_utils_stat_reset(void)
+{
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  memset(&stat,0,sizeof(stat));
+#endif
+}
+
+/*名称：flash_utils_get_stat
+* 功能：获取flash操作统计
+* 参数：无
+* 返回：统计信息指针
+*/
+const flash_utils_stat_t *flash_utils_get_stat(void)
+{
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  return &stat;
+#else
+  return NULL;
+#endif
+}
+
+/*名称：flash_utils_stat_estimate_time
+* 功能：按典型擦除和编程时间估算统计区间的flash耗时
+* 参数：无
+* 返回：估算耗时 单位：ms
+*/
+uint32_t flash_utils_stat_estimate_time(void)
+{
+#if  FLASH_UTILS_STAT_ENABLE > 0
+  return (stat.erase_cnt * FLASH_UTILS_PAGE_ERASE_TIME_US + stat.program_cnt * FLASH_UTILS_HALFWORD_PROGRAM_TIME_US) / 1000;
+#else
+  return 0;
+#endif
+}
@@ -1,10 +1,59 @@
 #ifndef  __FLASH_UTILS_H__
 #define  __FLASH_UTILS_H__
 #include "stm32f1xx_hal.h"
+#include "flash_engine.h"
 
 
-#define  USER_FLASH_END_ADDRESS          0x8003FFFF
+#define  USER_FLASH_END_ADDRESS          0x0803FFFF
 
+/******************************************************************************/
+/*    配置开始                                                                */
+/******************************************************************************/
+#define  FLASH_UTILS_STAT_ENABLE                 1     /*统计flash擦除和编程的代价*/
+#define  FLASH_UTILS_PAGE_ERASE_TIME_US          20000 /*页擦除典型耗时 单位：us*/
+#define  FLASH_UTILS_HALFWORD_PROGRAM_TIME_US    52    /*半字编程典型耗时 单位：us*/
+#define  FLASH_UTILS_FAST_PROGRAM_ENABLE         1     /*直接操作寄存器编程 不经过HAL_FLASH_Program*/
+#define  FLASH_UTILS_BLANK_CHECK_ENABLE          1     /*擦除前检查 已经是空白的页不擦除*/
+#define  FLASH_UTILS_ENGINE_ENABLE               1     /*擦除和编程交给SRAM中断驱动的flash_engine 等待时执行idle hook*/
+/******************************************************************************/
+/*    配置结束                                                                */
+/******************************************************************************/
+
+#define  FLASH_UTILS_STAT_PAGE_CNT       ((USER_FLASH_END_ADDRESS + 1 - FLASH_BASE) / FLASH_PAGE_SIZE)
+
+/*写保护按页组设置 每一位对应2页 最后一位对应剩余的全部页*/
+#define  FLASH_UTILS_WRP_GROUP_SIZE      (FLASH_PAGE_SIZE * 2)
+#define  FLASH_UTILS_WRP_GROUP_CNT       32
+
+typedef struct
+{
+uint32_t erase_cnt;                                  /*擦除的页数*/
+uint32_t erase_time;                                 /*擦除实际耗时 单位：ms*/
+uint32_t erase_skip_cnt;                             /*已经是空白没有擦除的页数*/
+uint32_t program_cnt;                                /*编程的半字数*/
+uint32_t program_skip_cnt;                           /*数据是0xFFFF没有编程的半字数*/
+uint32_t program_time;                               /*编程实际耗时 单位：ms*/
+uint16_t page_erase_cnt[FLASH_UTILS_STAT_PAGE_CNT];  /*每一页的擦除次数*/
+}flash_utils_stat_t;
+
+/*编程错误 和flash_engine相同*/
+#define  FLASH_UTILS_ERR_PG              FLASH_ENGINE_ERR_PG     /*PGERR 编程的位置没有擦除*/
+#define  FLASH_UTILS_ERR_WRP             FLASH_ENGINE_ERR_WRP    /*WRPRTERR 编程的位置被写保护*/
+#define  FLASH_UTILS_ERR_VERIFY          FLASH_ENGINE_ERR_VERIFY /*编程后读出的数据不一致*/
+
+typedef struct
+{
+uint32_t code;                                       /*最近一次编程错误*/
+uint32_t addr;                                       /*出错的地址*/
+}flash_utils_error_t;
+
+typedef struct
+{
+uint32_t erase_speed;                                /*擦除速度 单位：KB/s*/
+uint32_t hal_program_speed;                          /*HAL编程速度 单位：KB/s*/
+uint32_t fast_program_speed;                         /*寄存器编程速度 单位：KB/s*/
+uint32_t engine_program_speed;                       /*flash_engine编程速度 单位：KB/s 没有使能时为0*/
+}flash_utils_bench_t;
 
 typedef enum
 {
@@ -22,6 +71,12 @@ FLASH_UTILS_WR_PROTECTION_ENABLED
 * 返回：无
 */
 void flash_utils_init(void);
+/*名称：flash_utils_deinit
+* 功能：flash工具去初始化 跳转到应用程序之前调用
+* 参数：无
+* 返回：无
+*/
+void flash_utils_deinit(void);
 /*名称：flash_utils_erase
 * 功能：擦出指定范围flash数据
 * 参数：start_addr 开始地址
@@ -37,6 +92,38 @@ uint32_t flash_utils_erase(uint32_t start_addr,uint32_t size);
 * 返回：0：成功 其他：失败
 */
 uint32_t flash_utils_write(uint32_t destination, uint32_t *source, uint32_t size);
+/*名称：flash_utils_write_halfword
+* 功能：在指定位置写入一个半字 用于不擦除的进度标记
+* 参数：destination 目的地址 半字对齐
+* 参数：value       半字数据
+* 返回：0：成功 其他：失败
+*/
+uint32_t flash_utils_write_halfword(uint32_t destination,uint16_t value);
+/*名称：flash_utils_get_write_protection_mask
+* 功能：获取地址范围所在的写保护页组
+* 参数：start_addr 开始地址
+* 参数：size       大小
+* 返回：页组掩码 置位的页组包含范围中的页
+*/
+uint32_t flash_utils_get_write_protection_mask(uint32_t start_addr,uint32_t size);
+/*名称：flash_utils_get_write_protection
+* 功能：获取当前生效的写保护 复位时从选项字节加载
+* 参数：无
+* 返回：页组掩码 置位的页组被写保护
+*/
+uint32_t flash_utils_get_write_protection(void);
+/*名称：flash_utils_get_write_protection_option
+* 功能：获取选项字节中的写保护 修改后复位才生效
+* 参数：无
+* 返回：页组掩码 置位的页组被写保护
+*/
+uint32_t flash_utils_get_write_protection_option(void);
+/*名称：flash_utils_set_write_protection
+* 功能：设置选项字节中的写保护 和当前选项字节相同时不擦写 复位后生效
+* 参数：mask 页组掩码 置位的页组被写保护
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_set_write_protection(uint32_t mask);
 /*名称：flash_utils_get_write_protection_status
 * 功能：获取整个flash是否被写保护
 * 参数：无
@@ -44,7 +131,7 @@ uint32_t flash_utils_write(uint32_t destination, uint32_t *source, uint32_t size
 */
 flash_utils_wr_protection_t flash_utils_get_write_protection_status();
 /*名称：flash_utils_write_protection_config
-* 功能：配置整个flash写保护状态
+* 功能：配置整个flash写保护状态 和当前选项字节相同时不擦写 复位后生效
 * 参数：protection    保护状态
 * 返回：0：成功 其他：失败
 */
@@ -59,6 +146,43 @@ int flash_utils_write_protection_config(flash_utils_wr_protection_t protection);
 */
 int flash_utils_read(uint32_t *dst,const uint32_t addr,const uint32_t size);
 
+/*名称：flash_utils_get_error
+* 功能：获取最近一次编程错误
+* 参数：无
+* 返回：错误信息指针
+*/
+const flash_utils_error_t *flash_utils_get_error(void);
+
+/*名称：flash_utils_bench
+* 功能：测试擦除速度，以及HAL编程和寄存器编程的速度 测试区域原有数据会被擦除
+* 参数：start_addr 测试区域开始地址 页对齐
+* 参数：size       测试区域大小
+* 参数：bench      测试结果
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_bench(uint32_t start_addr,uint32_t size,flash_utils_bench_t *bench);
+
+/*名称：flash_utils_stat_reset
+* 功能：清零flash操作统计
+* 参数：无
+* 返回：无
+*/
+void flash_utils_stat_reset(void);
+
+/*名称：flash_utils_get_stat
+* 功能：获取flash操作统计
+* 参数：无
+* 返回：统计信息指针
+*/
+const flash_utils_stat_t *flash_utils_get_stat(void);
+
+/*名称：flash_utils_stat_estimate_time
+* 功能：按典型擦除和编程时间估算统计区间的flash耗时
+* 参数：无
+* 返回：估算耗时 单位：ms
+*/
+uint32_t flash_utils_stat_estimate_time(void);
+
 
 
 
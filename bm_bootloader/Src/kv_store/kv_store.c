@@ -0,0 +1,440 @@
+#include "main.h"
+#include "stdbool.h"
+#include "stddef.h"
+#include "string.h"
+#include "flash_utils.h"
+#include "crc32.h"
+#include "kv_store.h"
+#include "log.h"
+#define  LOG_MODULE_LEVEL    LOG_LEVEL_DEBUG
+#define  LOG_MODULE_NAME     "[kv_store]"
+
+#define  KV_STORE_PAGE_MAGIC             0x4750564BU /*"KVPG"*/
+#define  KV_STORE_KEY_BLANK              0xFFFF      /*未写入的记录*/
+#define  KV_STORE_DATA_SIZE(size)        (((uint32_t)(size) + 3) & ~3U)
+#define  KV_STORE_RECORD_SIZE(size)      (sizeof(kv_store_record_t) + KV_STORE_DATA_SIZE(size) + 4)/*记录头 值 crc*/
+
+#if  KV_STORE_PAGE_CNT < 2
+#error "KV_STORE_PAGE_CNT must be at least 2"
+#endif
+/*所有键的值和一条新记录必须能放在一页中 页切换时才能复制完最旧页中的值*/
+#if  (KV_STORE_KEY_CNT + 1) * ((KV_STORE_VALUE_MAX_SIZE + 3) / 4 * 4 + 8) > KV_STORE_PAGE_SIZE - 8
+#error "KV_STORE_KEY_CNT * KV_STORE_VALUE_MAX_SIZE too large for one page"
+#endif
+
+/*页头 擦除后写入 序号越大越新 magic最后写入*/
+typedef struct
+{
+uint32_t magic;
+uint32_t sequence;
+}kv_store_page_t;
+
+/*记录头 后面是值和crc 长度为0表示删除*/
+typedef struct
+{
+uint16_t key;
+uint16_t size;
+}kv_store_record_t;
+
+/*每个键最新记录的地址 0：不存在*/
+static uint32_t kv_index[KV_STORE_KEY_CNT];
+static uint8_t  kv_active_page;
+static uint32_t kv_active_sequence;
+/*当前页写入新记录的地址 0：不能继续写入*/
+static uint32_t kv_next_addr;
+static bool     kv_init_done;
+/*记录写入缓存 一次写入flash*/
+static uint32_t kv_record_buffer[KV_STORE_RECORD_SIZE(KV_STORE_VALUE_MAX_SIZE) / 4];
+
+/*名称：kv_store_get_page_addr
+* 功能：获取页的地址
+* 参数：page 页序号
+* 返回：页地址
+*/
+static uint32_t kv_store_get_page_addr(uint8_t page)
+{
+  return KV_STORE_ADDR + page * KV_STORE_PAGE_SIZE;
+}
+
+/*名称：kv_store_is_page_valid
+* 功能：判断页头是否有效
+* 参数：page 页序号
+* 返回：true：有效 false：无效
+*/
+static bool kv_store_is_page_valid(uint8_t page)
+{
+  return ((const kv_store_page_t *)kv_store_get_page_addr(page))->magic == KV_STORE_PAGE_MAGIC;
+}
+
+/*名称：kv_store_is_page_blank
+* 功能：判断页是否是擦除状态
+* 参数：page 页序号
+* 返回：true：是 false：否
+*/
+static bool kv_store_is_page_blank(uint8_t page)
+{
+  const uint32_t *word = (const uint32_t *)kv_store_get_page_addr(page);
+  uint32_t i;
+
+  for(i = 0; i < KV_STORE_PAGE_SIZE / 4; i++){
+     if(word[i] != 0xFFFFFFFF){
+        return false;
+     }
+  }
+
+  return true;
+}
+
+/*名称：kv_store_get_record_end
+* 功能：获取记录之后的地址 用于顺序查找下一条记录
+* 参数：addr     记录地址
+* 参数：page_end 页结束地址
+* 返回：下一条记录的地址 0：记录头已经损坏 无法继续查找
+*/
+static uint32_t kv_store_get_record_end(uint32_t addr,uint32_t page_end)
+{
+  const kv_store_record_t *record = (const kv_store_record_t *)addr;
+
+  if(record->size > KV_STORE_VALUE_MAX_SIZE || addr + KV_STORE_RECORD_SIZE(record->size) > page_end){
+     return 0;
+  }
+
+  return addr + KV_STORE_RECORD_SIZE(record->size);
+}
+
+/*名称：kv_store_is_record_valid
+* 功能：判断记录是否完整 写入中掉电的记录crc错误
+* 参数：addr     记录地址
+* 参数：page_end 页结束地址
+* 返回：true：有效 false：无效
+*/
+static bool kv_store_is_record_valid(uint32_t addr,uint32_t page_end)
+{
+  const kv_store_record_t *record = (const kv_store_record_t *)addr;
+
+  if(record->key >= KV_STORE_KEY_CNT || kv_store_get_record_end(addr,page_end) == 0){
+     return false;
+  }
+
+  return *(const uint32_t *)(addr + KV_STORE_RECORD_SIZE(record->size) - 4) == crc32_calculate(record,sizeof(kv_store_record_t) + KV_STORE_DATA_SIZE(record->size));
+}
+
+/*名称：kv_store_load_page
+* 功能：按写入顺序把页中的记录加入索引
+* 参数：page 页序号
+* 返回：新记录写入的地址 0：页已满或者记录头损坏
+*/
+static uint32_t kv_store_load_page(uint8_t page)
+{
+  const kv_store_record_t *record;
+  uint32_t addr,end;
+
+  addr = kv_store_get_page_addr(page) + sizeof(kv_store_page_t);
+  end = kv_store_get_page_addr(page) + KV_STORE_PAGE_SIZE;
+  while(addr + sizeof(kv_store_record_t) <= end){
+     record = (const kv_store_record_t *)addr;
+     if(record->key == KV_STORE_KEY_BLANK){
+        return addr;
+     }
+     if(kv_store_is_record_valid(addr,end)){
+        kv_index[record->key] = record->size == 0 ? 0 : addr;
+     }
+     addr = kv_store_get_record_end(addr,end);
+     if(addr == 0){
+        break;
+     }
+  }
+
+  return 0;
+}
+
+/*名称：kv_store_write_record
+* 功能：在当前页追加一条记录 成功后更新索引
+* 参数：key   键
+* 参数：value 值
+* 参数：size  值的长度 0：删除
+* 返回：0：成功 其他：失败
+*/
+static int kv_store_write_record(uint16_t key,const void *value,uint16_t size)
+{
+  kv_store_record_t *record = (kv_store_record_t *)kv_record_buffer;
+  uint32_t addr,end;
+  uint32_t rc;
+
+  addr = kv_next_addr;
+  end = kv_store_get_page_addr(kv_active_page) + KV_STORE_PAGE_SIZE;
+  if(addr == 0 || addr + KV_STORE_RECORD_SIZE(size) > end){
+     return -1;
+  }
+
+  memset(kv_record_buffer,0xFF,sizeof(kv_record_buffer));
+  record->key = key;
+  record->size = size;
+  if(size > 0){
+     memcpy(record + 1,value,size);
+  }
+  kv_record_buffer[(KV_STORE_RECORD_SIZE(size) - 4) / 4] = crc32_calculate(record,sizeof(kv_store_record_t) + KV_STORE_DATA_SIZE(size));
+
+  rc = flash_utils_write(addr,kv_record_buffer,KV_STORE_RECORD_SIZE(size) / 4);
+  if(rc != 0 || !kv_store_is_record_valid(addr,end)){
+     log_error("write key:%d addr:0x%X err.\r\n",key,addr);
+     /*记录可能只写入了一部分 这一页不再写入*/
+     kv_next_addr = 0;
+     return -1;
+  }
+  kv_index[key] = size == 0 ? 0 : addr;
+  kv_next_addr = addr + KV_STORE_RECORD_SIZE(size);
+
+  return 0;
+}
+
+/*名称：kv_store_collect_page
+* 功能：把页中仍然有效的记录复制到当前页 然后擦除这一页
+* 参数：page 页序号
+* 返回：0：成功 其他：失败
+*/
+static int kv_store_collect_page(uint8_t page)
+{
+  const kv_store_record_t *record;
+  uint32_t addr,end;
+  int rc;
+
+  if(kv_store_is_page_valid(page)){
+     addr = kv_store_get_page_addr(page) + sizeof(kv_store_page_t);
+     end = kv_store_get_page_addr(page) + KV_STORE_PAGE_SIZE;
+     while(addr != 0 && addr + sizeof(kv_store_record_t) <= end){
+        record = (const kv_store_record_t *)addr;
+        if(record->key == KV_STORE_KEY_BLANK){
+           break;
+        }
+        /*索引指向这条记录才是最新的值*/
+        if(record->key < KV_STORE_KEY_CNT && kv_index[record->key] == addr){
+           rc = kv_store_write_record(record->key,record + 1,record->size);
+           if(rc != 0){
+              return -1;
+           }
+        }
+        addr = kv_store_get_record_end(addr,end);
+     }
+  }
+
+  log_debug("erase page%d.\r\n",page);
+  if(flash_utils_erase(kv_store_get_page_addr(page),KV_STORE_PAGE_SIZE) != 0){
+     log_error("erase page%d err.\r\n",page);
+     return -1;
+  }
+
+  return 0;
+}
+
+/*名称：kv_store_activate_page
+* 功能：在擦除的页写入页头 作为当前页
+* 参数：page     页序号
+* 参数：sequence 页头序号
+* 返回：0：成功 其他：失败
+*/
+static int kv_store_activate_page(uint8_t page,uint32_t sequence)
+{
+  kv_store_page_t header;
+  uint32_t rc;
+
+  rc = flash_utils_erase(kv_store_get_page_addr(page),KV_STORE_PAGE_SIZE);
+  if(rc != 0){
+     log_error("erase page%d err.\r\n",page);
+     return -1;
+  }
+  /*先写序号最后写magic magic是页头的提交标记 写入中掉电的页没有magic 按无效页擦除*/
+  header.magic = KV_STORE_PAGE_MAGIC;
+  header.sequence = sequence;
+  rc = flash_utils_write(kv_store_get_page_addr(page) + offsetof(kv_store_page_t,sequence),&header.sequence,1);
+  if(rc == 0){
+     rc = flash_utils_write(kv_store_get_page_addr(page) + offsetof(kv_store_page_t,magic),&header.magic,1);
+  }
+  if(rc != 0){
+     log_error("write page%d header err.\r\n",page);
+     return -1;
+  }
+  kv_active_page = page;
+  kv_active_sequence = sequence;
+  kv_next_addr = kv_store_get_page_addr(page) + sizeof(kv_store_page_t);
+
+  return 0;
+}
+
+/*名称：kv_store_switch_page
+* 功能：当前页已满 切换到下一页 回收最旧的页
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+static int kv_store_switch_page()
+{
+  int rc;
+  uint8_t page;
+
+  page = (kv_active_page + 1) % KV_STORE_PAGE_CNT;
+  log_debug("switch to page%d.\r\n",page);
+  rc = kv_store_activate_page(page,kv_active_sequence + 1);
+  if(rc != 0){
+     return -1;
+  }
+
+  /*下一页是最旧的页 擦除后作为下次切换的空白页*/
+  return kv_store_collect_page((page + 1) % KV_STORE_PAGE_CNT);
+}
+
+/*名称：kv_store_init
+* 功能：找到当前页 建立索引 完成掉电前没有完成的页切换 应用程序启动后调用一次
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+int kv_store_init(void)
+{
+  const kv_store_page_t *header;
+  uint8_t page,i;
+  int rc;
+  bool found;
+
+  kv_init_done = false;
+  memset(kv_index,0,sizeof(kv_index));
+  found = false;
+  for(page = 0; page < KV_STORE_PAGE_CNT; page++){
+     header = (const kv_store_page_t *)kv_store_get_page_addr(page);
+     if(kv_store_is_page_valid(page) && (!found || header->sequence > kv_active_sequence)){
+        found = true;
+        kv_active_page = page;
+        kv_active_sequence = header->sequence;
+     }
+  }
+
+  if(!found){
+     log_debug("format.\r\n");
+     for(page = 1; page < KV_STORE_PAGE_CNT; page++){
+        if(flash_utils_erase(kv_store_get_page_addr(page),KV_STORE_PAGE_SIZE) != 0){
+           return -1;
+        }
+     }
+     rc = kv_store_activate_page(0,1);
+     if(rc != 0){
+        return -1;
+     }
+     kv_init_done = true;
+     return 0;
+  }
+
+  /*页按环形顺序写入 当前页的下一页最旧 从旧到新建立索引 当前页最后加入*/
+  for(i = 1; i < KV_STORE_PAGE_CNT; i++){
+     page = (kv_active_page + i) % KV_STORE_PAGE_CNT;
+     if(kv_store_is_page_valid(page)){
+        kv_store_load_page(page);
+     }
+  }
+
+  /*当前页的下一页应该是空白的 不是时说明切换中掉电
+   *最旧页有效时当前页中只有复制过来的记录 最后一条可能不完整 后面不能再写入
+   *重新激活当前页后从头回收 最旧页无效时只需要擦除*/
+  page = (kv_active_page + 1) % KV_STORE_PAGE_CNT;
+  if(!kv_store_is_page_blank(page)){
+     log_warning("collect page%d.\r\n",page);
+     if(kv_store_is_page_valid(page)){
+        rc = kv_store_activate_page(kv_active_page,kv_active_sequence);
+     }else{
+        kv_next_addr = kv_store_load_page(kv_active_page);
+        rc = 0;
+     }
+     if(rc == 0){
+        rc = kv_store_collect_page(page);
+     }
+     if(rc != 0){
+        return -1;
+     }
+  }else{
+     kv_next_addr = kv_store_load_page(kv_active_page);
+  }
+  kv_init_done = true;
+  log_debug("page%d seq:%d next:0x%X.\r\n",kv_active_page,kv_active_sequence,kv_next_addr);
+
+  return 0;
+}
+
+/*名称：kv_store_get
+* 功能：读取键的值
+* 参数：key   键
+* 参数：value 值的缓存
+* 参数：size  缓存大小 值比缓存长时只读取缓存大小
+* 返回：值的长度 -1：键不存在
+*/
+int kv_store_get(uint16_t key,void *value,uint16_t size)
+{
+  const kv_store_record_t *record;
+
+  if(!kv_init_done || key >= KV_STORE_KEY_CNT || kv_index[key] == 0){
+     return -1;
+  }
+  record = (const kv_store_record_t *)kv_index[key];
+  memcpy(value,record + 1,record->size < size ? record->size : size);
+
+  return record->size;
+}
+
+/*名称：kv_store_update
+* 功能：追加记录 当前页没有空间或者写入失败时切换页后再写入
+* 参数：key   键
+* 参数：value 值
+* 参数：size  值的长度 0：删除
+* 返回：0：成功 其他：失败
+*/
+static int kv_store_update(uint16_t key,const void *value,uint16_t size)
+{
+  int rc;
+
+  rc = kv_store_write_record(key,value,size);
+  if(rc == 0){
+     return 0;
+  }
+  rc = kv_store_switch_page();
+  if(rc != 0){
+     return -1;
+  }
+
+  return kv_store_write_record(key,value,size);
+}
+
+/*名称：kv_store_set
+* 功能：写入键的值 追加一条记录 旧的记录在页回收时丢弃
+* 参数：key   键
+* 参数：value 值
+* 参数：size  值的长度 1~KV_STORE_VALUE_MAX_SIZE
+* 返回：0：成功 其他：失败
+*/
+int kv_store_set(uint16_t key,const void *value,uint16_t size)
+{
+  const kv_store_record_t *record;
+
+  if(!kv_init_done || key >= KV_STORE_KEY_CNT || size == 0 || size > KV_STORE_VALUE_MAX_SIZE){
+     return -1;
+  }
+  /*值没有变化时不写入*/
+  record = (const kv_store_record_t *)kv_index[key];
+  if(record != NULL && record->size == size && memcmp(record + 1,value,size) == 0){
+     return 0;
+  }
+
+  return kv_store_update(key,value,size);
+}
+
+/*名称：kv_store_delete
+* 功能：删除键 追加一条长度为0的记录
+* 参数：key 键
+* 返回：0：成功 其他：失败
+*/
+int kv_store_delete(uint16_t key)
+{
+  if(!kv_init_done || key >= KV_STORE_KEY_CNT){
+     return -1;
+  }
+  if(kv_index[key] == 0){
+     return 0;
+  }
+
+  return kv_store_update(key,NULL,0);
+}
@@ -0,0 +1,58 @@
+#ifndef  __KV_STORE_H__
+#define  __KV_STORE_H__
+#include "stm32f1xx_hal.h"
+
+/*键值存储 bootloader和应用程序共用 在独立的flash页中追加写入 不占用env*/
+/*多个页组成环形 当前页写满后写入下一页 并把最旧页中有效的值复制过来后擦除最旧页 每页的擦除次数相同*/
+/*初始化时建立每个键最新记录的索引 读取不需要查找*/
+/*bootloader不调用kv_store_init 应用程序使用前必须先调用kv_store_init 没有初始化时读写都返回失败*/
+
+/******************************************************************************/
+/*    配置开始                                                                */
+/******************************************************************************/
+#define  KV_STORE_ADDR                           (0x0803E800)/*在交换进度日志之后*/
+#define  KV_STORE_PAGE_SIZE                      (0x800)
+#define  KV_STORE_PAGE_CNT                       3           /*至少2页 始终有一页是擦除状态*/
+#define  KV_STORE_KEY_CNT                        32          /*键的范围0~KV_STORE_KEY_CNT-1*/
+#define  KV_STORE_VALUE_MAX_SIZE                 32          /*值的最大长度 单位：字节*/
+/******************************************************************************/
+/*    配置结束                                                                */
+/******************************************************************************/
+
+#define  KV_STORE_SIZE                           (KV_STORE_PAGE_SIZE * KV_STORE_PAGE_CNT)
+
+
+/*名称：kv_store_init
+* 功能：找到当前页 建立索引 完成掉电前没有完成的页切换 应用程序启动后调用一次
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+int kv_store_init(void);
+
+/*名称：kv_store_get
+* 功能：读取键的值
+* 参数：key   键
+* 参数：value 值的缓存
+* 参数：size  缓存大小 值比缓存长时只读取缓存大小
+* 返回：值的长度 -1：键不存在
+*/
+int kv_store_get(uint16_t key,void *value,uint16_t size);
+
+/*名称：kv_store_set
+* 功能：写入键的值 追加一条记录 旧的记录在页回收时丢弃
+* 参数：key   键
+* 参数：value 值
+* 参数：size  值的长度 1~KV_STORE_VALUE_MAX_SIZE
+* 返回：0：成功 其他：失败
+*/
+int kv_store_set(uint16_t key,const void *value,uint16_t size);
+
+/*名称：kv_store_delete
+* 功能：删除键 追加一条长度为0的记录
+* 参数：key 键
+* 返回：0：成功 其他：失败
+*/
+int kv_store_delete(uint16_t key);
+
+
+#endif
@@ -0,0 +1,170 @@
+#include "string.h"
+#include "lz.h"
+
+typedef struct
+{
+const uint8_t *dst_base;
+uint8_t       *buffer;
+uint32_t       buffer_size;
+uint32_t       used;       /*缓存中的数据量*/
+uint32_t       offset;     /*缓存数据在解压数据中的偏移*/
+lz_write_t     write;
+}lz_output_t;
+
+
+/*名称：lz_read_length
+* 功能：读取扩展长度
+* 参数：pos    读取位置
+* 参数：end    数据结束位置
+* 参数：length 长度 已包含token中的15
+* 返回：0：成功 其他：失败
+*/
+static int lz_read_length(const uint8_t **pos,const uint8_t *end,uint32_t *length)
+{
+  uint8_t byte;
+  
+  do{
+     if(*pos >= end){
+        return -1;
+     }
+     byte = *(*pos)++;
+     *length += byte;
+  }while(byte == 255);
+  
+  return 0;
+}
+
+/*名称：lz_output_byte
+* 功能：输出一个字节 缓存满时输出
+* 参数：output 输出
+* 参数：byte   数据
+* 返回：0：成功 其他：失败
+*/
+static int lz_output_byte(lz_output_t *output,uint8_t byte)
+{
+  output->buffer[output->used++] = byte;
+  if(output->used == output->buffer_size){
+     if(output->write(output->offset,output->buffer,output->used) != 0){
+        return -1;
+     }
+     output->offset += output->used;
+     output->used = 0;
+  }
+  
+  return 0;
+}
+
+/*名称：lz_get_header
+* 功能：读取并检查压缩头
+* 参数：src      压缩数据地址
+* 参数：src_size 压缩数据大小
+* 参数：header   压缩头指针
+* 返回：0：成功 其他：不是有效的压缩数据
+*/
+int lz_get_header(const uint8_t *src,uint32_t src_size,lz_header_t *header)
+{
+  if(src_size < sizeof(lz_header_t)){
+     return -1;
+  }
+  memcpy(header,src,sizeof(lz_header_t));
+  if(header->magic != LZ_MAGIC || header->version != LZ_VERSION){
+     return -1;
+  }
+  
+  return 0;
+}
+
+/*名称：lz_decompress
+* 功能：流式解压 解压数据先写入缓存，缓存满后调用write输出
+* 参数：src         压缩数据地址
+* 参数：src_size    压缩数据大小
+* 参数：dst_base    已输出数据的读取地址
+* 参数：buffer      输出缓存
+* 参数：buffer_size 输出缓存大小 除最后一次外每次输出的大小
+* 参数：write       输出函数
+* 返回：0：成功 其他：失败
+*/
+int lz_decompress(const uint8_t *src,uint32_t src_size,const uint8_t *dst_base,uint8_t *buffer,uint32_t buffer_size,lz_write_t write)
+{
+  lz_header_t header;
+  lz_output_t output;
+  const uint8_t *pos,*end;
+  uint32_t token,length,offset,match,total;
+  uint8_t byte;
+  
+  if(lz_get_header(src,src_size,&header) != 0){
+     return -1;
+  }
+  pos = src + sizeof(lz_header_t);
+  end = src + src_size;
+  output.dst_base = dst_base;
+  output.buffer = buffer;
+  output.buffer_size = buffer_size;
+  output.used = 0;
+  output.offset = 0;
+  output.write = write;
+  
+  while(pos < end){
+     token = *pos++;
+     /*字面量*/
+     length = token >> 4;
+     if(length == 15 && lz_read_length(&pos,end,&length) != 0){
+        return -1;
+     }
+     if(length > (uint32_t)(end - pos) || length > header.raw_size - (output.offset + output.used)){
+        return -1;
+     }
+     while(length > 0){
+        if(lz_output_byte(&output,*pos++) != 0){
+           return -1;
+        }
+        length --;
+     }
+     /*最后一个序列没有匹配*/
+     if(pos == end){
+        break;
+     }
+     /*匹配*/
+     if(end - pos < 2){
+        return -1;
+     }
+     offset = (uint32_t)pos[0] | (uint32_t)pos[1] << 8;
+     pos += 2;
+     length = token & 0x0F;
+     if(length == 15 && lz_read_length(&pos,end,&length) != 0){
+        return -1;
+     }
+     length += LZ_MIN_MATCH;
+     total = output.offset + output.used;
+     if(offset == 0 || offset > total || length > header.raw_size - total){
+        return -1;
+     }
+     match = total - offset;
+     while(length > 0){
+        /*已输出到flash的数据直接读取 其余的在缓存中*/
+        if(match < output.offset){
+           byte = output.dst_base[match];
+        }else{
+           byte = output.buffer[match - output.offset];
+        }
+        if(lz_output_byte(&output,byte) != 0){
+           return -1;
+        }
+        match ++;
+        length --;
+     }
+  }
+  
+  if(output.offset + output.used != header.raw_size){
+     return -1;
+  }
+  /*输出剩余数据 缓存剩余部分补0xFF*/
+  if(output.used > 0){
+     memset(output.buffer + output.used,0xFF,output.buffer_size - output.used);
+     if(write(output.offset,output.buffer,output.used) != 0){
+        return -1;
+     }
+  }
+  
+  return 0;
+}
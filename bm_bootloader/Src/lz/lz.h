@@ -0,0 +1,65 @@
+#ifndef  __LZ_H__
+#define  __LZ_H__
+#include "stdint.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+/*压缩格式：lz_header_t + LZ4块格式的序列
+* 序列：token(高4位字面量长度 低4位匹配长度-4，15表示后续有255累加的扩展长度)
+*       字面量 2字节小端匹配偏移
+* 最后一个序列只有字面量。匹配偏移指向已经输出的数据，已经写入flash的部分直接从flash读取，
+* 所以窗口可以覆盖64K而RAM中只需要一个输出缓存。
+*/
+#define  LZ_MAGIC                        0x5A4C4D42U /*"BMLZ"*/
+#define  LZ_VERSION                      1U
+#define  LZ_MIN_MATCH                    4U
+#define  LZ_MAX_OFFSET                   0xFFFFU
+
+typedef struct
+{
+uint32_t magic;      /*LZ_MAGIC*/
+uint32_t version;    /*压缩格式版本*/
+uint32_t raw_size;   /*解压后大小*/
+uint32_t raw_crc;    /*解压后数据crc32*/
+uint32_t data_crc;   /*压缩头之后数据的crc32*/
+}lz_header_t;
+
+/*名称：lz_write_t
+* 功能：输出解压数据 输出后的数据必须可以从dst_base + offset读取
+* 参数：offset 数据在解压数据中的偏移
+* 参数：buffer 数据地址
+* 参数：size   数据大小
+* 返回：0：成功 其他：失败
+*/
+typedef int (*lz_write_t)(uint32_t offset,const uint8_t *buffer,uint32_t size);
+
+
+/*名称：lz_get_header
+* 功能：读取并检查压缩头
+* 参数：src      压缩数据地址
+* 参数：src_size 压缩数据大小
+* 参数：header   压缩头指针
+* 返回：0：成功 其他：不是有效的压缩数据
+*/
+int lz_get_header(const uint8_t *src,uint32_t src_size,lz_header_t *header);
+
+/*名称：lz_decompress
+* 功能：流式解压 解压数据先写入缓存，缓存满后调用write输出
+* 参数：src         压缩数据地址
+* 参数：src_size    压缩数据大小
+* 参数：dst_base    已输出数据的读取地址
+* 参数：buffer      输出缓存
+* 参数：buffer_size 输出缓存大小 除最后一次外每次输出的大小
+* 参数：write       输出函数
+* 返回：0：成功 其他：失败
+*/
+int lz_decompress(const uint8_t *src,uint32_t src_size,const uint8_t *dst_base,uint8_t *buffer,uint32_t buffer_size,lz_write_t write);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
@@ -46,6 +46,7 @@
 /* USER CODE BEGIN Includes */
 #include "log.h"
 #include "bootloader.h"
+#include "boot_timeline.h"
 /* USER CODE END Includes */
 
 /* Private variables ---------------------------------------------------------*/
@@ -75,6 +76,7 @@ void SystemClock_Config(void);
 int main(void)
 {
   /* USER CODE BEGIN 1 */
+  boot_timeline_init();
 
   /* USER CODE END 1 */
 
@@ -91,6 +93,7 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
+  boot_timeline_mark(BOOT_TIMELINE_PHASE_CLOCK_INIT);
 
   /* USER CODE END SysInit */
 
@@ -100,6 +103,7 @@ int main(void)
   //MX_IWDG_Init();
   /* USER CODE BEGIN 2 */
   log_init();
+  boot_timeline_mark(BOOT_TIMELINE_PHASE_LOG_INIT);
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -0,0 +1,163 @@
+#include "string.h"
+#include "sha256.h"
+
+/*循环右移 Cortex-M3上编译为一条ROR指令*/
+#define  ROR(x,n)          (((x) >> (n)) | ((x) << (32 - (n))))
+#define  CH(x,y,z)         ((z) ^ ((x) & ((y) ^ (z))))
+#define  MAJ(x,y,z)        (((x) & (y)) | ((z) & ((x) | (y))))
+#define  SIGMA0(x)         (ROR(x,2) ^ ROR(x,13) ^ ROR(x,22))
+#define  SIGMA1(x)         (ROR(x,6) ^ ROR(x,11) ^ ROR(x,25))
+#define  GAMMA0(x)         (ROR(x,7) ^ ROR(x,18) ^ ((x) >> 3))
+#define  GAMMA1(x)         (ROR(x,17) ^ ROR(x,19) ^ ((x) >> 10))
+
+/*一轮 不移动8个工作变量 由调用时轮换参数代替*/
+#define  ROUND(a,b,c,d,e,f,g,h,i)                                     \
+do{                                                                   \
+  h += SIGMA1(e) + CH(e,f,g) + sha256_k[i] + w[(i) & 15];              \
+  d += h;                                                             \
+  h += SIGMA0(a) + MAJ(a,b,c);                                        \
+}while(0)
+
+/*第16轮之后的消息扩展 只保留16个字的窗口*/
+#define  EXPAND(i)         (w[(i) & 15] += GAMMA1(w[((i) - 2) & 15]) + w[((i) - 7) & 15] + GAMMA0(w[((i) - 15) & 15]))
+
+static const uint32_t sha256_k[64] = {
+0x428a2f98U,0x71374491U,0xb5c0fbcfU,0xe9b5dba5U,0x3956c25bU,0x59f111f1U,0x923f82a4U,0xab1c5ed5U,
+0xd807aa98U,0x12835b01U,0x243185beU,0x550c7dc3U,0x72be5d74U,0x80deb1feU,0x9bdc06a7U,0xc19bf174U,
+0xe49b69c1U,0xefbe4786U,0x0fc19dc6U,0x240ca1ccU,0x2de92c6fU,0x4a7484aaU,0x5cb0a9dcU,0x76f988daU,
+0x983e5152U,0xa831c66dU,0xb00327c8U,0xbf597fc7U,0xc6e00bf3U,0xd5a79147U,0x06ca6351U,0x14292967U,
+0x27b70a85U,0x2e1b2138U,0x4d2c6dfcU,0x53380d13U,0x650a7354U,0x766a0abbU,0x81c2c92eU,0x92722c85U,
+0xa2bfe8a1U,0xa81a664bU,0xc24b8b70U,0xc76c51a3U,0xd192e819U,0xd6990624U,0xf40e3585U,0x106aa070U,
+0x19a4c116U,0x1e376c08U,0x2748774cU,0x34b0bcb5U,0x391c0cb3U,0x4ed8aa4aU,0x5b9cca4fU,0x682e6ff3U,
+0x748f82eeU,0x78a5636fU,0x84c87814U,0x8cc70208U,0x90befffaU,0xa4506cebU,0xbef9a3f7U,0xc67178f2U
+};
+
+/*名称：sha256_transform
+* 功能：处理一块数据 每8轮展开一次 工作变量全部放在寄存器中
+* 参数：state  当前状态
+* 参数：block  64字节数据
+* 返回：无
+*/
+static void sha256_transform(uint32_t *state,const uint8_t *block)
+{
+  uint32_t a,b,c,d,e,f,g,h;
+  uint32_t w[16];
+  uint32_t i;
+  
+  for(i = 0; i < 16; i++){
+     w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 | (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+  }
+  
+  a = state[0];b = state[1];c = state[2];d = state[3];
+  e = state[4];f = state[5];g = state[6];h = state[7];
+  
+  for(i = 0; i < 64; i += 8){
+     if(i >= 16){
+        EXPAND(i);EXPAND(i + 1);EXPAND(i + 2);EXPAND(i + 3);
+        EXPAND(i + 4);EXPAND(i + 5);EXPAND(i + 6);EXPAND(i + 7);
+     }
+     ROUND(a,b,c,d,e,f,g,h,i);
+     ROUND(h,a,b,c,d,e,f,g,i + 1);
+     ROUND(g,h,a,b,c,d,e,f,i + 2);
+     ROUND(f,g,h,a,b,c,d,e,i + 3);
+     ROUND(e,f,g,h,a,b,c,d,i + 4);
+     ROUND(d,e,f,g,h,a,b,c,i + 5);
+     ROUND(c,d,e,f,g,h,a,b,i + 6);
+     ROUND(b,c,d,e,f,g,h,a,i + 7);
+  }
+  
+  state[0] += a;state[1] += b;state[2] += c;state[3] += d;
+  state[4] += e;state[5] += f;state[6] += g;state[7] += h;
+}
+
+/*名称：sha256_init
+* 功能：开始新的计算
+* 参数：ctx 计算上下文
+* 返回：无
+*/
+void sha256_init(sha256_ctx_t *ctx)
+{
+  ctx->state[0] = 0x6a09e667U;
+  ctx->state[1] = 0xbb67ae85U;
+  ctx->state[2] = 0x3c6ef372U;
+  ctx->state[3] = 0xa54ff53aU;
+  ctx->state[4] = 0x510e527fU;
+  ctx->state[5] = 0x9b05688cU;
+  ctx->state[6] = 0x1f83d9abU;
+  ctx->state[7] = 0x5be0cd19U;
+  ctx->total = 0;
+}
+
+/*名称：sha256_update
+* 功能：继续输入一段数据 可以分多次输入
+* 参数：ctx    计算上下文
+* 参数：buffer 数据地址
+* 参数：size   数据大小
+* 返回：无
+*/
+void sha256_update(sha256_ctx_t *ctx,const void *buffer,uint32_t size)
+{
+  const uint8_t *pos = (const uint8_t *)buffer;
+  uint32_t used,fill;
+  
+  used = ctx->total % SHA256_BLOCK_SIZE;
+  ctx->total += size;
+  
+  /*先补满上次剩下的块*/
+  if(used > 0){
+     fill = SHA256_BLOCK_SIZE - used;
+     if(size < fill){
+        memcpy(ctx->block + used,pos,size);
+        return;
+     }
+     memcpy(ctx->block + used,pos,fill);
+     sha256_transform(ctx->state,ctx->block);
+     pos += fill;
+     size -= fill;
+  }
+  /*整块直接从源地址计算 不复制*/
+  while(size >= SHA256_BLOCK_SIZE){
+     sha256_transform(ctx->state,pos);
+     pos += SHA256_BLOCK_SIZE;
+     size -= SHA256_BLOCK_SIZE;
+  }
+  memcpy(ctx->block,pos,size);
+}
+
+/*名称：sha256_final
+* 功能：结束计算 输出摘要
+* 参数：ctx    计算上下文
+* 参数：digest 摘要 SHA256_DIGEST_SIZE字节
+* 返回：无
+*/
+void sha256_final(sha256_ctx_t *ctx,uint8_t *digest)
+{
+  uint32_t used;
+  uint32_t bits_hi,bits_lo;
+  uint8_t i;
+  
+  used = ctx->total % SHA256_BLOCK_SIZE;
+  ctx->block[used++] = 0x80;
+  if(used > SHA256_BLOCK_SIZE - 8){
+     memset(ctx->block + used,0,SHA256_BLOCK_SIZE - used);
+     sha256_transform(ctx->state,ctx->block);
+     used = 0;
+  }
+  memset(ctx->block + used,0,SHA256_BLOCK_SIZE - 8 - used);
+  
+  /*数据长度 单位：位 大端*/
+  bits_hi = ctx->total >> 29;
+  bits_lo = ctx->total << 3;
+  for(i = 0; i < 4; i++){
+     ctx->block[SHA256_BLOCK_SIZE - 8 + i] = (uint8_t)(bits_hi >> (24 - i * 8));
+     ctx->block[SHA256_BLOCK_SIZE - 4 + i] = (uint8_t)(bits_lo >> (24 - i * 8));
+  }
+  sha256_transform(ctx->state,ctx->block);
+  
+  for(i = 0; i < 8; i++){
+     digest[i * 4]     = (uint8_t)(ctx->state[i] >> 24);
+     digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+     digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+     digest[i * 4 + 3] = (uint8_t)(ctx->state[i]);
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef  __SHA256_H__
+#define  __SHA256_H__
+#include "stdint.h"
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+#define  SHA256_BLOCK_SIZE               64
+#define  SHA256_DIGEST_SIZE              32
+
+typedef struct
+{
+uint32_t state[8];
+uint32_t total;                        /*已输入的字节数*/
+uint8_t  block[SHA256_BLOCK_SIZE];     /*不足一块的数据*/
+}sha256_ctx_t;
+
+
+/*名称：sha256_init
+* 功能：开始新的计算
+* 参数：ctx 计算上下文
+* 返回：无
+*/
+void sha256_init(sha256_ctx_t *ctx);
+
+/*名称：sha256_update
+* 功能：继续输入一段数据 可以分多次输入
+* 参数：ctx    计算上下文
+* 参数：buffer 数据地址
+* 参数：size   数据大小
+* 返回：无
+*/
+void sha256_update(sha256_ctx_t *ctx,const void *buffer,uint32_t size);
+
+/*名称：sha256_final
+* 功能：结束计算 输出摘要
+* 参数：ctx    计算上下文
+* 参数：digest 摘要 SHA256_DIGEST_SIZE字节
+* 返回：无
+*/
+void sha256_final(sha256_ctx_t *ctx,uint8_t *digest);
+
+
+#ifdef __cplusplus
+    }
+#endif
+
+#endif
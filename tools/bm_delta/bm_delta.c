@@ -0,0 +1,277 @@
+/*****************************************************************************
+*  bm_delta 补丁生成工具(主机端)
+*
+*  编译：make 或 gcc -O2 -I../../bm_bootloader/Src/delta -I../../bm_bootloader/Src/crc32 -o bm_delta bm_delta.c ../../bm_bootloader/Src/delta/delta.c ../../bm_bootloader/Src/crc32/crc32.c
+*  生成：bm_delta diff  原固件.bin 新固件.bin 补丁.bin
+*  应用：bm_delta apply 原固件.bin 补丁.bin 新固件.bin
+*  测试：make test 用test/中的固件和空文件、1字节文件生成补丁再应用 比较结果
+*
+*  生成补丁后会用bootloader相同的delta_apply重新生成新固件并比较，保证补丁可用。
+*  补丁写入更新区，env中fw_update.size填写补丁大小。补丁不能大于bootloader的交换区。
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "delta.h"
+#include "crc32.h"
+
+#define  HASH_BITS          16
+#define  HASH_SIZE          (1 << HASH_BITS)
+#define  HASH_BUCKET_DEPTH  8
+#define  MIN_MATCH          8
+#define  APPLY_BUFFER_SIZE  0x800
+
+typedef struct
+{
+uint8_t *data;
+uint32_t size;
+uint32_t capacity;
+}buffer_t;
+
+static uint32_t hash_table[HASH_SIZE][HASH_BUCKET_DEPTH];
+static uint8_t  hash_count[HASH_SIZE];
+
+static uint8_t *apply_output;
+static uint32_t apply_output_size;
+
+static uint8_t *read_file(const char *name,uint32_t *size)
+{
+  FILE *file;
+  uint8_t *data;
+  long len;
+
+  file = fopen(name,"rb");
+  if(file == NULL){
+     perror(name);
+     exit(1);
+  }
+  fseek(file,0,SEEK_END);
+  len = ftell(file);
+  fseek(file,0,SEEK_SET);
+  data = malloc(len + 1);
+  if(data == NULL || fread(data,1,len,file) != (size_t)len){
+     fprintf(stderr,"read %s err.\n",name);
+     exit(1);
+  }
+  fclose(file);
+  *size = (uint32_t)len;
+  return data;
+}
+
+static void write_file(const char *name,const uint8_t *data,uint32_t size)
+{
+  FILE *file;
+
+  file = fopen(name,"wb");
+  if(file == NULL || fwrite(data,1,size,file) != size){
+     perror(name);
+     exit(1);
+  }
+  fclose(file);
+}
+
+static void buffer_put(buffer_t *buffer,const uint8_t *data,uint32_t size)
+{
+  if(buffer->size + size > buffer->capacity){
+     buffer->capacity = (buffer->size + size) * 2;
+     buffer->data = realloc(buffer->data,buffer->capacity);
+     if(buffer->data == NULL){
+        fprintf(stderr,"out of memory.\n");
+        exit(1);
+     }
+  }
+  memcpy(buffer->data + buffer->size,data,size);
+  buffer->size += size;
+}
+
+static void buffer_put_varint(buffer_t *buffer,uint32_t value)
+{
+  uint8_t byte;
+
+  do{
+     byte = value & 0x7F;
+     value >>= 7;
+     if(value){
+        byte |= 0x80;
+     }
+     buffer_put(buffer,&byte,1);
+  }while(value);
+}
+
+static uint32_t hash4(const uint8_t *data)
+{
+  uint32_t value;
+
+  memcpy(&value,data,4);
+  return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static uint32_t match_length(const uint8_t *old,uint32_t old_size,uint32_t old_pos,const uint8_t *new,uint32_t new_size,uint32_t new_pos)
+{
+  uint32_t len = 0;
+
+  while(old_pos + len < old_size && new_pos + len < new_size && old[old_pos + len] == new[new_pos + len]){
+     len++;
+  }
+  return len;
+}
+
+static void emit_data(buffer_t *patch,const uint8_t *data,uint32_t size)
+{
+  uint8_t cmd = DELTA_CMD_DATA;
+
+  if(size == 0){
+     return;
+  }
+  buffer_put(patch,&cmd,1);
+  buffer_put_varint(patch,size);
+  buffer_put(patch,data,size);
+}
+
+static void emit_copy(buffer_t *patch,uint32_t offset,uint32_t size)
+{
+  uint8_t cmd = DELTA_CMD_COPY;
+
+  buffer_put(patch,&cmd,1);
+  buffer_put_varint(patch,offset);
+  buffer_put_varint(patch,size);
+}
+
+/*贪心匹配：每个位置在原固件的4字节哈希桶中找最长匹配，同时尝试紧接上一次复制的位置*/
+static void diff(const uint8_t *old,uint32_t old_size,const uint8_t *new,uint32_t new_size,buffer_t *patch)
+{
+  uint32_t i,j,h,pos,len,best_len,best_pos,literal_start,next_old = 0;
+
+  for(i = 0; i + 4 <= old_size; i++){
+     h = hash4(old + i);
+     hash_table[h][hash_count[h] % HASH_BUCKET_DEPTH] = i;
+     hash_count[h]++;
+  }
+
+  literal_start = 0;
+  i = 0;
+  while(i < new_size){
+     best_len = 0;
+     best_pos = 0;
+     if(next_old < old_size){
+        best_len = match_length(old,old_size,next_old,new,new_size,i);
+        best_pos = next_old;
+     }
+     if(i + 4 <= new_size){
+        h = hash4(new + i);
+        for(j = 0; j < HASH_BUCKET_DEPTH && j < hash_count[h]; j++){
+           pos = hash_table[h][j];
+           len = match_length(old,old_size,pos,new,new_size,i);
+           if(len > best_len){
+              best_len = len;
+              best_pos = pos;
+           }
+        }
+     }
+     if(best_len >= MIN_MATCH){
+        emit_data(patch,new + literal_start,i - literal_start);
+        emit_copy(patch,best_pos,best_len);
+        i += best_len;
+        next_old = best_pos + best_len;
+        literal_start = i;
+     }else{
+        i++;
+        next_old++;
+     }
+  }
+  emit_data(patch,new + literal_start,i - literal_start);
+}
+
+static int apply_write(uint32_t offset,const uint8_t *buffer,uint32_t size)
+{
+  if(offset + size > apply_output_size){
+     return -1;
+  }
+  memcpy(apply_output + offset,buffer,size);
+  return 0;
+}
+
+/*与bootloader相同的方式应用补丁*/
+static int apply(const uint8_t *old,uint32_t old_size,const uint8_t *patch,uint32_t patch_size,uint8_t **new,uint32_t *new_size)
+{
+  delta_header_t header;
+  uint8_t buffer[APPLY_BUFFER_SIZE];
+
+  if(delta_get_header(patch,patch_size,&header) != 0){
+     fprintf(stderr,"invalid patch.\n");
+     return -1;
+  }
+  if(header.old_size != old_size || crc32_calculate(old,old_size) != header.old_crc){
+     fprintf(stderr,"patch does not match old fw.\n");
+     return -1;
+  }
+  if(crc32_calculate(patch + sizeof(header),patch_size - sizeof(header)) != header.patch_crc){
+     fprintf(stderr,"patch crc err.\n");
+     return -1;
+  }
+  /*最后一块按整块输出*/
+  apply_output_size = (header.new_size + APPLY_BUFFER_SIZE - 1) / APPLY_BUFFER_SIZE * APPLY_BUFFER_SIZE;
+  apply_output = malloc(apply_output_size);
+  if(apply_output == NULL || delta_apply(patch,patch_size,old,old_size,buffer,APPLY_BUFFER_SIZE,apply_write) != 0){
+     fprintf(stderr,"apply patch err.\n");
+     return -1;
+  }
+  if(crc32_calculate(apply_output,header.new_size) != header.new_crc){
+     fprintf(stderr,"new fw crc err.\n");
+     return -1;
+  }
+  *new = apply_output;
+  *new_size = header.new_size;
+  return 0;
+}
+
+int main(int argc,char *argv[])
+{
+  uint8_t *old,*new,*patch,*output;
+  uint32_t old_size,new_size,patch_size,output_size;
+  buffer_t buffer = {0};
+  delta_header_t header;
+
+  if(argc == 5 && strcmp(argv[1],"diff") == 0){
+     old = read_file(argv[2],&old_size);
+     new = read_file(argv[3],&new_size);
+     memset(&header,0,sizeof(header));
+     buffer_put(&buffer,(uint8_t *)&header,sizeof(header));
+     diff(old,old_size,new,new_size,&buffer);
+
+     header.magic = DELTA_MAGIC;
+     header.version = DELTA_VERSION;
+     header.old_size = old_size;
+     header.old_crc = crc32_calculate(old,old_size);
+     header.new_size = new_size;
+     header.new_crc = crc32_calculate(new,new_size);
+     header.patch_crc = crc32_calculate(buffer.data + sizeof(header),buffer.size - sizeof(header));
+     memcpy(buffer.data,&header,sizeof(header));
+
+     /*校验补丁*/
+     if(apply(old,old_size,buffer.data,buffer.size,&output,&output_size) != 0 ||
+        output_size != new_size || memcmp(output,new,new_size) != 0){
+        fprintf(stderr,"patch verify err.\n");
+        return 1;
+     }
+     write_file(argv[4],buffer.data,buffer.size);
+     printf("old:%u new:%u patch:%u (%.1f%%)\n",old_size,new_size,buffer.size,new_size > 0 ? buffer.size * 100.0 / new_size : 0.0);
+     return 0;
+  }
+
+  if(argc == 5 && strcmp(argv[1],"apply") == 0){
+     old = read_file(argv[2],&old_size);
+     patch = read_file(argv[3],&patch_size);
+     if(apply(old,old_size,patch,patch_size,&output,&output_size) != 0){
+        return 1;
+     }
+     write_file(argv[4],output,output_size);
+     printf("new:%u\n",output_size);
+     return 0;
+  }
+
+  fprintf(stderr,"usage: %s diff old.bin new.bin patch.bin\n"
+                 "       %s apply old.bin patch.bin new.bin\n",argv[0],argv[0]);
+  return 1;
+}
@@ -0,0 +1,132 @@
+/*****************************************************************************
+*  bm_image 固件头填写工具(主机端)
+*
+*  编译：gcc -O2 -I../../bm_bootloader/Src/bootloader_if -I../../bm_bootloader/Src/crc32 -o bm_image bm_image.c ../../bm_bootloader/Src/crc32/crc32.c
+*  填写：bm_image 固件.bin 输出.bin 版本 序号 [标志]
+*        标志：1 覆盖升级(BOOTLOADER_IMAGE_FLAG_OVERWRITE) 不保留原固件 不能回滚
+*
+*  应用程序在固件偏移BOOTLOADER_IMAGE_HEADER_OFFSET处保留sizeof(bootloader_image_header_t)
+*  字节(内容为0xFF)，工具根据复位向量判断固件是为用户区还是更新区链接的，填写固件头。
+*  固件头中的crc是整个固件(跳过crc字段)的crc32，bootloader每次启动和交换前都会校验。
+*  直接运行模式下，两个区的固件各自链接，序号必须比正在运行的固件大。
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "bootloader_if.h"
+#include "crc32.h"
+
+static uint8_t *read_file(const char *name,uint32_t *size)
+{
+  FILE *file;
+  uint8_t *data;
+  long len;
+
+  file = fopen(name,"rb");
+  if(file == NULL){
+     perror(name);
+     exit(1);
+  }
+  fseek(file,0,SEEK_END);
+  len = ftell(file);
+  fseek(file,0,SEEK_SET);
+  data = malloc(len + 1);
+  if(data == NULL || fread(data,1,len,file) != (size_t)len){
+     fprintf(stderr,"read %s err.\n",name);
+     exit(1);
+  }
+  fclose(file);
+  *size = (uint32_t)len;
+  return data;
+}
+
+static void write_file(const char *name,const uint8_t *data,uint32_t size)
+{
+  FILE *file;
+
+  file = fopen(name,"wb");
+  if(file == NULL || fwrite(data,1,size,file) != size){
+     perror(name);
+     exit(1);
+  }
+  fclose(file);
+}
+
+/*根据复位向量找到固件链接的区*/
+static uint32_t get_slot(uint32_t reset_handler,uint32_t *slot_size)
+{
+  uint32_t user,update;
+
+  user = BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET;
+  update = BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET;
+  if(reset_handler >= user && reset_handler < user + BOOTLOADER_FLASH_USER_APPLICATION_SIZE){
+     *slot_size = BOOTLOADER_FLASH_USER_APPLICATION_SIZE;
+     return user;
+  }
+  if(reset_handler >= update && reset_handler < update + BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE){
+     *slot_size = BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE;
+     return update;
+  }
+  return 0;
+}
+
+int main(int argc,char *argv[])
+{
+  uint8_t *image;
+  uint32_t size,msp,reset_handler,slot,slot_size,crc_offset,i;
+  bootloader_image_header_t header;
+
+  if(argc != 5 && argc != 6){
+     fprintf(stderr,"usage: bm_image image.bin out.bin version sequence [flags]\n");
+     return 1;
+  }
+  image = read_file(argv[1],&size);
+  if(size <= BOOTLOADER_IMAGE_HEADER_OFFSET + sizeof(header)){
+     fprintf(stderr,"image too small.\n");
+     return 1;
+  }
+  memcpy(&msp,image,4);
+  memcpy(&reset_handler,image + 4,4);
+  slot = get_slot(reset_handler,&slot_size);
+  if(slot == 0){
+     fprintf(stderr,"reset handler 0x%X is not in user or update slot.\n",reset_handler);
+     return 1;
+  }
+  if(size > slot_size){
+     fprintf(stderr,"image size %u is large than slot size %u.\n",size,slot_size);
+     return 1;
+  }
+  if(msp <= BOOTLOADER_SRAM_BASE_ADDR || msp > BOOTLOADER_SRAM_SHARED_ADDR){
+     fprintf(stderr,"stack pointer 0x%X is not in sram or overlaps shared area 0x%X.\n",msp,BOOTLOADER_SRAM_SHARED_ADDR);
+     return 1;
+  }
+  /*固件头位置必须是保留的空白区或者已经填写过的固件头*/
+  memcpy(&header,image + BOOTLOADER_IMAGE_HEADER_OFFSET,sizeof(header));
+  if(header.magic != BOOTLOADER_IMAGE_MAGIC){
+     for(i = 0; i < sizeof(header); i++){
+        if(image[BOOTLOADER_IMAGE_HEADER_OFFSET + i] != 0xFF){
+           fprintf(stderr,"no space reserved for image header at 0x%X.\n",BOOTLOADER_IMAGE_HEADER_OFFSET);
+           return 1;
+        }
+     }
+  }
+  memset(&header,0xFF,sizeof(header));
+  header.magic = BOOTLOADER_IMAGE_MAGIC;
+  header.load_addr = slot;
+  header.size = size;
+  header.version = (uint32_t)strtoul(argv[3],NULL,0);
+  header.sequence = (uint32_t)strtoul(argv[4],NULL,0);
+  header.flags = argc == 6 ? (uint32_t)strtoul(argv[5],NULL,0) : 0;
+  memcpy(image + BOOTLOADER_IMAGE_HEADER_OFFSET,&header,sizeof(header));
+  /*crc覆盖整个固件 跳过crc字段*/
+  crc_offset = BOOTLOADER_IMAGE_HEADER_OFFSET + offsetof(bootloader_image_header_t,crc);
+  header.crc = crc32_update(CRC32_INIT_VALUE,image,crc_offset);
+  header.crc = crc32_update(header.crc,image + crc_offset + 4,size - crc_offset - 4);
+  memcpy(image + BOOTLOADER_IMAGE_HEADER_OFFSET,&header,sizeof(header));
+  write_file(argv[2],image,size);
+
+  printf("slot:0x%08X size:%u version:0x%X sequence:%u flags:0x%X crc:0x%08X\n",header.load_addr,header.size,header.version,header.sequence,header.flags,header.crc);
+  return 0;
+}
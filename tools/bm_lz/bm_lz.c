@@ -0,0 +1,267 @@
+/*****************************************************************************
+*  bm_lz 固件压缩工具(主机端)
+*
+*  编译：gcc -O2 -I../../bm_bootloader/Src/lz -o bm_lz bm_lz.c ../../bm_bootloader/Src/lz/lz.c
+*  压缩：bm_lz c 固件.bin 压缩包.bin
+*  解压：bm_lz d 压缩包.bin 固件.bin
+*  测速：bm_lz b 压缩包.bin  用bootloader相同的lz_decompress测试解压速度，并和flash编程速度比较
+*
+*  压缩后会用lz_decompress解压并比较，保证压缩包可用。
+*  压缩包写入更新区，env中fw_update.size填写压缩包大小。
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "lz.h"
+
+#define  HASH_BITS              15
+#define  HASH_SIZE              (1 << HASH_BITS)
+#define  MAX_CHAIN              64
+#define  OUTPUT_BUFFER_SIZE     0x800
+#define  FLASH_HALFWORD_TIME_US 52.0  /*STM32F1半字编程典型耗时*/
+
+static int32_t hash_head[HASH_SIZE];
+static int32_t *hash_prev;
+
+static uint8_t *output;
+static uint32_t output_size;
+
+/*与bootloader的crc32_update相同：STM32F1硬件CRC算法 按小端字输入 不足一个字补0xFF*/
+static uint32_t crc32(const uint8_t *buffer,uint32_t size)
+{
+  uint32_t crc = 0xFFFFFFFFU,word,i;
+  int bit;
+
+  for(i = 0; i < size; i += 4){
+     word = 0xFFFFFFFFU;
+     memcpy(&word,buffer + i,size - i >= 4 ? 4 : size - i);
+     crc ^= word;
+     for(bit = 0; bit < 32; bit++){
+        crc = crc & 0x80000000U ? (crc << 1) ^ 0x04C11DB7U : crc << 1;
+     }
+  }
+  return crc;
+}
+
+static uint8_t *read_file(const char *name,uint32_t *size)
+{
+  FILE *file;
+  uint8_t *data;
+  long len;
+
+  file = fopen(name,"rb");
+  if(file == NULL){
+     perror(name);
+     exit(1);
+  }
+  fseek(file,0,SEEK_END);
+  len = ftell(file);
+  fseek(file,0,SEEK_SET);
+  data = malloc(len + 1);
+  if(data == NULL || fread(data,1,len,file) != (size_t)len){
+     fprintf(stderr,"read %s err.\n",name);
+     exit(1);
+  }
+  fclose(file);
+  *size = (uint32_t)len;
+  return data;
+}
+
+static void write_file(const char *name,const uint8_t *data,uint32_t size)
+{
+  FILE *file;
+
+  file = fopen(name,"wb");
+  if(file == NULL || fwrite(data,1,size,file) != size){
+     perror(name);
+     exit(1);
+  }
+  fclose(file);
+}
+
+static uint32_t hash4(const uint8_t *data)
+{
+  uint32_t value;
+
+  memcpy(&value,data,4);
+  return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static uint8_t *put_length(uint8_t *dst,uint32_t length)
+{
+  while(length >= 255){
+     *dst++ = 255;
+     length -= 255;
+  }
+  *dst++ = (uint8_t)length;
+  return dst;
+}
+
+static uint8_t *put_sequence(uint8_t *dst,const uint8_t *literal,uint32_t literal_len,uint32_t offset,uint32_t match_len)
+{
+  uint8_t *token = dst++;
+  uint32_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+
+  *token = (uint8_t)((literal_len >= 15 ? 15 : literal_len) << 4);
+  if(literal_len >= 15){
+     dst = put_length(dst,literal_len - 15);
+  }
+  memcpy(dst,literal,literal_len);
+  dst += literal_len;
+  if(match_len == 0){
+     return dst;
+  }
+  *dst++ = (uint8_t)offset;
+  *dst++ = (uint8_t)(offset >> 8);
+  *token |= (uint8_t)(match_code >= 15 ? 15 : match_code);
+  if(match_code >= 15){
+     dst = put_length(dst,match_code - 15);
+  }
+  return dst;
+}
+
+/*贪心哈希链匹配 窗口64K*/
+static uint32_t compress(const uint8_t *src,uint32_t size,uint8_t *dst)
+{
+  uint8_t *pos = dst;
+  uint32_t i = 0,literal_start = 0,h,len,best_len,best_offset,chain;
+  int32_t candidate;
+
+  memset(hash_head,0xFF,sizeof(hash_head));
+  hash_prev = malloc(sizeof(int32_t) * (size + 1));
+  while(i + LZ_MIN_MATCH <= size){
+     h = hash4(src + i);
+     best_len = 0;
+     best_offset = 0;
+     for(candidate = hash_head[h],chain = 0; candidate >= 0 && i - candidate <= LZ_MAX_OFFSET && chain < MAX_CHAIN; candidate = hash_prev[candidate],chain++){
+        len = 0;
+        while(i + len < size && src[candidate + len] == src[i + len]){
+           len++;
+        }
+        if(len > best_len){
+           best_len = len;
+           best_offset = i - candidate;
+        }
+     }
+     hash_prev[i] = hash_head[h];
+     hash_head[h] = i;
+     if(best_len >= LZ_MIN_MATCH){
+        pos = put_sequence(pos,src + literal_start,i - literal_start,best_offset,best_len);
+        /*匹配内的位置也加入哈希链*/
+        for(len = 1; len < best_len && i + len + LZ_MIN_MATCH <= size; len++){
+           h = hash4(src + i + len);
+           hash_prev[i + len] = hash_head[h];
+           hash_head[h] = i + len;
+        }
+        i += best_len;
+        literal_start = i;
+     }else{
+        i++;
+     }
+  }
+  pos = put_sequence(pos,src + literal_start,size - literal_start,0,0);
+  free(hash_prev);
+  return (uint32_t)(pos - dst);
+}
+
+static int output_write(uint32_t offset,const uint8_t *buffer,uint32_t size)
+{
+  if(offset + size > output_size){
+     return -1;
+  }
+  memcpy(output + offset,buffer,size);
+  return 0;
+}
+
+/*与bootloader相同的方式解压*/
+static int decompress(const uint8_t *src,uint32_t size)
+{
+  lz_header_t header;
+  uint8_t buffer[OUTPUT_BUFFER_SIZE];
+
+  if(lz_get_header(src,size,&header) != 0){
+     fprintf(stderr,"invalid lz file.\n");
+     return -1;
+  }
+  if(crc32(src + sizeof(header),size - sizeof(header)) != header.data_crc){
+     fprintf(stderr,"lz data crc err.\n");
+     return -1;
+  }
+  free(output);
+  output_size = (header.raw_size + OUTPUT_BUFFER_SIZE - 1) / OUTPUT_BUFFER_SIZE * OUTPUT_BUFFER_SIZE;
+  output = malloc(output_size + 1);
+  if(lz_decompress(src,size,output,buffer,OUTPUT_BUFFER_SIZE,output_write) != 0 ||
+     crc32(output,header.raw_size) != header.raw_crc){
+     fprintf(stderr,"decompress err.\n");
+     return -1;
+  }
+  output_size = header.raw_size;
+  return 0;
+}
+
+int main(int argc,char *argv[])
+{
+  uint8_t *src,*dst;
+  uint32_t size,dst_size,i,loops;
+  lz_header_t header;
+  clock_t start;
+  double seconds,rate;
+
+  if(argc == 4 && strcmp(argv[1],"c") == 0){
+     src = read_file(argv[2],&size);
+     dst = malloc(sizeof(header) + size + size / 255 + 16);
+     dst_size = sizeof(header) + compress(src,size,dst + sizeof(header));
+     header.magic = LZ_MAGIC;
+     header.version = LZ_VERSION;
+     header.raw_size = size;
+     header.raw_crc = crc32(src,size);
+     header.data_crc = crc32(dst + sizeof(header),dst_size - sizeof(header));
+     memcpy(dst,&header,sizeof(header));
+     /*校验压缩包*/
+     if(decompress(dst,dst_size) != 0 || output_size != size || memcmp(output,src,size) != 0){
+        fprintf(stderr,"lz verify err.\n");
+        return 1;
+     }
+     write_file(argv[3],dst,dst_size);
+     printf("raw:%u lz:%u (%.1f%%)\n",size,dst_size,dst_size * 100.0 / size);
+     return 0;
+  }
+
+  if(argc == 4 && strcmp(argv[1],"d") == 0){
+     src = read_file(argv[2],&size);
+     if(decompress(src,size) != 0){
+        return 1;
+     }
+     write_file(argv[3],output,output_size);
+     printf("raw:%u\n",output_size);
+     return 0;
+  }
+
+  if(argc == 3 && strcmp(argv[1],"b") == 0){
+     src = read_file(argv[2],&size);
+     if(decompress(src,size) != 0){
+        return 1;
+     }
+     loops = 0;
+     start = clock();
+     do{
+        for(i = 0; i < 16; i++){
+           decompress(src,size);
+        }
+        loops += 16;
+        seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+     }while(seconds < 1.0);
+     rate = (double)output_size * loops / seconds / 1024.0;
+     printf("decompress:%.0f KB/s\n",rate);
+     printf("flash program:%.1f KB/s (%.0fus per halfword)\n",2.0 / FLASH_HALFWORD_TIME_US * 1000000.0 / 1024.0,FLASH_HALFWORD_TIME_US);
+     printf("staging program:%u bytes instead of %u\n",size,output_size);
+     return 0;
+  }
+
+  fprintf(stderr,"usage: %s c fw.bin fw.lz\n"
+                 "       %s d fw.lz fw.bin\n"
+                 "       %s b fw.lz\n",argv[0],argv[0],argv[0]);
+  return 1;
+}
@@ -0,0 +1,201 @@
+/*****************************************************************************
+*  bm_sign 固件签名工具(主机端)
+*
+*  编译：gcc -O2 -I../../bm_bootloader/Src/bootloader_if -I../../bm_bootloader/Src/sha256
+*            -I../../bm_bootloader/Src/ecdsa -o bm_sign bm_sign.c
+*            ../../bm_bootloader/Src/sha256/sha256.c ../../bm_bootloader/Src/ecdsa/ecdsa.c
+*
+*  密钥和签名由openssl生成，私钥只保存在签名的电脑上：
+*  openssl ecparam -name prime256v1 -genkey -noout -out key.pem
+*  openssl ec -in key.pem -pubout -outform DER -out pub.der
+*  openssl dgst -sha256 -sign key.pem -out sig.der 固件.bin
+*
+*  公钥：bm_sign pubkey pub.der
+*        输出公钥数组，替换bootloader_if.c中的sign_public_key
+*  签名：bm_sign sign 固件.bin sig.der pub.der 输出.bin
+*        固件必须已经用bm_image填写了固件头，工具用bootloader相同的代码验签后
+*        把签名块追加在固件之后(按4字节对齐)，下载的大小是输出文件的大小
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "bootloader_if.h"
+#include "sha256.h"
+#include "ecdsa.h"
+
+static uint8_t *read_file(const char *name,uint32_t *size)
+{
+  FILE *file;
+  uint8_t *data;
+  long len;
+
+  file = fopen(name,"rb");
+  if(file == NULL){
+     perror(name);
+     exit(1);
+  }
+  fseek(file,0,SEEK_END);
+  len = ftell(file);
+  fseek(file,0,SEEK_SET);
+  data = malloc(len + sizeof(bootloader_image_sign_t) + 4);
+  if(data == NULL || fread(data,1,len,file) != (size_t)len){
+     fprintf(stderr,"read %s err.\n",name);
+     exit(1);
+  }
+  fclose(file);
+  *size = (uint32_t)len;
+  return data;
+}
+
+static void write_file(const char *name,const uint8_t *data,uint32_t size)
+{
+  FILE *file;
+
+  file = fopen(name,"wb");
+  if(file == NULL || fwrite(data,1,size,file) != size){
+     perror(name);
+     exit(1);
+  }
+  fclose(file);
+}
+
+/*DER格式的公钥最后65字节是 04||x||y*/
+static void read_public_key(const char *name,uint8_t *key)
+{
+  uint8_t *der;
+  uint32_t size;
+
+  der = read_file(name,&size);
+  if(size < ECDSA_P256_KEY_SIZE + 1 || der[size - ECDSA_P256_KEY_SIZE - 1] != 0x04){
+     fprintf(stderr,"%s is not a DER P-256 public key.\n",name);
+     exit(1);
+  }
+  memcpy(key,der + size - ECDSA_P256_KEY_SIZE,ECDSA_P256_KEY_SIZE);
+  free(der);
+}
+
+/*读取DER整数 去掉前导0 右对齐到32字节*/
+static const uint8_t *read_der_integer(const uint8_t *pos,const uint8_t *end,uint8_t *value)
+{
+  uint32_t len;
+
+  if(end - pos < 2 || pos[0] != 0x02){
+     return NULL;
+  }
+  len = pos[1];
+  pos += 2;
+  if(len > (uint32_t)(end - pos)){
+     return NULL;
+  }
+  while(len > 0 && pos[0] == 0x00){
+     pos++;
+     len--;
+  }
+  if(len > 32){
+     return NULL;
+  }
+  memset(value,0,32);
+  memcpy(value + 32 - len,pos,len);
+  return pos + len;
+}
+
+/*DER签名 SEQUENCE{INTEGER r,INTEGER s} 转换为r||s*/
+static void read_signature(const char *name,uint8_t *signature)
+{
+  uint8_t *der;
+  const uint8_t *pos,*end;
+  uint32_t size;
+
+  der = read_file(name,&size);
+  end = der + size;
+  pos = NULL;
+  if(size >= 2 && der[0] == 0x30 && der[1] == size - 2){
+     pos = read_der_integer(der + 2,end,signature);
+     if(pos != NULL){
+        pos = read_der_integer(pos,end,signature + 32);
+     }
+  }
+  if(pos != end){
+     fprintf(stderr,"%s is not a DER ECDSA signature.\n",name);
+     exit(1);
+  }
+  free(der);
+}
+
+static int pubkey(int argc,char *argv[])
+{
+  uint8_t key[ECDSA_P256_KEY_SIZE];
+  int i;
+
+  if(argc != 3){
+     fprintf(stderr,"usage: bm_sign pubkey pub.der\n");
+     return 1;
+  }
+  read_public_key(argv[2],key);
+  for(i = 0; i < ECDSA_P256_KEY_SIZE; i++){
+     printf("0x%02X%s",key[i],i == ECDSA_P256_KEY_SIZE - 1 ? "\n" : (i % 16 == 15 ? ",\n" : ","));
+  }
+  return 0;
+}
+
+static int sign(int argc,char *argv[])
+{
+  uint8_t *image;
+  uint8_t key[ECDSA_P256_KEY_SIZE];
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  uint32_t size;
+  sha256_ctx_t ctx;
+  bootloader_image_header_t header;
+  bootloader_image_sign_t block;
+
+  if(argc != 6){
+     fprintf(stderr,"usage: bm_sign sign image.bin sig.der pub.der out.bin\n");
+     return 1;
+  }
+  image = read_file(argv[2],&size);
+  if(size <= BOOTLOADER_IMAGE_HEADER_OFFSET + sizeof(header)){
+     fprintf(stderr,"image too small.\n");
+     return 1;
+  }
+  memcpy(&header,image + BOOTLOADER_IMAGE_HEADER_OFFSET,sizeof(header));
+  if(header.magic != BOOTLOADER_IMAGE_MAGIC || header.size != size){
+     fprintf(stderr,"image header not found or size err.run bm_image first.\n");
+     return 1;
+  }
+
+  memset(&block,0xFF,sizeof(block));
+  block.magic = BOOTLOADER_IMAGE_SIGN_MAGIC;
+  read_signature(argv[3],block.signature);
+  read_public_key(argv[4],key);
+  sha256_init(&ctx);
+  sha256_update(&ctx,image,size);
+  sha256_final(&ctx,digest);
+  if(ecdsa_p256_verify(key,digest,block.signature) != 0){
+     fprintf(stderr,"signature does not match image or public key.\n");
+     return 1;
+  }
+
+  while(size % 4 != 0){
+     image[size++] = 0xFF;
+  }
+  memcpy(image + size,&block,sizeof(block));
+  size += sizeof(block);
+  write_file(argv[5],image,size);
+
+  printf("image size:%u signed size:%u\n",header.size,size);
+  return 0;
+}
+
+int main(int argc,char *argv[])
+{
+  if(argc >= 2 && strcmp(argv[1],"pubkey") == 0){
+     return pubkey(argc,argv);
+  }
+  if(argc >= 2 && strcmp(argv[1],"sign") == 0){
+     return sign(argc,argv);
+  }
+  fprintf(stderr,"usage: bm_sign pubkey pub.der\n"
+                 "       bm_sign sign image.bin sig.der pub.der out.bin\n");
+  return 1;
+}
@@ -0,0 +1,183 @@
+/*****************************************************************************
+*  crc32_test bootloader中crc32的测试(主机端)
+*
+*  编译：make 或 gcc -O2 -I../../bm_bootloader/Src/crc32 -o crc32_test crc32_test.c ../../bm_bootloader/Src/crc32/crc32.c
+*  运行：make test 或 ./crc32_test
+*
+*  crc32.c按STM32F1硬件CRC单元计算：每个字按小端组成 高位先移入 末尾不足一个字的部分
+*  用0xFF补齐。这里用逐位计算的CRC-32/MPEG-2作为参考模型，它和CRC单元使用相同的多项式
+*  和初值，只是按字节输入：把每个字按大端拆成字节送入就得到CRC单元的结果。模型先用
+*  CRC-32/MPEG-2公开的校验值检查，然后和crc32_update比较：
+*  1.固定的向量和结果 包括1~3字节的0xFF补齐的尾部
+*  2.0~300字节的随机数据 一次输入和按4的倍数分段输入
+*  bm_image和bootloader都链接crc32.c，这个测试同时覆盖固件头中的crc。
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "crc32.h"
+
+#define  MPEG2_CHECK_VALUE  0x0376E6E7U   /*CRC-32/MPEG-2("123456789")*/
+#define  RANDOM_MAX_SIZE    300
+
+typedef struct
+{
+const char *name;
+uint8_t     data[12];
+uint32_t    size;
+uint32_t    crc;
+}test_vector_t;
+
+static const test_vector_t test_vector[] = {
+{"empty",       {0},                                      0,0xFFFFFFFFU},
+{"zero word",   {0x00,0x00,0x00,0x00},                    4,0xC704DD7BU},/*CRC单元复位后写入0x00000000*/
+{"one word",    {0x78,0x56,0x34,0x12},                    4,0xDF8A8A2BU},/*CRC单元复位后写入0x12345678*/
+{"two words",   {0x78,0x56,0x34,0x12,0xEF,0xCD,0xAB,0x90},8,0x36B13E20U},
+{"tail 1",      {0x78,0x56,0x34,0x12,0x5A},               5,0xBE1B0066U},/*第二个字是0xFFFFFF5A*/
+{"tail 2",      {0x78,0x56,0x34,0x12,0x5A,0xA5},          6,0xC5B62A64U},/*第二个字是0xFFFFA55A*/
+{"tail 3",      {0x78,0x56,0x34,0x12,0x5A,0xA5,0x3C},     7,0x5DA2BDADU},/*第二个字是0xFF3CA55A*/
+{"only tail 1", {0x00},                                   1,0xB1F740B4U},
+{"only tail 3", {0x01,0x02,0x03},                         3,0xEE3E0B31U},
+{"ff word",     {0xFF,0xFF,0xFF,0xFF},                    4,0x00000000U},
+};
+
+/*名称：mpeg2_update
+* 功能：逐位计算CRC-32/MPEG-2 多项式0x04C11DB7 高位先移入 不反转 无结果异或
+* 参数：crc  当前crc
+* 参数：byte 输入字节
+* 返回：crc结果
+*/
+static uint32_t mpeg2_update(uint32_t crc,uint8_t byte)
+{
+  int bit;
+
+  crc ^= (uint32_t)byte << 24;
+  for(bit = 0; bit < 8; bit++){
+      crc = crc & 0x80000000U ? (crc << 1) ^ CRC32_POLYNOMIAL : crc << 1;
+  }
+
+  return crc;
+}
+
+/*名称：stm32_crc_model
+* 功能：CRC单元的参考模型 每个字按小端组成 不足一个字补0xFF 再按大端拆成字节计算
+* 参数：buffer 数据
+* 参数：size   数据大小
+* 返回：crc结果
+*/
+static uint32_t stm32_crc_model(const uint8_t *buffer,uint32_t size)
+{
+  uint32_t crc = CRC32_INIT_VALUE,word,i,j;
+  int shift;
+
+  for(i = 0; i < size; i += 4){
+      word = 0xFFFFFFFFU;
+      for(j = 0; j < 4 && i + j < size; j++){
+          word &= ~(0xFFU << (j * 8));
+          word |= (uint32_t)buffer[i + j] << (j * 8);
+      }
+      for(shift = 24; shift >= 0; shift -= 8){
+          crc = mpeg2_update(crc,(uint8_t)(word >> shift));
+      }
+  }
+
+  return crc;
+}
+
+/*名称：test_model
+* 功能：用CRC-32/MPEG-2的校验值检查参考模型
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_model(void)
+{
+  const char *check = "123456789";
+  uint32_t crc = CRC32_INIT_VALUE;
+
+  while(*check != '\0'){
+      crc = mpeg2_update(crc,(uint8_t)*check++);
+  }
+  if(crc != MPEG2_CHECK_VALUE){
+     printf("model check value err: 0x%08X\n",crc);
+     return 1;
+  }
+  printf("model check value ok\n");
+
+  return 0;
+}
+
+/*名称：test_vectors
+* 功能：固定向量 参考模型和crc32_calculate都要等于给定的结果
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_vectors(void)
+{
+  const test_vector_t *v;
+  uint32_t i,want,crc;
+  int fail = 0;
+
+  for(i = 0; i < sizeof(test_vector) / sizeof(test_vector[0]); i++){
+      v = &test_vector[i];
+      want = stm32_crc_model(v->data,v->size);
+      crc = crc32_calculate(v->data,v->size);
+      if(crc != v->crc || want != v->crc){
+         printf("%-12s err: crc32 0x%08X model 0x%08X want 0x%08X\n",v->name,crc,want,v->crc);
+         fail ++;
+      }else{
+         printf("%-12s 0x%08X ok\n",v->name,crc);
+      }
+  }
+
+  return fail;
+}
+
+/*名称：test_random
+* 功能：随机数据 一次输入和按4的倍数分段输入
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_random(void)
+{
+  uint8_t data[RANDOM_MAX_SIZE];
+  uint32_t size,offset,cnt,want,crc;
+  int fail = 0;
+
+  srand(1);
+  for(size = 0; size <= RANDOM_MAX_SIZE; size++){
+      for(offset = 0; offset < size; offset++){
+          data[offset] = (uint8_t)rand();
+      }
+      want = stm32_crc_model(data,size);
+      if(crc32_calculate(data,size) != want){
+         printf("random size %u err\n",size);
+         fail ++;
+      }
+      crc = CRC32_INIT_VALUE;
+      for(offset = 0; offset < size; offset += cnt){
+          cnt = (uint32_t)(rand() % 16 + 1) * 4;
+          cnt = cnt < size - offset ? cnt : size - offset;
+          crc = crc32_update(crc,data + offset,cnt);
+      }
+      if(crc != want){
+         printf("random size %u split err\n",size);
+         fail ++;
+      }
+  }
+  printf("random 0~%u bytes %s\n",RANDOM_MAX_SIZE,fail ? "err" : "ok");
+
+  return fail;
+}
+
+int main(void)
+{
+  int fail = 0;
+
+  fail += test_model();
+  fail += test_vectors();
+  fail += test_random();
+  printf(fail ? "FAILED\n" : "ALL OK\n");
+
+  return fail ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+/*****************************************************************************
+*  ecdsa_test bootloader中ECDSA P-256验签的测试向量和速度(主机端)
+*
+*  编译：make 或 gcc -O2 -I../../bm_bootloader/Src/ecdsa -I../../bm_bootloader/Src/sha256 -o ecdsa_test ecdsa_test.c
+*            ../../bm_bootloader/Src/ecdsa/ecdsa.c ../../bm_bootloader/Src/sha256/sha256.c
+*  运行：make test 或 ./ecdsa_test
+*
+*  用RFC 6979附录A.2.5的P-256/SHA-256测试向量检查ecdsa_p256_verify，摘要由bootloader
+*  的sha256计算。s换成n-s的签名同样有效；r、s为0或n，公钥不在曲线上或者是其他点，
+*  消息不同时必须失败。然后在签名、摘要和公钥的每个字节翻转一位，都必须失败。
+*  最后输出主机上一次验签的时间，用于比较实现修改前后的速度。
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "ecdsa.h"
+#include "sha256.h"
+
+#define  SPEED_TEST_CNT     50
+
+/*RFC 6979 A.2.5的公钥*/
+#define  RFC_QX   "60FED4BA255A9D31C961EB74C6356D68C049B8923B61FA6CE669622E60F29FB6"
+#define  RFC_QY   "7903FE1008B8BC99A41AE9E95628BC64F2F1B20C2D7E9F5177A3C294D4462299"
+/*基点G 在曲线上但不是签名的公钥*/
+#define  P256_GX  "6B17D1F2E12C4247F8BCE6E563A440F277037D812DEB33A0F4A13945D898C296"
+#define  P256_GY  "4FE342E2FE1A7F9B8EE7EB4A7C0F9E162BCE33576B315ECECBB6406837BF51F5"
+#define  P256_N   "FFFFFFFF00000000FFFFFFFFFFFFFFFFBCE6FAADA7179E84F3B9CAC2FC632551"
+#define  ZERO     "0000000000000000000000000000000000000000000000000000000000000000"
+/*"sample"的签名*/
+#define  SAMPLE_R "EFD48B2AACB6A8FD1140DD9CD45E81D69D2C877B56AAF991C34D0EA84EAF3716"
+#define  SAMPLE_S "F7CB1C942D657C41D436C7A1B6E29F65F3E900DBB9AFF4064DC4AB2F843ACDA8"
+/*"test"的签名*/
+#define  TEST_R   "F1ABB023518351CD71D881567B1EA663ED3EFCF6C5132B354F28D3B0B7D38367"
+#define  TEST_S   "019F4113742A2B14BD25926B49C649155F267E60D3814B4C0CC84250E46F0083"
+
+typedef struct
+{
+const char *name;
+const char *message;
+const char *qx;
+const char *qy;
+const char *r;
+const char *s;
+int         valid;          /*1：验签必须通过 0：必须失败*/
+}test_vector_t;
+
+static const test_vector_t test_vector[] = {
+{"sample",         "sample",RFC_QX,RFC_QY,SAMPLE_R,SAMPLE_S,1},
+{"test",           "test",  RFC_QX,RFC_QY,TEST_R,TEST_S,1},
+{"sample n-s",     "sample",RFC_QX,RFC_QY,SAMPLE_R,"0834E36AD29A83BF2BC9385E491D6099C8FDF9D1ED67AA7EA5F51F93782857A9",1},
+{"test n-s",       "test",  RFC_QX,RFC_QY,TEST_R,"FE60BEEB8BD5D4EC42DA6D94B639B6EA5DC07C4CD3965338E6F1887217F424CE",1},
+{"other message",  "test",  RFC_QX,RFC_QY,SAMPLE_R,SAMPLE_S,0},
+{"swap r s",       "sample",RFC_QX,RFC_QY,SAMPLE_S,SAMPLE_R,0},
+{"r zero",         "sample",RFC_QX,RFC_QY,ZERO,SAMPLE_S,0},
+{"s zero",         "sample",RFC_QX,RFC_QY,SAMPLE_R,ZERO,0},
+{"r n",            "sample",RFC_QX,RFC_QY,P256_N,SAMPLE_S,0},
+{"s n",            "sample",RFC_QX,RFC_QY,SAMPLE_R,P256_N,0},
+{"key G",          "sample",P256_GX,P256_GY,SAMPLE_R,SAMPLE_S,0},
+{"key off curve",  "sample",RFC_QX,P256_GY,SAMPLE_R,SAMPLE_S,0},
+{"key zero",       "sample",ZERO,ZERO,SAMPLE_R,SAMPLE_S,0},
+};
+
+/*名称：hex_to_bytes
+* 功能：十六进制字符串转换为字节
+* 参数：hex   字符串
+* 参数：bytes 输出
+* 参数：size  输出字节数 字符串长度必须是size * 2
+* 返回：无
+*/
+static void hex_to_bytes(const char *hex,uint8_t *bytes,uint32_t size)
+{
+  uint32_t i;
+  unsigned int value;
+
+  for(i = 0; i < size; i++){
+      sscanf(hex + i * 2,"%2x",&value);
+      bytes[i] = (uint8_t)value;
+  }
+}
+
+/*名称：test_vector_load
+* 功能：测试向量转换为验签的输入
+* 参数：v          测试向量
+* 参数：public_key 公钥
+* 参数：digest     消息的sha256摘要
+* 参数：signature  签名
+* 返回：无
+*/
+static void test_vector_load(const test_vector_t *v,uint8_t *public_key,uint8_t *digest,uint8_t *signature)
+{
+  sha256_ctx_t ctx;
+
+  hex_to_bytes(v->qx,public_key,32);
+  hex_to_bytes(v->qy,public_key + 32,32);
+  hex_to_bytes(v->r,signature,32);
+  hex_to_bytes(v->s,signature + 32,32);
+  sha256_init(&ctx);
+  sha256_update(&ctx,v->message,strlen(v->message));
+  sha256_final(&ctx,digest);
+}
+
+/*名称：test_vectors
+* 功能：检查全部测试向量
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_vectors(void)
+{
+  const test_vector_t *v;
+  uint8_t public_key[ECDSA_P256_KEY_SIZE],digest[ECDSA_P256_DIGEST_SIZE],signature[ECDSA_P256_SIG_SIZE];
+  uint32_t i;
+  int valid,fail = 0;
+
+  for(i = 0; i < sizeof(test_vector) / sizeof(test_vector[0]); i++){
+      v = &test_vector[i];
+      test_vector_load(v,public_key,digest,signature);
+      valid = ecdsa_p256_verify(public_key,digest,signature) == 0;
+      if(valid != v->valid){
+         printf("%-14s err: %s\n",v->name,valid ? "accepted" : "rejected");
+         fail ++;
+      }else{
+         printf("%-14s ok\n",v->name);
+      }
+  }
+
+  return fail;
+}
+
+/*名称：test_bit_flips
+* 功能：在有效签名的签名、摘要和公钥的每个字节翻转一位 都必须验签失败
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_bit_flips(void)
+{
+  uint8_t public_key[ECDSA_P256_KEY_SIZE],digest[ECDSA_P256_DIGEST_SIZE],signature[ECDSA_P256_SIG_SIZE];
+  uint8_t *input[3];
+  uint32_t size[3],i,k,cnt = 0;
+  int fail = 0;
+
+  test_vector_load(&test_vector[0],public_key,digest,signature);
+  input[0] = signature;
+  size[0] = sizeof(signature);
+  input[1] = digest;
+  size[1] = sizeof(digest);
+  input[2] = public_key;
+  size[2] = sizeof(public_key);
+  for(k = 0; k < 3; k++){
+      for(i = 0; i < size[k]; i++){
+          input[k][i] ^= (uint8_t)(1 << (i % 8));
+          if(ecdsa_p256_verify(public_key,digest,signature) == 0){
+             printf("bit flip %s byte %u err: accepted\n",k == 0 ? "signature" : (k == 1 ? "digest" : "key"),i);
+             fail ++;
+          }
+          input[k][i] ^= (uint8_t)(1 << (i % 8));
+          cnt ++;
+      }
+  }
+  printf("bit flips %u %s\n",cnt,fail ? "err" : "ok");
+
+  return fail;
+}
+
+/*名称：test_speed
+* 功能：重复验签 输出一次验签的时间
+* 参数：无
+* 返回：无
+*/
+static void test_speed(void)
+{
+  uint8_t public_key[ECDSA_P256_KEY_SIZE],digest[ECDSA_P256_DIGEST_SIZE],signature[ECDSA_P256_SIG_SIZE];
+  uint32_t i;
+  clock_t start;
+  double seconds;
+
+  test_vector_load(&test_vector[0],public_key,digest,signature);
+  start = clock();
+  for(i = 0; i < SPEED_TEST_CNT; i++){
+      ecdsa_p256_verify(public_key,digest,signature);
+  }
+  seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("speed %u verify in %.3fs %.2f ms/verify\n",SPEED_TEST_CNT,seconds,seconds * 1000 / SPEED_TEST_CNT);
+}
+
+int main(void)
+{
+  int fail;
+
+  fail = test_vectors();
+  fail += test_bit_flips();
+  test_speed();
+  printf(fail ? "FAILED\n" : "ALL OK\n");
+
+  return fail ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+/*****************************************************************************
+*  bench 升级和回滚的flash代价估算(主机端)
+*
+*  编译：make bench
+*  运行：./bench [-v]      -v 输出bootloader的日志和bootloader_stat_report
+*
+*  在flash_sim模拟的flash上运行bootloader_if.c中的bootloader_update_user_app和
+*  bootloader_recovery_user_app，按典型擦除和编程时间给出每次操作的耗时估算、
+*  各分区的擦除页数和单页最多擦除次数、env写入次数。估算只包含flash擦写时间，
+*  不包含crc和sha256的计算时间。升级和回滚后检查用户区和更新区的内容。
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash_utils.h"
+#include "bootloader_if.h"
+#include "log.h"
+#include "flash_sim.h"
+#include "hal_sim.h"
+
+#define  USER_SLOT       ((uint8_t *)(uintptr_t)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET))
+#define  UPDATE_SLOT     ((uint8_t *)(uintptr_t)(BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET))
+
+typedef struct
+{
+const char *name;
+uint32_t    offset;
+uint32_t    size;
+}region_t;
+
+typedef struct
+{
+const char *name;
+uint32_t    origin_size;   /*用户区中原固件的大小*/
+uint32_t    update_size;   /*更新区中新固件的大小*/
+uint32_t    change_cnt;    /*0：新固件和原固件完全不同 其他：在原固件上修改的字节数 模拟小版本*/
+}bench_case_t;
+
+static const region_t region[] = {
+{"env",    BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET,        BOOTLOADER_FLASH_ENV_BANK1_SIZE + BOOTLOADER_FLASH_ENV_BANK2_SIZE},
+{"user",   BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET, BOOTLOADER_FLASH_USER_APPLICATION_SIZE},
+{"update", BOOTLOADER_FLASH_UPDATE_APPLICATION_ADDR_OFFSET,BOOTLOADER_FLASH_UPDATE_APPLICATION_SIZE},
+{"swap",   BOOTLOADER_FLASH_SWAP_BLOCK_ADDR_OFFSET,       BOOTLOADER_FLASH_SWAP_BLOCK_SIZE},
+{"journal",BOOTLOADER_FLASH_JOURNAL_ADDR_OFFSET,          BOOTLOADER_FLASH_JOURNAL_SIZE}
+};
+
+static const bench_case_t bench_case[] = {
+{"full slot",     0x19000, 0x19000, 0},
+{"new build",     0xB400,  0xC800,  0},
+{"small app",     0x4000,  0x5000,  0},
+{"point release", 0x10000, 0x10100, 24},
+{"point release", 0x19000, 0x19000, 8}
+};
+
+static uint8_t origin_image[BOOTLOADER_FLASH_USER_APPLICATION_SIZE];
+static uint8_t update_image[BOOTLOADER_FLASH_USER_APPLICATION_SIZE];
+
+/*名称：bench_fill
+* 功能：生成固件数据 开头是合法的栈顶和复位向量
+* 参数：image 固件
+* 参数：size  大小
+* 参数：seed  随机数种子
+* 返回：无
+*/
+static void bench_fill(uint8_t *image,uint32_t size,uint32_t seed)
+{
+  uint32_t i,word;
+
+  srand(seed);
+  for(i = 0; i < size; i++){
+      image[i] = (uint8_t)rand();
+  }
+  word = SRAM_BASE + 0x10000;
+  memcpy(image,&word,4);
+  word = BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_USER_APPLICATION_ADDR_OFFSET + 0x101;
+  memcpy(image + 4,&word,4);
+}
+
+/*名称：bench_setup
+* 功能：上电 写入原固件和新固件 env设置为需要更新
+* 参数：c 测试用例
+* 返回：0：成功 其他：失败
+*/
+static int bench_setup(const bench_case_t *c)
+{
+  bootloader_env_t env;
+  uint32_t i,offset;
+
+  bench_fill(origin_image,c->origin_size,1);
+  if(c->change_cnt == 0){
+     bench_fill(update_image,c->update_size,2);
+  }else{
+     /*小版本：修改集中在几页中 末尾增加的部分是新的数据*/
+     bench_fill(update_image,c->update_size,3);
+     memcpy(update_image,origin_image,c->origin_size < c->update_size ? c->origin_size : c->update_size);
+     srand(4);
+     for(i = 0; i < c->change_cnt; i++){
+         offset = (rand() % 4) * (c->update_size / 4) + rand() % 64;
+         update_image[offset] ^= 0x5A;
+     }
+  }
+
+  hal_sim_init();
+  if(flash_sim_init() != 0){
+     return -1;
+  }
+  memcpy(USER_SLOT,origin_image,c->origin_size);
+  memcpy(UPDATE_SLOT,update_image,c->update_size);
+  if(bootloader_init() != 0 || bootloader_get_env(&env) != 0){
+     return -1;
+  }
+  env.boot_flag = BOOTLOADER_FLAG_BOOT_UPDATE;
+  env.fw_origin.size = c->origin_size;
+  env.fw_update.size = c->update_size;
+
+  return bootloader_save_env(&env);
+}
+
+/*名称：bench_start
+* 功能：开始统计区间
+* 参数：无
+* 返回：开始时的模拟时钟 单位：us
+*/
+static uint64_t bench_start(void)
+{
+  flash_sim_stat_reset();
+  bootloader_stat_reset();
+
+  return flash_sim_get_time_us();
+}
+
+/*名称：bench_report
+* 功能：输出统计区间的代价
+* 参数：name       操作名称
+* 参数：c          测试用例
+* 参数：start_time 开始时的模拟时钟 单位：us
+* 返回：无
+*/
+static void bench_report(const char *name,const bench_case_t *c,uint64_t start_time)
+{
+  const flash_sim_stat_t *stat;
+  uint32_t i,page,erase_cnt,erase_max;
+
+  stat = flash_sim_get_stat();
+  printf("%-8s %-13s %3uK->%3uK %6ums %4u %7u %4u ",name,c->name,c->origin_size / 1024,c->update_size / 1024,
+         (uint32_t)((flash_sim_get_time_us() - start_time) / 1000),stat->erase_cnt,stat->program_cnt,stat->env_write_cnt);
+  for(i = 0; i < sizeof(region) / sizeof(region[0]); i++){
+      erase_cnt = 0;
+      erase_max = 0;
+      for(page = region[i].offset / FLASH_PAGE_SIZE; page < (region[i].offset + region[i].size) / FLASH_PAGE_SIZE; page++){
+          erase_cnt += stat->page_erase_cnt[page];
+          if(stat->page_erase_cnt[page] > erase_max){
+             erase_max = stat->page_erase_cnt[page];
+          }
+      }
+      printf(" %3u/%-2u",erase_cnt,erase_max);
+  }
+  printf("\n");
+  bootloader_stat_report(name);
+}
+
+int main(int argc,char *argv[])
+{
+  const bench_case_t *c;
+  bootloader_env_t env;
+  uint64_t start_time;
+  uint32_t i;
+  int fail = 0;
+
+  if(argc > 1 && strcmp(argv[1],"-v") == 0){
+     log_set_level(LOG_LEVEL_WARNING);
+  }
+  printf("flash cost model: page erase %dus halfword program %dus\n",FLASH_UTILS_PAGE_ERASE_TIME_US,FLASH_UTILS_HALFWORD_PROGRAM_TIME_US);
+  printf("ers: erased pages  program: programmed halfwords  envw: env writes  region: erased pages/max erases of one page\n");
+  printf("%-8s %-13s %-10s %8s %4s %7s %4s  %-6s %-6s %-6s %-6s %-6s\n",
+         "run","case","size","estimate","ers","program","envw","env","user","update","swap","journal");
+  for(i = 0; i < sizeof(bench_case) / sizeof(bench_case[0]); i++){
+      c = &bench_case[i];
+      if(bench_setup(c) != 0){
+         printf("%s setup err.\n",c->name);
+         return 1;
+      }
+
+      start_time = bench_start();
+      if(bootloader_get_env(&env) != 0 || bootloader_update_user_app(&env) != 0){
+         printf("%s update err.\n",c->name);
+         return 1;
+      }
+      bench_report("update",c,start_time);
+      if(memcmp(USER_SLOT,update_image,c->update_size) != 0 || env.boot_flag != BOOTLOADER_FLAG_BOOT_UPDATE_COMPLETE){
+         printf("%s update result err.\n",c->name);
+         fail = 1;
+      }
+
+      start_time = bench_start();
+      if(bootloader_get_env(&env) != 0 || bootloader_recovery_user_app(&env) != 0){
+         printf("%s recovery err.\n",c->name);
+         return 1;
+      }
+      bench_report("recovery",c,start_time);
+      if(memcmp(USER_SLOT,origin_image,c->origin_size) != 0 || env.boot_flag != BOOTLOADER_FLAG_BOOT_NORMAL){
+         printf("%s recovery result err.\n",c->name);
+         fail = 1;
+      }
+  }
+
+  return fail;
+}
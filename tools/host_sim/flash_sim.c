@@ -0,0 +1,590 @@
+/*****************************************************************************
+*  flash_sim 内部flash模拟(主机端)
+*
+*  用RAM数组代替F103xE的内部flash，实现flash_utils.h的全部接口，bootloader_if.c
+*  不经修改在主机上编译运行。行为和固件中的flash_utils一致：
+*  擦除前检查空白页、编程跳过0xFFFF、编程的位置没有擦除时返回PGERR、写保护的页组
+*  不能擦写、按页统计擦除次数。每次擦除和编程按FLASH_UTILS_PAGE_ERASE_TIME_US和
+*  FLASH_UTILS_HALFWORD_PROGRAM_TIME_US推进模拟时钟。设置掉电点后，到达次数的擦除
+*  或编程不执行，直接longjmp回到测试，之前的操作保留在flash中。
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "flash_utils.h"
+#include "bootloader_if.h"
+#include "flash_sim.h"
+
+#define  FLASH_SIM_ENV_ADDR              (BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET)
+#define  FLASH_SIM_ENV_END               (BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET + BOOTLOADER_FLASH_ENV_BANK2_SIZE)
+
+static uint8_t *flash_mem;
+static flash_sim_stat_t sim_stat;
+static flash_utils_stat_t stat;
+static flash_utils_error_t error;
+static flash_engine_idle_hook_t idle_hook;
+/*当前生效的写保护和选项字节中的写保护 HAL_FLASH_OB_Launch时生效*/
+static uint32_t wrp_active;
+static uint32_t wrp_option;
+/*掉电点*/
+static jmp_buf *power_cut_jmp;
+static uint32_t power_cut_op;
+static uint32_t sim_op_cnt;
+
+/*名称：flash_sim_map
+* 功能：在固定地址映射一段清零的内存
+* 参数：addr 地址
+* 参数：size 大小
+* 返回：映射的地址 NULL：失败
+*/
+static uint8_t *flash_sim_map(uintptr_t addr,size_t size)
+{
+  void *mem;
+
+  mem = mmap((void *)addr,size,PROT_READ | PROT_WRITE,MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+  if(mem != (void *)addr){
+     perror("mmap");
+     return NULL;
+  }
+
+  return mem;
+}
+
+/*名称：flash_sim_init
+* 功能：把模拟的flash和SRAM映射到芯片上的地址 flash全部擦除 SRAM清零
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+int flash_sim_init(void)
+{
+  if(flash_mem == NULL){
+     flash_mem = flash_sim_map(FLASH_BASE,FLASH_SIM_SIZE);
+     if(flash_mem == NULL || flash_sim_map(SRAM_BASE,FLASH_SIM_SRAM_SIZE) == NULL){
+        return -1;
+     }
+  }
+  memset((void *)SRAM_BASE,0,FLASH_SIM_SRAM_SIZE);
+  flash_sim_erase_all();
+  wrp_active = 0;
+  wrp_option = 0;
+  power_cut_op = 0;
+  flash_sim_stat_reset();
+  flash_utils_stat_reset();
+
+  return 0;
+}
+
+/*名称：flash_sim_erase_all
+* 功能：整片擦除 不计入统计 用于准备测试数据
+* 参数：无
+* 返回：无
+*/
+void flash_sim_erase_all(void)
+{
+  memset(flash_mem,0xFF,FLASH_SIM_SIZE);
+}
+
+/*名称：flash_sim_stat_reset
+* 功能：清零模拟统计 模拟时钟继续计时
+* 参数：无
+* 返回：无
+*/
+void flash_sim_stat_reset(void)
+{
+  uint64_t time_us = sim_stat.time_us;
+
+  memset(&sim_stat,0,sizeof(sim_stat));
+  sim_stat.time_us = time_us;
+}
+
+/*名称：flash_sim_get_stat
+* 功能：获取模拟统计
+* 参数：无
+* 返回：统计信息指针
+*/
+const flash_sim_stat_t *flash_sim_get_stat(void)
+{
+  return &sim_stat;
+}
+
+/*名称：flash_sim_get_time_us
+* 功能：获取模拟时钟
+* 参数：无
+* 返回：时间 单位：us
+*/
+uint64_t flash_sim_get_time_us(void)
+{
+  return sim_stat.time_us;
+}
+
+/*名称：flash_sim_elapse
+* 功能：推进模拟时钟
+* 参数：time_us 时间 单位：us
+* 返回：无
+*/
+void flash_sim_elapse(uint32_t time_us)
+{
+  sim_stat.time_us += time_us;
+}
+
+/*名称：flash_sim_set_power_cut
+* 功能：设置掉电点 从现在开始第op_cnt次擦除或编程之前掉电 掉电后自动取消
+* 参数：op_cnt 操作次数 0：不掉电
+* 参数：jmp    掉电时longjmp的位置 longjmp的值是1
+* 返回：无
+*/
+void flash_sim_set_power_cut(uint32_t op_cnt,jmp_buf *jmp)
+{
+  power_cut_op = op_cnt;
+  power_cut_jmp = jmp;
+  sim_op_cnt = 0;
+}
+
+/*名称：flash_sim_get_op_cnt
+* 功能：获取设置掉电点以后执行的擦除和编程次数
+* 参数：无
+* 返回：次数
+*/
+uint32_t flash_sim_get_op_cnt(void)
+{
+  return sim_op_cnt;
+}
+
+/*名称：flash_sim_operate
+* 功能：开始一次擦除或编程 到达掉电点时不返回
+* 参数：无
+* 返回：无
+*/
+static void flash_sim_operate(void)
+{
+  sim_op_cnt ++;
+  if(power_cut_op != 0 && sim_op_cnt >= power_cut_op){
+     power_cut_op = 0;
+     longjmp(*power_cut_jmp,1);
+  }
+}
+
+/*名称：flash_sim_is_protected
+* 功能：地址所在的页组是否被写保护
+* 参数：addr 地址
+* 返回：1：是 0：否
+*/
+static int flash_sim_is_protected(uint32_t addr)
+{
+  return (flash_utils_get_write_protection_mask(addr,1) & wrp_active) != 0;
+}
+
+/*名称：flash_sim_is_blank
+* 功能：检查一页是否全部是0xFF
+* 参数：page_addr 页地址
+* 返回：1：空白 0：不是空白
+*/
+static int flash_sim_is_blank(uint32_t page_addr)
+{
+  const uint32_t *word = (const uint32_t *)(uintptr_t)page_addr;
+  uint32_t i;
+
+  for(i = 0; i < FLASH_PAGE_SIZE / 4; i++){
+      if(word[i] != 0xFFFFFFFF){
+         return 0;
+      }
+  }
+
+  return 1;
+}
+
+/*名称：flash_sim_erase_page
+* 功能：擦除一页 推进模拟时钟
+* 参数：page_addr 页地址
+* 返回：0：成功 其他：失败
+*/
+static int flash_sim_erase_page(uint32_t page_addr)
+{
+  uint32_t page = (page_addr - FLASH_BASE) / FLASH_PAGE_SIZE;
+
+  if(flash_sim_is_protected(page_addr)){
+     error.code = FLASH_UTILS_ERR_WRP;
+     error.addr = page_addr;
+     return -1;
+  }
+  flash_sim_operate();
+  memset(flash_mem + page * FLASH_PAGE_SIZE,0xFF,FLASH_PAGE_SIZE);
+  sim_stat.time_us += FLASH_UTILS_PAGE_ERASE_TIME_US;
+  sim_stat.erase_cnt ++;
+  sim_stat.page_erase_cnt[page] ++;
+  if(idle_hook != NULL){
+     idle_hook();
+  }
+
+  return 0;
+}
+
+/*名称：flash_sim_program_halfword
+* 功能：编程一个半字 0xFFFF不编程 推进模拟时钟
+* 参数：addr  地址 半字对齐
+* 参数：value 半字数据
+* 返回：0：编程 1：跳过 其他：失败
+*/
+static int flash_sim_program_halfword(uint32_t addr,uint16_t value)
+{
+  __IO uint16_t *dst = (__IO uint16_t *)(uintptr_t)addr;
+
+  if(value == 0xFFFF){
+     if(*dst != 0xFFFF){
+        error.code = FLASH_UTILS_ERR_PG;
+        error.addr = addr;
+        return -1;
+     }
+     return 1;
+  }
+  if(flash_sim_is_protected(addr)){
+     error.code = FLASH_UTILS_ERR_WRP;
+     error.addr = addr;
+     return -1;
+  }
+  /*F1只允许在擦除后的位置编程 或者把任意值改为0x0000*/
+  if(*dst != 0xFFFF && value != 0x0000){
+     error.code = FLASH_UTILS_ERR_PG;
+     error.addr = addr;
+     return -1;
+  }
+  flash_sim_operate();
+  *dst = value;
+  sim_stat.time_us += FLASH_UTILS_HALFWORD_PROGRAM_TIME_US;
+  sim_stat.program_cnt ++;
+
+  return 0;
+}
+
+/*名称：flash_sim_program
+* 功能：按半字连续编程 统计编程和跳过的数量
+* 参数：destination 目的地址 半字对齐
+* 参数：source      源地址
+* 参数：cnt         半字数量
+* 参数：skip_cnt    跳过的0xFFFF半字数
+* 返回：0：成功 其他：失败
+*/
+static int flash_sim_program(uint32_t destination,const uint16_t *source,uint32_t cnt,uint32_t *skip_cnt)
+{
+  uint32_t i;
+  int rc;
+
+  *skip_cnt = 0;
+  if(destination < FLASH_BASE || destination + cnt * 2 > USER_FLASH_END_ADDRESS + 1 || destination % 2 != 0){
+     error.code = FLASH_UTILS_ERR_PG;
+     error.addr = destination;
+     return -1;
+  }
+  if(destination >= FLASH_SIM_ENV_ADDR && destination < FLASH_SIM_ENV_END){
+     sim_stat.env_write_cnt ++;
+  }
+  for(i = 0; i < cnt; i++){
+      rc = flash_sim_program_halfword(destination + i * 2,source[i]);
+      if(rc < 0){
+         return -1;
+      }
+      if(rc > 0){
+         (*skip_cnt) ++;
+      }
+  }
+
+  return 0;
+}
+
+/*名称：flash_utils_init
+* 功能：flash工具初始化
+* 参数：无
+* 返回：无
+*/
+void flash_utils_init(void)
+{
+}
+
+/*名称：flash_utils_deinit
+* 功能：flash工具去初始化
+* 参数：无
+* 返回：无
+*/
+void flash_utils_deinit(void)
+{
+}
+
+/*名称：flash_utils_erase
+* 功能：擦出指定范围flash数据 已经是空白的页不擦除
+* 参数：start_addr 开始地址
+* 参数：size       数据大小
+* 返回：0：成功 其他：失败
+*/
+uint32_t flash_utils_erase(uint32_t start_addr,uint32_t size)
+{
+  uint32_t i,page_cnt,page_addr,page,erase_cnt = 0;
+  uint32_t start_time;
+  int rc = 0;
+
+  start_time = HAL_GetTick();
+  page_cnt = (size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+  if((start_addr - FLASH_BASE) % FLASH_PAGE_SIZE != 0 || start_addr + page_cnt * FLASH_PAGE_SIZE > USER_FLASH_END_ADDRESS + 1){
+     return -1;
+  }
+  for(i = 0; i < page_cnt; i++){
+      page_addr = start_addr + i * FLASH_PAGE_SIZE;
+#if  FLASH_UTILS_BLANK_CHECK_ENABLE > 0
+      if(flash_sim_is_blank(page_addr)){
+         continue;
+      }
+#endif
+      rc = flash_sim_erase_page(page_addr);
+      if(rc != 0){
+         break;
+      }
+      page = (page_addr - FLASH_BASE) / FLASH_PAGE_SIZE;
+      if(page < FLASH_UTILS_STAT_PAGE_CNT){
+         stat.page_erase_cnt[page] ++;
+      }
+      erase_cnt ++;
+  }
+  stat.erase_cnt += erase_cnt;
+  stat.erase_skip_cnt += i - erase_cnt;
+  stat.erase_time += HAL_GetTick() - start_time;
+
+  return rc == 0 ? 0 : -1;
+}
+
+/*名称：flash_utils_write
+* 功能：在指定位置写入flash数据
+* 参数：destination 目的地址
+* 参数：source      源地址
+* 参数：size        源大小 单位：字
+* 返回：0：成功 其他：失败
+*/
+uint32_t flash_utils_write(uint32_t destination,uint32_t *source,uint32_t size)
+{
+  uint32_t start_time,skip_cnt;
+  int rc;
+
+  start_time = HAL_GetTick();
+  rc = flash_sim_program(destination,(const uint16_t *)source,size * 2,&skip_cnt);
+  if(rc != 0){
+     printf("flash_sim: program addr:0x%X err:0x%X.\n",error.addr,error.code);
+     return -1;
+  }
+  stat.program_cnt += size * 2 - skip_cnt;
+  stat.program_skip_cnt += skip_cnt;
+  stat.program_time += HAL_GetTick() - start_time;
+
+  return 0;
+}
+
+/*名称：flash_utils_write_halfword
+* 功能：在指定位置写入一个半字 用于不擦除的进度标记
+* 参数：destination 目的地址 半字对齐
+* 参数：value       半字数据
+* 返回：0：成功 其他：失败
+*/
+uint32_t flash_utils_write_halfword(uint32_t destination,uint16_t value)
+{
+  uint32_t start_time,skip_cnt;
+  int rc;
+
+  start_time = HAL_GetTick();
+  rc = flash_sim_program(destination,&value,1,&skip_cnt);
+  if(rc != 0){
+     printf("flash_sim: program addr:0x%X err:0x%X.\n",error.addr,error.code);
+     return -1;
+  }
+  stat.program_cnt += 1 - skip_cnt;
+  stat.program_skip_cnt += skip_cnt;
+  stat.program_time += HAL_GetTick() - start_time;
+
+  return 0;
+}
+
+/*名称：flash_utils_read
+* 功能：读取指定位置flash数据
+* 参数：dst  目的缓存地址
+* 参数：addr flash源地址
+* 参数：size 数据大小 单位：字
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_read(uint32_t *dst,const uint32_t addr,const uint32_t size)
+{
+  if(addr + size * 4 > USER_FLASH_END_ADDRESS){
+     return -1;
+  }
+  memcpy(dst,(const void *)(uintptr_t)addr,size * 4);
+
+  return 0;
+}
+
+/*名称：flash_utils_get_error
+* 功能：获取最近一次编程错误
+* 参数：无
+* 返回：错误信息指针
+*/
+const flash_utils_error_t *flash_utils_get_error(void)
+{
+  return &error;
+}
+
+/*名称：flash_utils_get_write_protection_mask
+* 功能：获取地址范围所在的写保护页组
+* 参数：start_addr 开始地址
+* 参数：size       大小
+* 返回：页组掩码 置位的页组包含范围中的页
+*/
+uint32_t flash_utils_get_write_protection_mask(uint32_t start_addr,uint32_t size)
+{
+  uint32_t first,last,mask;
+
+  if(size == 0){
+     return 0;
+  }
+  first = (start_addr - FLASH_BASE) / FLASH_UTILS_WRP_GROUP_SIZE;
+  last = (start_addr + size - 1 - FLASH_BASE) / FLASH_UTILS_WRP_GROUP_SIZE;
+  first = first < FLASH_UTILS_WRP_GROUP_CNT ? first : FLASH_UTILS_WRP_GROUP_CNT - 1;
+  last = last < FLASH_UTILS_WRP_GROUP_CNT ? last : FLASH_UTILS_WRP_GROUP_CNT - 1;
+  mask = 0;
+  while(first <= last){
+     mask |= 1U << first;
+     first ++;
+  }
+
+  return mask;
+}
+
+/*名称：flash_utils_get_write_protection
+* 功能：获取当前生效的写保护
+* 参数：无
+* 返回：页组掩码
+*/
+uint32_t flash_utils_get_write_protection(void)
+{
+  return wrp_active;
+}
+
+/*名称：flash_utils_get_write_protection_option
+* 功能：获取选项字节中的写保护 HAL_FLASH_OB_Launch后生效
+* 参数：无
+* 返回：页组掩码
+*/
+uint32_t flash_utils_get_write_protection_option(void)
+{
+  return wrp_option;
+}
+
+/*名称：flash_utils_set_write_protection
+* 功能：设置选项字节中的写保护 选项字节擦写按一页擦除计时
+* 参数：mask 页组掩码
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_set_write_protection(uint32_t mask)
+{
+  if(mask != wrp_option){
+     wrp_option = mask;
+     sim_stat.time_us += FLASH_UTILS_PAGE_ERASE_TIME_US;
+  }
+
+  return 0;
+}
+
+/*名称：flash_utils_get_write_protection_status
+* 功能：获取整个flash是否被写保护
+* 参数：无
+* 返回：写保护状态
+*/
+flash_utils_wr_protection_t flash_utils_get_write_protection_status()
+{
+  return wrp_active != 0 ? FLASH_UTILS_WR_PROTECTION_ENABLED : FLASH_UTILS_WR_PROTECTION_NONE;
+}
+
+/*名称：flash_utils_write_protection_config
+* 功能：配置整个flash写保护状态
+* 参数：protection 保护状态
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_write_protection_config(flash_utils_wr_protection_t protection)
+{
+  return flash_utils_set_write_protection(protection == FLASH_UTILS_WR_PROTECTION_ENABLED ? 0xFFFFFFFFU : 0);
+}
+
+/*名称：HAL_FLASH_OB_Launch
+* 功能：选项字节生效 芯片上会复位 模拟时只更新当前的写保护
+* 参数：无
+* 返回：无
+*/
+void HAL_FLASH_OB_Launch(void)
+{
+  wrp_active = wrp_option;
+}
+
+/*名称：flash_utils_bench
+* 功能：按模拟的耗时测试擦除和编程速度 测试区域原有数据会被擦除
+* 参数：start_addr 测试区域开始地址 页对齐
+* 参数：size       测试区域大小
+* 参数：bench      测试结果
+* 返回：0：成功 其他：失败
+*/
+int flash_utils_bench(uint32_t start_addr,uint32_t size,flash_utils_bench_t *bench)
+{
+  uint32_t start_time,speed;
+
+  size = size / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+  if(size == 0 || start_addr < FLASH_BASE + size || start_addr + size - 1 > USER_FLASH_END_ADDRESS){
+     return -1;
+  }
+  start_time = HAL_GetTick();
+  if(flash_utils_erase(start_addr,size) != 0){
+     return -1;
+  }
+  bench->erase_speed = size * 1000 / 1024 / (HAL_GetTick() - start_time + 1);
+  start_time = HAL_GetTick();
+  if(flash_utils_write(start_addr,(uint32_t *)FLASH_BASE,size / 4) != 0){
+     return -1;
+  }
+  speed = size * 1000 / 1024 / (HAL_GetTick() - start_time + 1);
+  bench->hal_program_speed = speed;
+  bench->fast_program_speed = speed;
+  bench->engine_program_speed = speed;
+
+  return 0;
+}
+
+/*名称：flash_utils_stat_reset
+* 功能：清零flash操作统计
+* 参数：无
+* 返回：无
+*/
+void flash_utils_stat_reset(void)
+{
+  memset(&stat,0,sizeof(stat));
+}
+
+/*名称：flash_utils_get_stat
+* 功能：获取flash操作统计
+* 参数：无
+* 返回：统计信息指针
+*/
+const flash_utils_stat_t *flash_utils_get_stat(void)
+{
+  return &stat;
+}
+
+/*名称：flash_utils_stat_estimate_time
+* 功能：按典型擦除和编程时间估算统计区间的flash耗时
+* 参数：无
+* 返回：估算耗时 单位：ms
+*/
+uint32_t flash_utils_stat_estimate_time(void)
+{
+  return (stat.erase_cnt * FLASH_UTILS_PAGE_ERASE_TIME_US + stat.program_cnt * FLASH_UTILS_HALFWORD_PROGRAM_TIME_US) / 1000;
+}
+
+/*名称：flash_engine_set_idle_hook
+* 功能：设置等待时调用的函数 模拟时每擦除一页调用一次
+* 参数：hook 函数 NULL：不调用
+* 返回：无
+*/
+void flash_engine_set_idle_hook(flash_engine_idle_hook_t hook)
+{
+  idle_hook = hook;
+}
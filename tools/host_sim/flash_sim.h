@@ -0,0 +1,90 @@
+#ifndef  __FLASH_SIM_H__
+#define  __FLASH_SIM_H__
+#include <setjmp.h>
+#include "stm32f1xx_hal.h"
+
+/*F103xE内部flash的主机模拟 512K 每页2K*/
+/*擦除后是0xFF 编程只能把1改成0：目的半字不是0xFFFF时只允许写0x0000 否则PGERR*/
+/*每次擦除和编程按flash_utils.h中的典型耗时推进模拟时钟 HAL_GetTick按模拟时钟计时*/
+/*掉电模拟：擦除一页和编程一个半字各算一次操作 到达设置的次数时这次操作不执行 longjmp回到测试*/
+
+/******************************************************************************/
+/*    配置开始                                                                */
+/******************************************************************************/
+#define  FLASH_SIM_SIZE                          (0x80000)   /*512K*/
+#define  FLASH_SIM_SRAM_SIZE                     (0x10000)   /*64K 启动时间线、启动信息和命令邮箱在末尾*/
+/******************************************************************************/
+/*    配置结束                                                                */
+/******************************************************************************/
+
+#define  FLASH_SIM_PAGE_CNT                      (FLASH_SIM_SIZE / FLASH_PAGE_SIZE)
+
+typedef struct
+{
+uint64_t time_us;                                    /*擦除和编程的模拟耗时 单位：us*/
+uint32_t erase_cnt;                                  /*实际擦除的页数*/
+uint32_t program_cnt;                                /*实际编程的半字数*/
+uint32_t env_write_cnt;                              /*写入env区的次数 每次是一条env记录*/
+uint32_t page_erase_cnt[FLASH_SIM_PAGE_CNT];         /*每一页的擦除次数*/
+}flash_sim_stat_t;
+
+
+/*名称：flash_sim_init
+* 功能：把模拟的flash和SRAM映射到芯片上的地址 flash全部擦除 SRAM清零
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+int flash_sim_init(void);
+
+/*名称：flash_sim_erase_all
+* 功能：整片擦除 不计入统计 用于准备测试数据
+* 参数：无
+* 返回：无
+*/
+void flash_sim_erase_all(void);
+
+/*名称：flash_sim_stat_reset
+* 功能：清零模拟统计
+* 参数：无
+* 返回：无
+*/
+void flash_sim_stat_reset(void);
+
+/*名称：flash_sim_get_stat
+* 功能：获取模拟统计
+* 参数：无
+* 返回：统计信息指针
+*/
+const flash_sim_stat_t *flash_sim_get_stat(void);
+
+/*名称：flash_sim_get_time_us
+* 功能：获取模拟时钟
+* 参数：无
+* 返回：时间 单位：us
+*/
+uint64_t flash_sim_get_time_us(void);
+
+/*名称：flash_sim_elapse
+* 功能：推进模拟时钟
+* 参数：time_us 时间 单位：us
+* 返回：无
+*/
+void flash_sim_elapse(uint32_t time_us);
+
+/*名称：flash_sim_set_power_cut
+* 功能：设置掉电点 从现在开始第op_cnt次擦除或编程之前掉电 掉电后自动取消
+* 参数：op_cnt 操作次数 0：不掉电
+* 参数：jmp    掉电时longjmp的位置 longjmp的值是1
+* 返回：无
+*/
+void flash_sim_set_power_cut(uint32_t op_cnt,jmp_buf *jmp);
+
+/*名称：flash_sim_get_op_cnt
+* 功能：获取设置掉电点以后执行的擦除和编程次数
+* 参数：无
+* 返回：次数
+*/
+uint32_t flash_sim_get_op_cnt(void);
+
+
+#endif
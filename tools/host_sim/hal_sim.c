@@ -0,0 +1,210 @@
+/*****************************************************************************
+*  hal_sim HAL主机替代
+*
+*  提供bootloader_if.c和boot_timeline.c用到的寄存器变量、HAL函数、日志输出、
+*  后备寄存器和硬件CRC单元。日志等级默认关闭，用log_set_level打开。
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "log.h"
+#include "bkp_utils.h"
+#include "crc32.h"
+#include "crc32_hw.h"
+#include "flash_sim.h"
+#include "hal_sim.h"
+
+SysTick_Type   sim_systick;
+NVIC_Type      sim_nvic;
+SCB_Type       sim_scb;
+CoreDebug_Type sim_core_debug;
+DWT_Type       sim_dwt;
+RCC_TypeDef    sim_rcc;
+FLASH_TypeDef  sim_flash;
+IWDG_TypeDef   sim_iwdg;
+uint32_t       SystemCoreClock = 72000000;
+
+static uint8_t log_level = LOG_LEVEL_OFF;
+static uint16_t bkp_reg[BKP_UTILS_REG_CNT + 1];
+static uint32_t crc_value;
+static hal_sim_reset_hook_t reset_hook;
+static uint32_t reset_cnt;
+
+/*名称：hal_sim_init
+* 功能：寄存器恢复为复位后的值 后备寄存器清零 相当于上电
+* 参数：无
+* 返回：无
+*/
+void hal_sim_init(void)
+{
+  memset(&sim_systick,0,sizeof(sim_systick));
+  memset(&sim_nvic,0,sizeof(sim_nvic));
+  memset(&sim_scb,0,sizeof(sim_scb));
+  memset(&sim_core_debug,0,sizeof(sim_core_debug));
+  memset(&sim_dwt,0,sizeof(sim_dwt));
+  memset(&sim_rcc,0,sizeof(sim_rcc));
+  memset(&sim_flash,0,sizeof(sim_flash));
+  memset(&sim_iwdg,0,sizeof(sim_iwdg));
+  memset(bkp_reg,0,sizeof(bkp_reg));
+  /*上电复位*/
+  sim_rcc.CSR = (1U << RCC_FLAG_PORRST) | (1U << RCC_FLAG_PINRST);
+  reset_cnt = 0;
+}
+
+/*名称：hal_sim_set_reset_hook
+* 功能：设置软件复位时调用的函数
+* 参数：hook 函数 NULL：复位时退出程序
+* 返回：无
+*/
+void hal_sim_set_reset_hook(hal_sim_reset_hook_t hook)
+{
+  reset_hook = hook;
+}
+
+/*名称：hal_sim_get_reset_cnt
+* 功能：获取软件复位的次数
+* 参数：无
+* 返回：次数
+*/
+uint32_t hal_sim_get_reset_cnt(void)
+{
+  return reset_cnt;
+}
+
+uint32_t HAL_GetTick(void)
+{
+  return (uint32_t)(flash_sim_get_time_us() / 1000);
+}
+
+void HAL_Delay(uint32_t delay)
+{
+  flash_sim_elapse(delay * 1000);
+}
+
+void HAL_RCC_DeInit(void)
+{
+}
+
+HAL_StatusTypeDef HAL_IWDG_Init(IWDG_HandleTypeDef *hiwdg)
+{
+  (void)hiwdg;
+  return HAL_OK;
+}
+
+void NVIC_SystemReset(void)
+{
+  reset_cnt ++;
+  sim_rcc.CSR |= 1U << RCC_FLAG_SFTRST;
+  if(reset_hook == NULL){
+     fprintf(stderr,"hal_sim: unexpected system reset.\n");
+     exit(1);
+  }
+  reset_hook();
+  /*hook返回时按复位后没有返回处理*/
+  exit(1);
+}
+
+/*日志*/
+void log_init(void)
+{
+}
+
+uint32_t log_time(void)
+{
+  return HAL_GetTick();
+}
+
+uint32_t log_pending(void)
+{
+  return 0;
+}
+
+int log_set_level(uint8_t level)
+{
+  if(level > LOG_LEVEL_LOWEST){
+     return -1;
+  }
+  log_level = level;
+  return 0;
+}
+
+int log_vnprintf(uint8_t level,const char *format,...)
+{
+  va_list ap;
+  int cnt;
+
+  if(level > log_level){
+     return 0;
+  }
+  va_start(ap,format);
+  cnt = vprintf(format,ap);
+  va_end(ap);
+
+  return cnt;
+}
+
+int log_printf(uint8_t level,const char *file,int line,const char *format,...)
+{
+  static const char *const prefix_format[LOG_LEVEL_LOWEST + 1] = {
+    "",LOG_ERROR_PREFIX_FORMAT,LOG_WARNING_PREFIX_FORMAT,LOG_INFO_PREFIX_FORMAT,LOG_DEBUG_PREFIX_FORMAT,LOG_ARRAY_PREFIX_FORMAT
+  };
+  va_list ap;
+  int cnt;
+
+  if(level > log_level){
+     return 0;
+  }
+  cnt = printf(prefix_format[level],log_time(),file,line);
+  va_start(ap,format);
+  cnt += vprintf(format,ap);
+  va_end(ap);
+
+  return cnt;
+}
+
+/*后备寄存器 复位后保持 hal_sim_init时清零*/
+void bkp_utils_init(void)
+{
+}
+
+uint16_t bkp_utils_read(uint8_t reg)
+{
+  if(reg == 0 || reg > BKP_UTILS_REG_CNT){
+     return 0;
+  }
+  return bkp_reg[reg];
+}
+
+void bkp_utils_write(uint8_t reg,uint16_t value)
+{
+  if(reg == 0 || reg > BKP_UTILS_REG_CNT){
+     return;
+  }
+  bkp_reg[reg] = value;
+}
+
+/*硬件CRC单元 和crc32_update结果相同*/
+void crc32_hw_reset(void)
+{
+  crc_value = CRC32_INIT_VALUE;
+}
+
+int crc32_hw_update(const void *buffer,uint32_t size)
+{
+  if(((uintptr_t)buffer & 3) != 0){
+     return -1;
+  }
+  crc_value = crc32_update(crc_value,buffer,size);
+  return 0;
+}
+
+uint32_t crc32_hw_value(void)
+{
+  return crc_value;
+}
+
+void crc32_hw_deinit(void)
+{
+}
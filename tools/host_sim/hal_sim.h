@@ -0,0 +1,33 @@
+#ifndef  __HAL_SIM_H__
+#define  __HAL_SIM_H__
+#include "stm32f1xx_hal.h"
+
+/*HAL、日志、后备寄存器和硬件CRC的主机替代 HAL_GetTick按flash_sim的模拟时钟计时*/
+
+/*软件复位时调用 芯片上不会返回 hook中一般用longjmp回到测试的复位点*/
+typedef void (*hal_sim_reset_hook_t)(void);
+
+
+/*名称：hal_sim_init
+* 功能：寄存器恢复为复位后的值 后备寄存器清零 相当于上电
+* 参数：无
+* 返回：无
+*/
+void hal_sim_init(void);
+
+/*名称：hal_sim_set_reset_hook
+* 功能：设置软件复位时调用的函数
+* 参数：hook 函数 NULL：复位时退出程序
+* 返回：无
+*/
+void hal_sim_set_reset_hook(hal_sim_reset_hook_t hook);
+
+/*名称：hal_sim_get_reset_cnt
+* 功能：获取软件复位的次数
+* 参数：无
+* 返回：次数
+*/
+uint32_t hal_sim_get_reset_cnt(void);
+
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef  __MAIN_H__
+#define  __MAIN_H__
+/*主机端替代 固件的main.h只包含HAL*/
+#include "stm32f1xx_hal.h"
+
+#endif
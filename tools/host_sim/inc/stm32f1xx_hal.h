@@ -0,0 +1,155 @@
+/*****************************************************************************
+*  主机端HAL替代头文件
+*
+*  只定义bootloader_if.c、flash_utils.h、boot_timeline.c等用到的类型、寄存器和函数，
+*  寄存器是hal_sim.c中的普通变量，flash和SRAM由flash_sim.c映射到芯片上的地址。
+*  只能在64位主机上用-no-pie编译，全局变量的地址才能放进uint32_t。
+*****************************************************************************/
+#ifndef  __STM32F1XX_HAL_H__
+#define  __STM32F1XX_HAL_H__
+#include <stdint.h>
+#include <stddef.h>
+
+#define  __IO                            volatile
+#define  __weak                          __attribute__((weak))
+
+#define  FLASH_BASE                      0x08000000UL
+#define  FLASH_PAGE_SIZE                 0x800U
+#define  SRAM_BASE                       0x20000000UL
+
+typedef enum
+{
+HAL_OK = 0,
+HAL_ERROR,
+HAL_BUSY,
+HAL_TIMEOUT
+}HAL_StatusTypeDef;
+
+/*内核*/
+static inline void __disable_irq(void){}
+static inline void __enable_irq(void){}
+static inline void __DSB(void){}
+static inline void __ISB(void){}
+static inline void __set_MSP(uint32_t top){(void)top;}
+
+typedef struct
+{
+__IO uint32_t CTRL;
+__IO uint32_t LOAD;
+__IO uint32_t VAL;
+}SysTick_Type;
+
+typedef struct
+{
+__IO uint32_t ICER[8];
+__IO uint32_t ICPR[8];
+}NVIC_Type;
+
+typedef struct
+{
+__IO uint32_t ICSR;
+__IO uint32_t VTOR;
+}SCB_Type;
+
+typedef struct
+{
+__IO uint32_t DHCSR;
+__IO uint32_t DEMCR;
+}CoreDebug_Type;
+
+typedef struct
+{
+__IO uint32_t CTRL;
+__IO uint32_t CYCCNT;
+}DWT_Type;
+
+#define  SCB_ICSR_PENDSTCLR_Msk          (1U << 25)
+#define  SCB_ICSR_PENDSVCLR_Msk          (1U << 27)
+#define  CoreDebug_DHCSR_C_DEBUGEN_Msk   (1U << 0)
+#define  CoreDebug_DEMCR_TRCENA_Msk      (1U << 24)
+#define  DWT_CTRL_CYCCNTENA_Msk          (1U << 0)
+
+/*外设*/
+typedef struct
+{
+__IO uint32_t CR;
+__IO uint32_t CFGR;
+__IO uint32_t CIR;
+__IO uint32_t APB2RSTR;
+__IO uint32_t APB1RSTR;
+__IO uint32_t AHBENR;
+__IO uint32_t APB2ENR;
+__IO uint32_t APB1ENR;
+__IO uint32_t BDCR;
+__IO uint32_t CSR;
+}RCC_TypeDef;
+
+typedef struct
+{
+__IO uint32_t ACR;
+}FLASH_TypeDef;
+
+typedef struct
+{
+__IO uint32_t KR;
+}IWDG_TypeDef;
+
+typedef struct
+{
+uint32_t Prescaler;
+uint32_t Reload;
+}IWDG_InitTypeDef;
+
+typedef struct
+{
+IWDG_TypeDef     *Instance;
+IWDG_InitTypeDef  Init;
+}IWDG_HandleTypeDef;
+
+#define  RCC_AHBENR_SRAMEN               (1U << 2)
+#define  RCC_AHBENR_FLITFEN              (1U << 4)
+#define  RCC_APB1ENR_BKPEN               (1U << 27)
+#define  RCC_APB1ENR_PWREN               (1U << 28)
+#define  RCC_APB1RSTR_BKPRST             (1U << 27)
+#define  RCC_APB1RSTR_PWRRST             (1U << 28)
+
+/*复位标志按RCC->CSR中的位序号表示*/
+#define  RCC_FLAG_PINRST                 26
+#define  RCC_FLAG_PORRST                 27
+#define  RCC_FLAG_SFTRST                 28
+#define  RCC_FLAG_IWDGRST                29
+#define  RCC_FLAG_WWDGRST                30
+#define  RCC_FLAG_LPWRRST                31
+#define  __HAL_RCC_GET_FLAG(flag)        ((RCC->CSR >> (flag)) & 1U)
+#define  __HAL_RCC_CLEAR_RESET_FLAGS()   (RCC->CSR &= 0x00FFFFFFU)
+
+#define  IWDG_KEY_RELOAD                 0x0000AAAAU
+#define  IWDG_PRESCALER_256              0x00000006U
+
+extern SysTick_Type   sim_systick;
+extern NVIC_Type      sim_nvic;
+extern SCB_Type       sim_scb;
+extern CoreDebug_Type sim_core_debug;
+extern DWT_Type       sim_dwt;
+extern RCC_TypeDef    sim_rcc;
+extern FLASH_TypeDef  sim_flash;
+extern IWDG_TypeDef   sim_iwdg;
+extern uint32_t       SystemCoreClock;
+
+#define  SysTick                         (&sim_systick)
+#define  NVIC                            (&sim_nvic)
+#define  SCB                             (&sim_scb)
+#define  CoreDebug                       (&sim_core_debug)
+#define  DWT                             (&sim_dwt)
+#define  RCC                             (&sim_rcc)
+#define  FLASH                           (&sim_flash)
+#define  IWDG                            (&sim_iwdg)
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t delay);
+void HAL_RCC_DeInit(void);
+void HAL_FLASH_OB_Launch(void);
+HAL_StatusTypeDef HAL_IWDG_Init(IWDG_HandleTypeDef *hiwdg);
+void NVIC_SystemReset(void);
+
+#endif
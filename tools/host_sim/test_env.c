@@ -0,0 +1,263 @@
+/*****************************************************************************
+*  test_env env记录的掉电测试(主机端)
+*
+*  编译：make test_env
+*  运行：./test_env
+*
+*  在flash_sim上检查bootloader_save_env和bootloader_init：
+*  1.连续保存199次 中间穿插重新初始化和错误的后备寄存器提示 每次读回的env正确
+*    输出199次保存擦除的页数
+*  2.bank中有不同数量的记录时 在保存的每一次擦除或编程之前掉电 重新初始化后得到
+*    保存前或者保存后的env 保存返回成功时一定是保存后的env 掉电后还能继续保存
+*  3.变化太多时在当前bank追加完整记录 不擦除
+*  4.旧格式的env能够读出
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include "stm32f1xx_hal.h"
+#include "bootloader_if.h"
+#include "bkp_utils.h"
+#include "flash_sim.h"
+#include "hal_sim.h"
+
+#define  ENV_BANK1_ADDR       (BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK1_ADDR_OFFSET)
+#define  ENV_BANK2_ADDR       (BOOTLOADER_FLASH_BASE_ADDR + BOOTLOADER_FLASH_ENV_BANK2_ADDR_OFFSET)
+#define  ENV_HINT_TAG         0xA400     /*和bootloader_if.c中相同*/
+#define  SAVE_CNT             199
+#define  POWER_CUT_MAX_OP     300
+
+static jmp_buf power_cut_jmp;
+
+/*名称：test_power_on
+* 功能：上电 flash全部擦除 bootloader初始化
+* 参数：无
+* 返回：0：成功 其他：失败
+*/
+static int test_power_on(void)
+{
+  hal_sim_init();
+  if(flash_sim_init() != 0){
+     return -1;
+  }
+
+  return bootloader_init();
+}
+
+/*名称：test_save
+* 功能：修改env中的参数后保存
+* 参数：value 写入reserved[0]的值
+* 参数：fill  不为0时同时修改reserved中的一段 记录更大
+* 返回：0：成功 其他：失败
+*/
+static int test_save(uint32_t value,uint32_t fill)
+{
+  bootloader_env_t env;
+
+  if(bootloader_get_env(&env) != 0){
+     return -1;
+  }
+  env.reserved[0] = value;
+  if(fill != 0){
+     memset(&env.reserved[2],(int)fill,64);
+  }
+
+  return bootloader_save_env(&env);
+}
+
+/*名称：test_saves
+* 功能：连续保存 穿插重新初始化和错误的提示 检查读回的env
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_saves(void)
+{
+  bootloader_env_t env;
+  uint32_t i,erase_cnt;
+  int fail = 0;
+
+  if(test_power_on() != 0){
+     printf("saves: init err.\n");
+     return 1;
+  }
+  flash_sim_stat_reset();
+  for(i = 1; i <= SAVE_CNT; i++){
+      if(bootloader_get_env(&env) != 0){
+         fail ++;
+         break;
+      }
+      env.reserved[0] = i;
+      if(i % 13 == 0){
+         memset(&env.reserved[1],(int)i,100);
+      }
+      if(i % 17 == 0){
+         env.fw_update.size = i;
+      }
+      if(bootloader_save_env(&env) != 0){
+         printf("saves: save %u err.\n",i);
+         fail ++;
+         break;
+      }
+      if(i % 3 == 0){
+         bootloader_init();
+      }
+      if(i % 5 == 0){
+         /*提示指向bank中的任意位置*/
+         bkp_utils_write(BKP_UTILS_REG_ENV_HINT,(uint16_t)(ENV_HINT_TAG | (i * 37 % 1024)));
+         bootloader_init();
+      }
+      if(i % 7 == 0){
+         bkp_utils_write(BKP_UTILS_REG_ENV_HINT,0);
+         bootloader_init();
+      }
+      if(i % 11 == 0){
+         /*提示指向bank开头*/
+         bkp_utils_write(BKP_UTILS_REG_ENV_HINT,(uint16_t)(ENV_HINT_TAG | (i % 2) << 9));
+         bootloader_init();
+      }
+      if(bootloader_get_env(&env) != 0 || env.reserved[0] != i ||
+         (i >= 13 && env.reserved[1] != (i / 13 * 13) * 0x01010101U) ||
+         (i >= 17 && env.fw_update.size != i / 17 * 17)){
+         printf("saves: save %u read back err.\n",i);
+         fail ++;
+      }
+  }
+  erase_cnt = flash_sim_get_stat()->erase_cnt;
+  printf("%u saves erases %u\n",SAVE_CNT,erase_cnt);
+
+  return fail;
+}
+
+/*名称：test_power_cut
+* 功能：先保存pre次 然后在保存的第cut次操作之前掉电 检查重新初始化后的env
+* 参数：pre 掉电前保存的次数
+* 参数：cut 掉电点
+* 返回：失败的次数
+*/
+static int test_power_cut(uint32_t pre,uint32_t cut)
+{
+  bootloader_env_t env;
+  volatile int done = 0;
+  uint32_t i;
+
+  if(test_power_on() != 0){
+     printf("power cut: init err.\n");
+     return 1;
+  }
+  for(i = 1; i <= pre; i++){
+      test_save(i,i % 9 == 0 ? i : 0);
+  }
+
+  flash_sim_set_power_cut(cut,&power_cut_jmp);
+  if(setjmp(power_cut_jmp) == 0){
+     if(test_save(1000,0) == 0){
+        done = 1;
+     }
+  }
+  flash_sim_set_power_cut(0,NULL);
+
+  /*掉电后上电 flash和后备寄存器保留*/
+  if(bootloader_init() != 0 || bootloader_get_env(&env) != 0 ||
+     (env.reserved[0] != pre && env.reserved[0] != 1000) || (done && env.reserved[0] != 1000)){
+     printf("power cut: pre %u cut %u err.\n",pre,cut);
+     return 1;
+  }
+  if(test_save(2000,0) != 0 || bootloader_init() != 0 || bootloader_get_env(&env) != 0 || env.reserved[0] != 2000){
+     printf("power cut: pre %u cut %u save after err.\n",pre,cut);
+     return 1;
+  }
+
+  return 0;
+}
+
+/*名称：test_full_record
+* 功能：变化太多不能写增量记录时 在当前bank追加完整记录 bank没有写满时不擦除
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_full_record(void)
+{
+  bootloader_env_t env;
+  uint32_t i;
+  int fail = 0;
+
+  if(test_power_on() != 0){
+     printf("full record: init err.\n");
+     return 1;
+  }
+  flash_sim_stat_reset();
+  for(i = 1; i <= 3; i++){
+      if(bootloader_get_env(&env) != 0){
+         fail ++;
+         break;
+      }
+      /*全部字段都变化 增量不比完整记录小*/
+      memset(&env,(int)i,sizeof(env));
+      env.status = BOOTLOADER_ENV_STATUS_VALID;
+      if(bootloader_save_env(&env) != 0 || bootloader_init() != 0 || bootloader_get_env(&env) != 0 ||
+         env.reserved[31] != i * 0x01010101U){
+         printf("full record: save %u err.\n",i);
+         fail ++;
+      }
+  }
+  if(flash_sim_get_stat()->erase_cnt != 0){
+     printf("full record: erases %u err.\n",flash_sim_get_stat()->erase_cnt);
+     fail ++;
+  }
+
+  return fail;
+}
+
+/*名称：test_legacy
+* 功能：旧格式的env 1：bank1中连续多份 2：bank2开头的等待转移 3：没有env
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_legacy(void)
+{
+  bootloader_env_t env,legacy;
+  uint32_t i,want;
+  int k,fail = 0;
+
+  for(k = 0; k < 3; k++){
+      hal_sim_init();
+      flash_sim_init();
+      memset(&legacy,0,sizeof(legacy));
+      legacy.status = BOOTLOADER_ENV_STATUS_VALID;
+      if(k != 2){
+         for(i = 0; i < 5; i++){
+             legacy.reserved[1] = i;
+             memcpy((void *)(uintptr_t)(ENV_BANK1_ADDR + i * sizeof(legacy)),&legacy,sizeof(legacy));
+         }
+      }
+      if(k == 1){
+         legacy.reserved[1] = 77;
+         memcpy((void *)(uintptr_t)ENV_BANK2_ADDR,&legacy,sizeof(legacy));
+      }
+      want = k == 0 ? 4 : (k == 1 ? 77 : 0);
+      if(bootloader_init() != 0 || bootloader_get_env(&env) != 0 || env.reserved[1] != want){
+         printf("legacy %d err.\n",k);
+         fail ++;
+      }
+  }
+
+  return fail;
+}
+
+int main(void)
+{
+  uint32_t pre,cut;
+  int fail = 0;
+
+  fail += test_saves();
+  for(pre = 1; pre <= 110; pre += pre < 20 ? 1 : 7){
+      for(cut = 1; cut < POWER_CUT_MAX_OP; cut += 2){
+          fail += test_power_cut(pre,cut);
+      }
+  }
+  fail += test_full_record();
+  fail += test_legacy();
+  printf(fail ? "FAILED\n" : "ALL OK\n");
+
+  return fail ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+/*****************************************************************************
+*  test_kv 键值存储的掉电测试(主机端)
+*
+*  编译：make test_kv
+*  运行：./test_kv
+*
+*  在flash_sim上检查kv_store：
+*  1.随机写入和删除5000次 每次和RAM中的模型比较 期间多次重新初始化
+*    输出擦除的总页数和每一页的擦除次数
+*  2.写入不同数量的记录后 在一次写入的每一次擦除或编程之前掉电 写入可能触发页切换
+*    重新初始化后其他键不变 这个键是写入前或者写入后的值 写入返回成功时一定是写入后的值
+*    掉电后还能继续写入
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "stm32f1xx_hal.h"
+#include "kv_store.h"
+#include "flash_sim.h"
+#include "hal_sim.h"
+
+#define  RANDOM_OP_CNT        5000
+#define  VALUE_WORD_CNT       (KV_STORE_VALUE_MAX_SIZE / 4)
+#define  POWER_CUT_KEY        3
+
+static jmp_buf power_cut_jmp;
+/*每个键应有的值 长度0表示不存在*/
+static uint32_t model_value[KV_STORE_KEY_CNT][VALUE_WORD_CNT];
+static int model_size[KV_STORE_KEY_CNT];
+
+/*名称：test_model_set
+* 功能：修改模型中键的值
+* 参数：key   键
+* 参数：value 值 NULL：删除
+* 参数：size  值的长度
+* 返回：无
+*/
+static void test_model_set(uint16_t key,const uint32_t *value,int size)
+{
+  if(value == NULL){
+     model_size[key] = 0;
+     return;
+  }
+  memcpy(model_value[key],value,size);
+  model_size[key] = size;
+}
+
+/*名称：test_check
+* 功能：kv_store中每个键的值和模型比较
+* 参数：name 检查点名称
+* 返回：0：相同 其他：不同
+*/
+static int test_check(const char *name)
+{
+  uint32_t value[VALUE_WORD_CNT];
+  uint16_t key;
+  int size;
+
+  for(key = 0; key < KV_STORE_KEY_CNT; key++){
+      size = kv_store_get(key,value,sizeof(value));
+      if(size != (model_size[key] != 0 ? model_size[key] : -1) ||
+         (size > 0 && memcmp(value,model_value[key],size) != 0)){
+         printf("%s: key %u size %d want %d.\n",name,key,size,model_size[key]);
+         return 1;
+      }
+  }
+
+  return 0;
+}
+
+/*名称：test_random_value
+* 功能：生成随机的值
+* 参数：value 值
+* 返回：值的长度
+*/
+static int test_random_value(uint32_t *value)
+{
+  uint32_t i;
+
+  for(i = 0; i < VALUE_WORD_CNT; i++){
+      value[i] = (uint32_t)rand();
+  }
+
+  return 1 + rand() % KV_STORE_VALUE_MAX_SIZE;
+}
+
+/*名称：test_random_ops
+* 功能：随机写入和删除 每次和模型比较
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_random_ops(void)
+{
+  const flash_sim_stat_t *stat;
+  uint32_t value[VALUE_WORD_CNT];
+  uint32_t i,page;
+  uint16_t key;
+  int size;
+
+  hal_sim_init();
+  flash_sim_init();
+  memset(model_size,0,sizeof(model_size));
+  srand(1);
+  if(kv_store_init() != 0){
+     printf("random: init err.\n");
+     return 1;
+  }
+  for(i = 0; i < RANDOM_OP_CNT; i++){
+      key = (uint16_t)(rand() % KV_STORE_KEY_CNT);
+      if(rand() % 10 == 0){
+         if(kv_store_delete(key) != 0){
+            printf("random: op %u delete err.\n",i);
+            return 1;
+         }
+         test_model_set(key,NULL,0);
+      }else{
+         size = test_random_value(value);
+         if(kv_store_set(key,value,(uint16_t)size) != 0){
+            printf("random: op %u set err.\n",i);
+            return 1;
+         }
+         test_model_set(key,value,size);
+      }
+      if(i % 97 == 0 && kv_store_init() != 0){
+         printf("random: op %u init err.\n",i);
+         return 1;
+      }
+      if(test_check("random") != 0){
+         return 1;
+      }
+  }
+
+  stat = flash_sim_get_stat();
+  printf("%u ops erases %u pages",RANDOM_OP_CNT,stat->erase_cnt);
+  for(page = 0; page < KV_STORE_PAGE_CNT; page++){
+      printf(" %u",stat->page_erase_cnt[(KV_STORE_ADDR - FLASH_BASE) / FLASH_PAGE_SIZE + page]);
+  }
+  printf("\n");
+
+  return 0;
+}
+
+/*名称：test_power_cut
+* 功能：先写入pre次 然后在写入的第cut次操作之前掉电 检查重新初始化后的值
+* 参数：pre 掉电前写入的次数
+* 参数：cut 掉电点
+* 参数：finished 写入在掉电点之前完成 后面的掉电点不用再测试
+* 返回：失败的次数
+*/
+static int test_power_cut(uint32_t pre,uint32_t cut,int *finished)
+{
+  uint32_t value[VALUE_WORD_CNT],new_value[VALUE_WORD_CNT];
+  volatile int done = 0;
+  uint32_t i;
+  uint16_t key;
+  int size;
+
+  hal_sim_init();
+  flash_sim_init();
+  memset(model_size,0,sizeof(model_size));
+  srand(pre);
+  if(kv_store_init() != 0){
+     printf("power cut: init err.\n");
+     return 1;
+  }
+  /*先写入所有的键 后面只修改其中几个 回收最旧的页时有需要复制的记录*/
+  for(i = 0; i < pre; i++){
+      key = (uint16_t)(i < KV_STORE_KEY_CNT ? i : rand() % 8);
+      size = test_random_value(value);
+      kv_store_set(key,value,(uint16_t)size);
+      test_model_set(key,value,size);
+  }
+
+  memset(new_value,0x5A,sizeof(new_value));
+  flash_sim_set_power_cut(cut,&power_cut_jmp);
+  if(setjmp(power_cut_jmp) == 0){
+     if(kv_store_set(POWER_CUT_KEY,new_value,sizeof(new_value)) == 0){
+        done = 1;
+     }
+  }
+  flash_sim_set_power_cut(0,NULL);
+  *finished = done;
+
+  /*掉电后上电 写入的键是旧值或者新值*/
+  if(kv_store_init() != 0){
+     printf("power cut: pre %u cut %u init err.\n",pre,cut);
+     return 1;
+  }
+  size = kv_store_get(POWER_CUT_KEY,value,sizeof(value));
+  if(size == sizeof(new_value) && memcmp(value,new_value,sizeof(new_value)) == 0){
+     test_model_set(POWER_CUT_KEY,new_value,sizeof(new_value));
+  }else if(done){
+     printf("power cut: pre %u cut %u lost a completed set.\n",pre,cut);
+     return 1;
+  }
+  if(test_check("power cut") != 0){
+     printf("power cut: pre %u cut %u err.\n",pre,cut);
+     return 1;
+  }
+
+  /*掉电后继续写入 所有的键都写一次以上*/
+  for(i = 0; i < 70; i++){
+      key = (uint16_t)(i % KV_STORE_KEY_CNT);
+      value[0] = i;
+      value[1] = pre;
+      value[2] = cut;
+      if(kv_store_set(key,value,12) != 0){
+         printf("power cut: pre %u cut %u set after err.\n",pre,cut);
+         return 1;
+      }
+      test_model_set(key,value,12);
+  }
+  if(kv_store_init() != 0 || test_check("after power cut") != 0){
+     printf("power cut: pre %u cut %u err after.\n",pre,cut);
+     return 1;
+  }
+
+  return 0;
+}
+
+int main(void)
+{
+  uint32_t pre,cut,cut_cnt = 0;
+  int fail = 0,finished;
+
+  fail += test_random_ops();
+  for(pre = 0; pre < 400 && fail == 0; pre++){
+      finished = 0;
+      for(cut = 1; !finished && fail == 0; cut++){
+          fail += test_power_cut(pre,cut,&finished);
+      }
+      cut_cnt += cut - 2;
+  }
+  printf("power cuts %u\n",cut_cnt);
+  printf(fail ? "FAILED\n" : "ALL OK\n");
+
+  return fail ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+/*****************************************************************************
+*  sha256_test bootloader中sha256的测试向量和速度(主机端)
+*
+*  编译：make 或 gcc -O2 -I../../bm_bootloader/Src/sha256 -o sha256_test sha256_test.c ../../bm_bootloader/Src/sha256/sha256.c
+*  运行：make test 或 ./sha256_test
+*
+*  用FIPS 180-2附录B的测试向量检查sha256_init/sha256_update/sha256_final，每个向量
+*  一次输入和按不同长度分段输入各计算一次。然后按bootloader校验时的2K分段计算
+*  SPEED_TEST_SIZE字节，输出主机上的MB/s，用于比较实现修改前后的速度。
+*****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "sha256.h"
+
+#define  MILLION_A_SIZE     1000000
+#define  SPEED_TEST_SIZE    (64 * 1024 * 1024)
+#define  SPEED_CHUNK_SIZE   0x800
+
+typedef struct
+{
+const char *name;
+const char *message;        /*NULL：一百万个'a'*/
+const char *digest;
+}test_vector_t;
+
+static const test_vector_t test_vector[] = {
+{"abc",       "abc",                                                      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+{"empty",     "",                                                         "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+{"448 bits",  "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+{"million a", NULL,                                                       "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"}
+};
+
+/*分段输入时每段的长度 循环使用 覆盖块内、跨块和整块的情况*/
+static const uint32_t chunk_size[] = {1,3,63,64,65,127,128,200,1000};
+
+/*名称：sha256_digest
+* 功能：计算摘要
+* 参数：data   数据
+* 参数：size   数据大小
+* 参数：split  0：一次输入 其他：按chunk_size分段输入
+* 参数：digest 摘要
+* 返回：无
+*/
+static void sha256_digest(const uint8_t *data,uint32_t size,int split,uint8_t *digest)
+{
+  sha256_ctx_t ctx;
+  uint32_t offset,cnt,i = 0;
+
+  sha256_init(&ctx);
+  for(offset = 0; offset < size; offset += cnt){
+      cnt = split ? chunk_size[i++ % (sizeof(chunk_size) / sizeof(chunk_size[0]))] : size;
+      cnt = cnt < size - offset ? cnt : size - offset;
+      sha256_update(&ctx,data + offset,cnt);
+  }
+  sha256_final(&ctx,digest);
+}
+
+/*名称：sha256_to_hex
+* 功能：摘要转换为十六进制字符串
+* 参数：digest 摘要
+* 参数：hex    字符串 至少SHA256_DIGEST_SIZE * 2 + 1字节
+* 返回：无
+*/
+static void sha256_to_hex(const uint8_t *digest,char *hex)
+{
+  uint32_t i;
+
+  for(i = 0; i < SHA256_DIGEST_SIZE; i++){
+      sprintf(hex + i * 2,"%02x",digest[i]);
+  }
+}
+
+/*名称：test_vectors
+* 功能：检查全部测试向量
+* 参数：无
+* 返回：失败的次数
+*/
+static int test_vectors(void)
+{
+  const test_vector_t *v;
+  const uint8_t *data;
+  uint8_t *million_a,digest[SHA256_DIGEST_SIZE];
+  char hex[SHA256_DIGEST_SIZE * 2 + 1];
+  uint32_t i,size;
+  int split,fail = 0;
+
+  million_a = malloc(MILLION_A_SIZE);
+  if(million_a == NULL){
+     printf("no memory.\n");
+     return 1;
+  }
+  memset(million_a,'a',MILLION_A_SIZE);
+  for(i = 0; i < sizeof(test_vector) / sizeof(test_vector[0]); i++){
+      v = &test_vector[i];
+      data = v->message != NULL ? (const uint8_t *)v->message : million_a;
+      size = v->message != NULL ? (uint32_t)strlen(v->message) : MILLION_A_SIZE;
+      for(split = 0; split < 2; split++){
+          sha256_digest(data,size,split,digest);
+          sha256_to_hex(digest,hex);
+          if(strcmp(hex,v->digest) != 0){
+             printf("%-10s %s err: %s\n",v->name,split ? "split" : "whole",hex);
+             fail ++;
+          }else{
+             printf("%-10s %s ok\n",v->name,split ? "split" : "whole");
+          }
+      }
+  }
+  free(million_a);
+
+  return fail;
+}
+
+/*名称：test_speed
+* 功能：按2K分段计算 输出速度
+* 参数：无
+* 返回：无
+*/
+static void test_speed(void)
+{
+  sha256_ctx_t ctx;
+  uint8_t chunk[SPEED_CHUNK_SIZE],digest[SHA256_DIGEST_SIZE];
+  uint32_t offset,i;
+  clock_t start;
+  double seconds;
+
+  for(i = 0; i < sizeof(chunk); i++){
+      chunk[i] = (uint8_t)(i * 7 + 1);
+  }
+  start = clock();
+  sha256_init(&ctx);
+  for(offset = 0; offset < SPEED_TEST_SIZE; offset += sizeof(chunk)){
+      sha256_update(&ctx,chunk,sizeof(chunk));
+  }
+  sha256_final(&ctx,digest);
+  seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+  printf("speed %u MB in %.3fs %.1f MB/s\n",SPEED_TEST_SIZE / (1024 * 1024),seconds,
+         seconds > 0 ? SPEED_TEST_SIZE / (1024.0 * 1024.0) / seconds : 0.0);
+}
+
+int main(void)
+{
+  int fail;
+
+  fail = test_vectors();
+  test_speed();
+  printf(fail ? "FAILED\n" : "ALL OK\n");
+
+  return fail ? 1 : 0;
+}